@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/random.h>
+#include "aead.h"
+#include "types.h"
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTER(a, b, c, d)                        \
+    do                                             \
+    {                                              \
+        a += b; d ^= a; d = ROTL32(d, 16);         \
+        c += d; b ^= c; b = ROTL32(b, 12);         \
+        a += b; d ^= a; d = ROTL32(d, 8);          \
+        c += d; b ^= c; b = ROTL32(b, 7);          \
+    } while (0)
+
+#define MASK44 0xFFFFFFFFFFFULL
+#define MASK42 0x3FFFFFFFFFFULL
+
+typedef unsigned long long u64;
+typedef unsigned __int128 u128;
+typedef uint v4u __attribute__((vector_size(16))); // Word i of four consecutive blocks
+
+typedef struct
+{
+    u64 r[3];   // Clamped key half, 44/44/42-bit limbs
+    u64 h[3];   // Accumulator
+    u64 pad[2]; // Added at the end
+} Poly1305;
+
+/* Function Definitions */
+
+static uint load32(const uchar *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint)p[3] << 24);
+}
+
+static u64 load64(const uchar *p)
+{
+    return load32(p) | ((u64)load32(p + 4) << 32);
+}
+
+static void store64(uchar *p, u64 v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+static void chacha20_init(uint *state, const uchar *key, const uchar *nonce, uint counter)
+{
+    // "expand 32-byte k", key, block counter, nonce
+    state[0] = 0x61707865;
+    state[1] = 0x3320646E;
+    state[2] = 0x79622D32;
+    state[3] = 0x6B206574;
+    for (int i = 0; i < 8; i++)
+        state[4 + i] = load32(key + 4 * i);
+    state[12] = counter;
+    for (int i = 0; i < 3; i++)
+        state[13 + i] = load32(nonce + 4 * i);
+}
+
+static void chacha20_block(const uint *state, uint *out)
+{
+    // 20 rounds: 10 column and 10 diagonal rounds
+    uint x[16];
+    memcpy(x, state, sizeof(x));
+    for (int i = 0; i < 10; i++)
+    {
+        QUARTER(x[0], x[4], x[8], x[12]);
+        QUARTER(x[1], x[5], x[9], x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8], x[13]);
+        QUARTER(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++)
+        out[i] = x[i] + state[i];
+}
+
+static void chacha20_xor4(uint *state, const uchar *in, uchar *out)
+{
+    // Four blocks at once, one per vector lane (SSE2/NEON through GCC vector extensions)
+    v4u x[16], s[16];
+    for (int i = 0; i < 16; i++)
+        s[i] = (v4u){state[i], state[i], state[i], state[i]};
+    s[12] += (v4u){0, 1, 2, 3};
+    memcpy(x, s, sizeof(x));
+
+    for (int i = 0; i < 10; i++)
+    {
+        QUARTER(x[0], x[4], x[8], x[12]);
+        QUARTER(x[1], x[5], x[9], x[13]);
+        QUARTER(x[2], x[6], x[10], x[14]);
+        QUARTER(x[3], x[7], x[11], x[15]);
+        QUARTER(x[0], x[5], x[10], x[15]);
+        QUARTER(x[1], x[6], x[11], x[12]);
+        QUARTER(x[2], x[7], x[8], x[13]);
+        QUARTER(x[3], x[4], x[9], x[14]);
+    }
+
+    // Back to block order, then XOR 8 bytes at a time
+    uint ks[64];
+    for (int i = 0; i < 16; i++)
+    {
+        v4u word = x[i] + s[i];
+        for (int b = 0; b < 4; b++)
+            ks[16 * b + i] = word[b];
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (int j = 0; j < 256; j += 8)
+    {
+        u64 data, key;
+        memcpy(&data, in + j, 8);
+        memcpy(&key, (const uchar *)ks + j, 8);
+        data ^= key;
+        memcpy(out + j, &data, 8);
+    }
+#else
+    for (int j = 0; j < 64; j++)
+    {
+        uint k = load32(in + 4 * j) ^ ks[j];
+        out[4 * j] = k;
+        out[4 * j + 1] = k >> 8;
+        out[4 * j + 2] = k >> 16;
+        out[4 * j + 3] = k >> 24;
+    }
+#endif
+    state[12] += 4;
+}
+
+static void chacha20_xor(const uchar *key, const uchar *nonce, uint counter, const uchar *in, uchar *out, size_t len)
+{
+    // Keystream four blocks at a time, then one 64-byte block at a time, applied a word at a time
+    uint state[16], block[16];
+    chacha20_init(state, key, nonce, counter);
+    for (; len >= 256; len -= 256, in += 256, out += 256)
+        chacha20_xor4(state, in, out);
+    for (; len >= 64; len -= 64, in += 64, out += 64)
+    {
+        chacha20_block(state, block);
+        state[12]++;
+        for (int i = 0; i < 16; i++)
+        {
+            uint word = load32(in + 4 * i) ^ block[i];
+            out[4 * i] = word;
+            out[4 * i + 1] = word >> 8;
+            out[4 * i + 2] = word >> 16;
+            out[4 * i + 3] = word >> 24;
+        }
+    }
+    if (len > 0)
+    {
+        uchar tail[64];
+        chacha20_block(state, block);
+        for (int i = 0; i < 16; i++)
+        {
+            tail[4 * i] = block[i];
+            tail[4 * i + 1] = block[i] >> 8;
+            tail[4 * i + 2] = block[i] >> 16;
+            tail[4 * i + 3] = block[i] >> 24;
+        }
+        for (size_t i = 0; i < len; i++)
+            out[i] = in[i] ^ tail[i];
+    }
+}
+
+static void poly1305_init(Poly1305 *mac, const uchar *key)
+{
+    // r is clamped as the RFC requires; s is added at the end
+    u64 t0 = load64(key), t1 = load64(key + 8);
+    mac->r[0] = t0 & 0xFFC0FFFFFFFULL;
+    mac->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xFFFFFC0FFFFULL;
+    mac->r[2] = (t1 >> 24) & 0x00FFFFFFC0FULL;
+    mac->h[0] = mac->h[1] = mac->h[2] = 0;
+    mac->pad[0] = load64(key + 16);
+    mac->pad[1] = load64(key + 24);
+}
+
+static void poly1305_blocks(Poly1305 *mac, const uchar *m, size_t len)
+{
+    // Whole 16-byte blocks: h = (h + block + 2^128) * r mod 2^130 - 5
+    u64 r0 = mac->r[0], r1 = mac->r[1], r2 = mac->r[2];
+    u64 s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    u64 h0 = mac->h[0], h1 = mac->h[1], h2 = mac->h[2];
+
+    for (; len >= 16; len -= 16, m += 16)
+    {
+        u64 t0 = load64(m), t1 = load64(m + 8);
+        h0 += t0 & MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+        h2 += ((t1 >> 24) & MASK42) | (1ULL << 40);
+
+        u128 d0 = (u128)h0 * r0 + (u128)h1 * s2 + (u128)h2 * s1;
+        u128 d1 = (u128)h0 * r1 + (u128)h1 * r0 + (u128)h2 * s2;
+        u128 d2 = (u128)h0 * r2 + (u128)h1 * r1 + (u128)h2 * r0;
+
+        u64 c = (u64)(d0 >> 44);
+        h0 = (u64)d0 & MASK44;
+        d1 += c;
+        c = (u64)(d1 >> 44);
+        h1 = (u64)d1 & MASK44;
+        d2 += c;
+        c = (u64)(d2 >> 42);
+        h2 = (u64)d2 & MASK42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= MASK44;
+        h1 += c;
+    }
+
+    mac->h[0] = h0;
+    mac->h[1] = h1;
+    mac->h[2] = h2;
+}
+
+static void poly1305_padded(Poly1305 *mac, const uchar *m, size_t len)
+{
+    // Data followed by zeros up to a multiple of 16 bytes
+    poly1305_blocks(mac, m, len & ~(size_t)15);
+    if (len & 15)
+    {
+        uchar block[16] = {0};
+        memcpy(block, m + (len & ~(size_t)15), len & 15);
+        poly1305_blocks(mac, block, 16);
+    }
+}
+
+static void poly1305_finish(Poly1305 *mac, uchar *tag)
+{
+    // Fully reduce h, then add s mod 2^128
+    u64 h0 = mac->h[0], h1 = mac->h[1], h2 = mac->h[2], c;
+    c = h1 >> 44; h1 &= MASK44;
+    h2 += c; c = h2 >> 42; h2 &= MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+    h1 += c; c = h1 >> 44; h1 &= MASK44;
+    h2 += c; c = h2 >> 42; h2 &= MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+    h1 += c;
+
+    // g = h - p; keep it unless it went negative (constant time)
+    u64 g0 = h0 + 5; c = g0 >> 44; g0 &= MASK44;
+    u64 g1 = h1 + c; c = g1 >> 44; g1 &= MASK44;
+    u64 g2 = h2 + c - (1ULL << 42);
+    c = (g2 >> 63) - 1;
+    h0 = (h0 & ~c) | (g0 & c);
+    h1 = (h1 & ~c) | (g1 & c);
+    h2 = (h2 & ~c) | (g2 & c);
+
+    u64 t0 = mac->pad[0], t1 = mac->pad[1];
+    h0 += t0 & MASK44; c = h0 >> 44; h0 &= MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c; c = h1 >> 44; h1 &= MASK44;
+    h2 += ((t1 >> 24) & MASK42) + c; h2 &= MASK42;
+
+    store64(tag, h0 | (h1 << 44));
+    store64(tag + 8, (h1 >> 20) | (h2 << 24));
+    memset(mac, 0, sizeof(Poly1305));
+}
+
+static void aead_tag(const uchar *key, const uchar *nonce, const uchar *aad, size_t aad_len, const uchar *ct, size_t len,
+                     uchar *tag)
+{
+    // One-time key from block 0; MAC over aad, ciphertext and both lengths
+    uint state[16], block[16];
+    uchar otk[32], lengths[16];
+    chacha20_init(state, key, nonce, 0);
+    chacha20_block(state, block);
+    for (int i = 0; i < 8; i++)
+    {
+        otk[4 * i] = block[i];
+        otk[4 * i + 1] = block[i] >> 8;
+        otk[4 * i + 2] = block[i] >> 16;
+        otk[4 * i + 3] = block[i] >> 24;
+    }
+
+    Poly1305 mac;
+    poly1305_init(&mac, otk);
+    poly1305_padded(&mac, aad, aad_len);
+    poly1305_padded(&mac, ct, len);
+    store64(lengths, aad_len);
+    store64(lengths + 8, len);
+    poly1305_blocks(&mac, lengths, 16);
+    poly1305_finish(&mac, tag);
+    memset(otk, 0, sizeof(otk));
+}
+
+void aead_seal(const uchar *key, const uchar *nonce, const uchar *aad, size_t aad_len, const uchar *in, size_t len,
+               uchar *out, uchar *tag)
+{
+    chacha20_xor(key, nonce, 1, in, out, len);
+    aead_tag(key, nonce, aad, aad_len, out, len, tag);
+}
+
+Status aead_open(const uchar *key, const uchar *nonce, const uchar *aad, size_t aad_len, const uchar *in, size_t len,
+                 const uchar *tag, uchar *out)
+{
+    uchar expected[AEAD_TAG_BYTES];
+    aead_tag(key, nonce, aad, aad_len, in, len, expected);
+
+    // Compare without an early exit
+    uchar diff = 0;
+    for (int i = 0; i < AEAD_TAG_BYTES; i++)
+        diff |= expected[i] ^ tag[i];
+    if (diff != 0)
+        return e_failure;
+
+    chacha20_xor(key, nonce, 1, in, out, len);
+    return e_success;
+}
+
+size_t aead_sealed_size(size_t len)
+{
+    // The last chunk always exists, even for an empty payload
+    size_t chunks = len == 0 ? 1 : (len + AEAD_CHUNK - 1) / AEAD_CHUNK;
+    return AEAD_PREFIX_BYTES + len + chunks * AEAD_CHUNK_OVERHEAD;
+}
+
+size_t aead_plain_size(size_t sealed)
+{
+    if (sealed < AEAD_PREFIX_BYTES + AEAD_CHUNK_OVERHEAD)
+        return (size_t)-1;
+    size_t body = sealed - AEAD_PREFIX_BYTES;
+    size_t chunks = (body + AEAD_CHUNK + AEAD_CHUNK_OVERHEAD - 1) / (AEAD_CHUNK + AEAD_CHUNK_OVERHEAD);
+    size_t len = body - chunks * AEAD_CHUNK_OVERHEAD;
+    return aead_sealed_size(len) == sealed ? len : (size_t)-1;
+}
+
+void aead_stream_init(AeadStream *stream, const uchar *key, const uchar *prefix, uchar *buf)
+{
+    memset(stream, 0, sizeof(AeadStream));
+    memcpy(stream->key, key, AEAD_KEY_BYTES);
+    memcpy(stream->nonce, prefix, AEAD_PREFIX_BYTES);
+    stream->buf = buf;
+}
+
+static void set_index(AeadStream *stream)
+{
+    stream->nonce[8] = stream->index >> 24;
+    stream->nonce[9] = stream->index >> 16;
+    stream->nonce[10] = stream->index >> 8;
+    stream->nonce[11] = stream->index;
+}
+
+Status aead_seal_chunk(AeadStream *stream, int final, uchar *word, uchar *tag)
+{
+    // 2^32 chunks is 64 TB: past that a nonce would repeat
+    if (stream->index == 0xFFFFFFFFu)
+        return e_failure;
+
+    uint value = (uint)stream->len | (final ? AEAD_FINAL : 0);
+    word[0] = value >> 24;
+    word[1] = value >> 16;
+    word[2] = value >> 8;
+    word[3] = value;
+
+    set_index(stream);
+    aead_seal(stream->key, stream->nonce, word, 4, stream->buf, stream->len, stream->buf, tag);
+    stream->index++;
+    return e_success;
+}
+
+Status aead_chunk_size(const uchar *word, size_t *len, int *final)
+{
+    // Only the last chunk may be short
+    uint value = ((uint)word[0] << 24) | (word[1] << 16) | (word[2] << 8) | word[3];
+    *final = (value & AEAD_FINAL) != 0;
+    *len = value & ~AEAD_FINAL;
+    return (*len == AEAD_CHUNK || (*final && *len < AEAD_CHUNK)) ? e_success : e_failure;
+}
+
+Status aead_open_chunk(AeadStream *stream, const uchar *word, const uchar *tag)
+{
+    size_t len;
+    int final;
+    if (stream->final || stream->index == 0xFFFFFFFFu || aead_chunk_size(word, &len, &final) != e_success ||
+        len != stream->len)
+        return e_failure;
+
+    set_index(stream);
+    if (aead_open(stream->key, stream->nonce, word, 4, stream->buf, len, tag, stream->buf) != e_success)
+        return e_failure;
+    stream->index++;
+    stream->pos = 0;
+    stream->final = final;
+    return e_success;
+}
+
+void aead_stream_wipe(AeadStream *stream)
+{
+    // Volatile stores so the wipe is not optimised away
+    volatile uchar *key = stream->key;
+    for (size_t i = 0; i < sizeof(stream->key); i++)
+        key[i] = 0;
+}
+
+Status aead_random_prefix(uchar *prefix)
+{
+    return getrandom(prefix, AEAD_PREFIX_BYTES, 0) == AEAD_PREFIX_BYTES ? e_success : e_failure;
+}
+
+static int hex_value(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+Status aead_load_key(const char *path, uchar *key)
+{
+    uchar buf[2 * AEAD_KEY_BYTES + 3];
+    FILE *fptr = fopen(path, "rb");
+    if (fptr == NULL)
+    {
+        printf("ERROR: Unable to open key file %s\n", path);
+        return e_failure;
+    }
+    size_t len = fread(buf, 1, sizeof(buf), fptr);
+    fclose(fptr);
+
+    // Raw key, or hex digits with an optional line ending
+    Status status = e_failure;
+    if (len == AEAD_KEY_BYTES)
+    {
+        memcpy(key, buf, AEAD_KEY_BYTES);
+        status = e_success;
+    }
+    else
+    {
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            len--;
+        if (len == 2 * AEAD_KEY_BYTES)
+        {
+            status = e_success;
+            for (int i = 0; i < AEAD_KEY_BYTES && status == e_success; i++)
+            {
+                int hi = hex_value(buf[2 * i]), lo = hex_value(buf[2 * i + 1]);
+                if (hi < 0 || lo < 0)
+                    status = e_failure;
+                else
+                    key[i] = (hi << 4) | lo;
+            }
+        }
+    }
+
+    memset(buf, 0, sizeof(buf));
+    if (status != e_success)
+        printf("ERROR: Key file must hold 32 bytes or 64 hex digits.\n");
+    return status;
+}
@@ -0,0 +1,77 @@
+#ifndef AEAD_H
+#define AEAD_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * ChaCha20-Poly1305 (RFC 8439), used to encrypt the payload
+ * (STEGO_FLAG_AEAD). The payload is sealed as a stream of chunks so it
+ * is encrypted and authenticated in the same pass that embeds it:
+ *
+ *   8-byte random nonce prefix
+ *   per chunk: 32-bit length word, length bytes of ciphertext, 16-byte tag
+ *
+ * Every chunk but the last holds AEAD_CHUNK bytes; the last has the
+ * top bit of its length word set. A chunk's nonce is the prefix
+ * followed by its 32-bit index, and its length word is the associated
+ * data, so chunks cannot be reordered, dropped or cut short without
+ * a tag mismatch. The decoder only hands out bytes of chunks whose tag
+ * checked out.
+ */
+
+#define AEAD_KEY_BYTES 32
+#define AEAD_NONCE_BYTES 12
+#define AEAD_TAG_BYTES 16
+#define AEAD_PREFIX_BYTES 8                       // Nonce prefix stored in front of the chunks
+#define AEAD_CHUNK (16 * 1024)                    // Plaintext bytes per chunk (stays in L1/L2)
+#define AEAD_CHUNK_OVERHEAD (4 + AEAD_TAG_BYTES)  // Length word and tag
+#define AEAD_FINAL 0x80000000u                    // Length word bit of the last chunk
+
+typedef struct _AeadStream
+{
+    uchar key[AEAD_KEY_BYTES];
+    uchar nonce[AEAD_NONCE_BYTES]; // Prefix, then the chunk index (big-endian)
+    uint index;                    // Chunks sealed or opened so far
+    uchar *buf;                    // AEAD_CHUNK bytes: plaintext of the current chunk (caller-provided)
+    size_t len;                    // Bytes in buf
+    size_t pos;                    // Opening: bytes of buf already handed out
+    int final;                     // Opening: buf holds the last chunk
+} AeadStream;
+
+/* Encrypt len bytes (in may equal out) and compute the tag */
+void aead_seal(const uchar *key, const uchar *nonce, const uchar *aad, size_t aad_len, const uchar *in, size_t len,
+               uchar *out, uchar *tag);
+
+/* Check the tag, then decrypt len bytes (in may equal out); nothing is written on a mismatch */
+Status aead_open(const uchar *key, const uchar *nonce, const uchar *aad, size_t aad_len, const uchar *in, size_t len,
+                 const uchar *tag, uchar *out);
+
+/* Stored size of a sealed stream of len plaintext bytes */
+size_t aead_sealed_size(size_t len);
+
+/* Plaintext size of a sealed stream of sealed bytes ((size_t)-1 if no stream has that size) */
+size_t aead_plain_size(size_t sealed);
+
+/* Start a stream with key and prefix; buf must hold AEAD_CHUNK bytes */
+void aead_stream_init(AeadStream *stream, const uchar *key, const uchar *prefix, uchar *buf);
+
+/* Encrypt buf in place as the next chunk, filling its length word and tag */
+Status aead_seal_chunk(AeadStream *stream, int final, uchar *word, uchar *tag);
+
+/* Length and last-chunk bit of a length word (fails on lengths no encoder writes) */
+Status aead_chunk_size(const uchar *word, size_t *len, int *final);
+
+/* Check the next chunk (len bytes of ciphertext already in buf) against its length word and tag, and decrypt it */
+Status aead_open_chunk(AeadStream *stream, const uchar *word, const uchar *tag);
+
+/* Forget the key */
+void aead_stream_wipe(AeadStream *stream);
+
+/* Fill prefix with AEAD_PREFIX_BYTES random bytes */
+Status aead_random_prefix(uchar *prefix);
+
+/* Read a key file: 32 raw bytes or 64 hex digits (optionally followed by a newline) */
+Status aead_load_key(const char *path, uchar *key);
+
+#endif
@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 200809L // posix_memalign
+
+#include <stdlib.h>
+#include "arena.h"
+#include "types.h"
+
+/* Function Definitions */
+
+void arena_init(StegoArena *arena, uchar *mem, size_t size)
+{
+    // Align the start; the bytes skipped are lost to the arena
+    size_t skip = (ARENA_ALIGN - (size_t)mem % ARENA_ALIGN) % ARENA_ALIGN;
+    arena->base = size > skip ? mem + skip : NULL;
+    arena->size = size > skip ? size - skip : 0;
+    arena->used = 0;
+    arena->owned = 0;
+}
+
+Status arena_reserve(StegoArena *arena, size_t size)
+{
+    arena->used = 0;
+    if (size <= arena->size)
+        return e_success;
+    if (arena->base != NULL && !arena->owned)
+        return e_failure; // A borrowed block cannot grow
+
+    // Old contents are not kept, so free first instead of realloc copying them
+    void *base = NULL;
+    arena_free(arena);
+    if (posix_memalign(&base, ARENA_ALIGN, size) != 0)
+        return e_failure;
+
+    arena->base = base;
+    arena->size = size;
+    arena->owned = 1;
+    return e_success;
+}
+
+void *arena_alloc(StegoArena *arena, size_t len)
+{
+    len = ARENA_BYTES(len);
+    if (arena->base == NULL || len > arena->size - arena->used)
+        return NULL;
+
+    void *buf = arena->base + arena->used;
+    arena->used += len;
+    return buf;
+}
+
+void arena_reset(StegoArena *arena)
+{
+    arena->used = 0;
+}
+
+void arena_free(StegoArena *arena)
+{
+    if (arena->owned)
+        free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+    arena->owned = 0;
+}
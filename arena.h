@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Job arena: one block that a job's work buffers (carrier window,
+ * secret chunks, packed blocks) are carved from by bumping an offset.
+ * Every job starts by reserving what it needs, which empties the
+ * arena; the block is only reallocated when a job needs more than
+ * any job before it. A worker that keeps its arena between jobs
+ * therefore stops allocating once it has seen its largest job.
+ *
+ * The block is either owned (grown by arena_reserve, released by
+ * arena_free) or borrowed from the caller with arena_init.
+ */
+
+#define ARENA_ALIGN 64 // Alignment of every buffer (one cache line)
+
+typedef struct _StegoArena
+{
+    uchar *base; // Block the buffers are carved from
+    size_t size; // Bytes in base
+    size_t used; // Bytes handed out since the last reset
+    int owned;   // base came from arena_reserve
+} StegoArena;
+
+/* Arena bytes one buffer of len bytes takes (rounded up to ARENA_ALIGN) */
+#define ARENA_BYTES(len) (((len) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+/* Carve buffers from size bytes at mem, which the arena never frees */
+void arena_init(StegoArena *arena, uchar *mem, size_t size);
+
+/* Empty the arena and make sure size bytes are available (grows an owned block) */
+Status arena_reserve(StegoArena *arena, size_t size);
+
+/* Hand out len bytes, ARENA_ALIGN aligned (NULL: arena full) */
+void *arena_alloc(StegoArena *arena, size_t len);
+
+/* Take back every buffer at once */
+void arena_reset(StegoArena *arena);
+
+/* Free an owned block */
+void arena_free(StegoArena *arena);
+
+#endif
@@ -0,0 +1,782 @@
+#define _POSIX_C_SOURCE 200809L // getline, strdup, st_mtim
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch.h"
+#include "carrier.h"
+#include "carrier_cache.h"
+#include "encode.h"
+#include "decode.h"
+#include "libstego.h"
+#include "mmap_io.h"
+#include "pool.h"
+#include "stream_io.h"
+#include "uring_io.h"
+#include "types.h"
+
+typedef struct _BatchCtx BatchCtx;
+typedef struct _BatchJob BatchJob;
+
+/* One file of a job on the io_uring path */
+typedef struct
+{
+    BatchJob *job;
+    int fd;
+    uchar *buf;
+    size_t len;  // Bytes to transfer
+    size_t done; // Bytes transferred so far
+    int slot;    // Registered buffer slot, -1 for heap memory
+    int write;   // Output (else input)
+    const CarrierEntry *cached; // Carrier held by the cache (buf points into it)
+} BatchIO;
+
+struct _BatchJob
+{
+    BatchCtx *ctx;
+    int line;          // Manifest line number
+    OperationType op;  // e_encode or e_decode
+    char *text;        // Copy of the manifest line the fields point into
+    char *fields[4];   // carrier/secret/output/magic or image/output/magic
+    Status status;
+
+    // io_uring path only
+    BatchIO io[3];         // Encode: carrier, secret, stego; decode: image, output
+    BatchIO finish;        // Token of the no-op posted when no write is needed
+    int inputs;            // Files read before the job runs
+    int inflight;          // Requests not yet completed
+    int failed;            // A read or write failed
+    int blocking;          // Run on the blocking path instead
+    StegoPayloadInfo info; // Header of a decode job, peeked once its image is in
+    CarrierKey carrier;    // Identity of an encode job's carrier
+    int loading;           // Reading a carrier the cache does not hold (listed in ctx->loading)
+    int no_wait;           // Read the carrier itself: the load it waited for was not cached
+    BatchJob *next;        // Next job in ctx->loading or in a waiters list
+    BatchJob *waiters;     // Jobs on the same carrier parked until this job's read is in the cache
+};
+
+/* State owned by one worker thread and reused for all of its jobs */
+typedef struct
+{
+    EncodeInfo encInfo;
+    DecodeInfo decInfo;
+    StegoStats stats; // Counters of this worker's jobs (merged at the end)
+} BatchWorker;
+
+struct _BatchCtx
+{
+    BatchWorker *workers;
+    BatchJob *jobs;
+    int njobs;
+    int record_stats; // Fill each worker's stats
+
+    // io_uring path only (driven by the calling thread)
+    UringIO *ring;
+    ThreadPool *pool;
+    int *free_slots; // Registered buffers not in use
+    int nfree;
+    int active;      // Jobs started and not yet finished
+    StegoStats io_stats; // Reads and writes done through the ring
+    CarrierCache *cache; // Carriers reused across jobs (NULL: disabled)
+    BatchJob *loading;   // Jobs reading a carrier that later jobs may wait for
+};
+
+/* Function Definitions */
+
+static Status load_encode_job(const BatchJob *job, BatchWorker *state)
+{
+    // The arena outlives the job: buffers allocated by earlier jobs are reused
+    EncodeInfo *encInfo = &state->encInfo;
+    StegoArena arena = encInfo->arena;
+    memset(encInfo, 0, sizeof(EncodeInfo));
+    encInfo->arena = arena;
+    encInfo->threads = 1; // Parallelism comes from running jobs side by side
+    encInfo->depth = 1;
+    encInfo->checksum = 1;
+    encInfo->stats = job->ctx->record_stats ? &state->stats : NULL;
+    // Paths point into the manifest line; the magic string was checked when the line was parsed
+    encInfo->src_image_fname = job->fields[0];
+    encInfo->secret_fname = job->fields[1];
+    encInfo->stego_image_fname = job->fields[2];
+    strcpy(encInfo->usr_migc_str, job->fields[3]);
+    return e_success;
+}
+
+static Status load_decode_job(const BatchJob *job, BatchWorker *state)
+{
+    DecodeInfo *decInfo = &state->decInfo;
+    StegoArena arena = decInfo->arena;
+    memset(decInfo, 0, sizeof(DecodeInfo));
+    decInfo->arena = arena;
+    decInfo->threads = 1;
+    decInfo->stats = job->ctx->record_stats ? &state->stats : NULL;
+    decInfo->inp_image_fname = job->fields[0];
+    decInfo->out_fname = job->fields[1];
+    strcpy(decInfo->usr_migc_str, job->fields[2]);
+    return e_success;
+}
+
+static void report_job(const BatchJob *job)
+{
+    printf("JOB %d: %s %s %s -> %s\n", job->line, job->status == e_success ? "SUCCESS" : "ERROR",
+           job->op == e_encode ? "encode" : "decode", job->fields[0], job->fields[job->op == e_encode ? 2 : 1]);
+}
+
+static int run_cached_encode(BatchJob *job, BatchWorker *state)
+{
+    // A carrier seen before comes from the cache and is embedded in memory; returns 0 to leave the job to run_encode
+    EncodeInfo *encInfo = &state->encInfo;
+    CarrierCache *cache = job->ctx->cache;
+    if (is_stream_name(encInfo->src_image_fname) || is_stream_name(encInfo->stego_image_fname))
+        return 0;
+
+    int fd = open(encInfo->src_image_fname, O_RDONLY);
+    const CarrierEntry *entry = fd >= 0 ? carrier_cache_load(cache, fd) : NULL;
+    if (fd >= 0)
+        close(fd);
+    if (entry == NULL)
+        return 0;
+
+    // Pipes and empty secrets take the file path
+    size_t secret_len = 0;
+    FILE *fptr_secret = fopen(encInfo->secret_fname, "rb");
+    const uchar *secret = fptr_secret != NULL ? map_file_read(fptr_secret, &secret_len) : NULL;
+    if (secret == NULL)
+    {
+        if (fptr_secret != NULL)
+            fclose(fptr_secret);
+        carrier_cache_release(cache, entry);
+        return 0;
+    }
+
+    StegoParams params;
+    stego_default_params(&params);
+    params.stats = encInfo->stats;
+    get_secret_file_extn(encInfo);
+
+    // Same settings as load_encode_job, so the output matches run_encode byte for byte
+    FILE *fptr_out = fopen(encInfo->stego_image_fname, "w+b");
+    uchar *stego = fptr_out != NULL ? map_file_write(fptr_out, entry->len) : NULL;
+    if (stego == NULL)
+        fprintf(stderr, "ERROR: Unable to open file %s\n", encInfo->stego_image_fname);
+    else
+        job->status = stego_embed(entry->data, entry->len, secret, secret_len, encInfo->usr_migc_str,
+                                  encInfo->extn_secret_file, &params, stego, entry->len, NULL, 0);
+
+    unmap_file(stego, entry->len);
+    if (fptr_out != NULL)
+        fclose(fptr_out);
+    unmap_file(secret, secret_len);
+    fclose(fptr_secret);
+    carrier_cache_release(cache, entry);
+    return 1;
+}
+
+static void run_batch_job(void *arg, int worker)
+{
+    BatchJob *job = arg;
+    BatchWorker *state = &job->ctx->workers[worker];
+
+    job->status = e_failure;
+    if (job->op == e_encode)
+    {
+        if (load_encode_job(job, state) == e_success && (job->ctx->cache == NULL || !run_cached_encode(job, state)))
+            job->status = run_encode(&state->encInfo);
+    }
+    else if (load_decode_job(job, state) == e_success)
+    {
+        job->status = run_decode(&state->decInfo);
+    }
+
+    report_job(job);
+}
+
+/*
+ * io_uring path. The calling thread keeps up to BATCH_JOBS_PER_THREAD
+ * jobs per worker in flight: it opens their inputs and queues the
+ * reads, and when all of a job's reads are in hands the job to the
+ * pool. The worker runs the in-memory engine (libstego) and queues
+ * the output write on the same ring, so reads for later jobs and
+ * writes of earlier ones overlap with the embedding and extraction.
+ * Jobs the ring cannot serve (not regular files, framed payloads,
+ * errors to report) run on the blocking path inside the worker.
+ */
+
+static Status alloc_io(BatchCtx *ctx, BatchIO *io, BatchJob *job, size_t len)
+{
+    io->job = job;
+    io->len = len;
+    io->done = 0;
+    if (len <= URING_SLOT_SIZE && ctx->nfree > 0)
+    {
+        io->slot = ctx->free_slots[--ctx->nfree];
+        io->buf = uring_slot(ctx->ring, io->slot);
+        return e_success;
+    }
+
+    io->slot = -1;
+    io->buf = malloc(len ? len : 1);
+    return io->buf != NULL ? e_success : e_failure;
+}
+
+static void release_io(BatchCtx *ctx, BatchIO *io)
+{
+    if (io->fd >= 0)
+        close(io->fd);
+    if (io->cached != NULL)
+        carrier_cache_release(ctx->cache, io->cached);
+    else if (io->slot >= 0)
+        ctx->free_slots[ctx->nfree++] = io->slot;
+    else
+        free(io->buf);
+    io->cached = NULL;
+    io->fd = -1;
+    io->buf = NULL;
+    io->slot = -1;
+}
+
+static void finish_job(BatchCtx *ctx, BatchJob *job)
+{
+    for (int i = 0; i < 3; i++)
+        release_io(ctx, &job->io[i]);
+
+    // The blocking path has reported the job already
+    if (!job->blocking)
+    {
+        if (job->failed)
+            job->status = e_failure;
+        report_job(job);
+    }
+    ctx->active--;
+}
+
+static Status queue_io(BatchCtx *ctx, BatchIO *io)
+{
+    uchar *buf = io->buf + io->done;
+    size_t len = io->len - io->done;
+    if (io->write)
+        return uring_queue_write(ctx->ring, io->fd, buf, len, io->done, io->slot, io);
+    return uring_queue_read(ctx->ring, io->fd, buf, len, io->done, io->slot, io);
+}
+
+static void run_uring_job(void *arg, int worker)
+{
+    BatchJob *job = arg;
+    BatchCtx *ctx = job->ctx;
+    BatchWorker *state = &ctx->workers[worker];
+
+    if (job->blocking)
+    {
+        run_batch_job(arg, worker);
+        if (uring_queue_nop(ctx->ring, &job->finish) == e_success)
+            uring_submit(ctx->ring);
+        return;
+    }
+
+    StegoParams params;
+    stego_default_params(&params);
+
+    BatchIO *out = &job->io[job->inputs];
+    const char *name = NULL; // Output file
+    char *decoded_name = NULL;
+    size_t out_len = out->len;
+    job->status = e_failure;
+
+    if (job->op == e_encode)
+    {
+        if (load_encode_job(job, state) == e_success)
+        {
+            EncodeInfo *encInfo = &state->encInfo;
+            get_secret_file_extn(encInfo);
+            params.stats = encInfo->stats;
+            name = encInfo->stego_image_fname;
+            job->status = stego_embed(job->io[0].buf, job->io[0].len, job->io[1].buf, job->io[1].len,
+                                      encInfo->usr_migc_str, encInfo->extn_secret_file, &params, out->buf, out->len,
+                                      NULL, 0);
+        }
+    }
+    else if (load_decode_job(job, state) == e_success)
+    {
+        // The stored extension is known from the peek, so the output gets its final name at once
+        DecodeInfo *decInfo = &state->decInfo;
+        params.stats = decInfo->stats;
+        name = decoded_name = output_file_name(decInfo->out_fname, job->info.extn);
+
+        // The worker's decode arena holds the work buffers between its blocking jobs
+        uchar *work = arena_reserve(&decInfo->arena, stego_work_size()) == e_success
+                          ? arena_alloc(&decInfo->arena, stego_work_size())
+                          : NULL;
+        if (name != NULL)
+            job->status = stego_extract(job->io[0].buf, job->io[0].len, decInfo->usr_migc_str, &params, out->buf,
+                                        out->len, &out_len, NULL, work, stego_work_size());
+    }
+
+    if (job->status == e_success && (out->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    {
+        perror("open");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", name);
+        job->status = e_failure;
+    }
+    free(decoded_name);
+
+    // Inputs are no longer needed; the calling thread returns their buffers when the job finishes
+    out->len = out_len;
+    out->write = 1;
+    job->inflight = 1;
+    if (job->status == e_success && out->len > 0)
+    {
+        if (queue_io(ctx, out) != e_success)
+        {
+            job->failed = 1;
+            uring_queue_nop(ctx->ring, &job->finish);
+        }
+    }
+    else
+    {
+        uring_queue_nop(ctx->ring, &job->finish);
+    }
+    uring_submit(ctx->ring);
+}
+
+static void start_job(BatchCtx *ctx, BatchJob *job);
+
+static BatchJob *find_loader(BatchCtx *ctx, const CarrierKey *key)
+{
+    for (BatchJob *loader = ctx->loading; loader != NULL; loader = loader->next)
+    {
+        if (memcmp(&loader->carrier, key, sizeof(CarrierKey)) == 0)
+            return loader;
+    }
+    return NULL;
+}
+
+static void wake_waiters(BatchCtx *ctx, BatchJob *job)
+{
+    if (!job->loading)
+        return;
+    BatchJob **link = &ctx->loading;
+    while (*link != job)
+        link = &(*link)->next;
+    *link = job->next;
+    job->loading = 0;
+
+    // Parked jobs start over and find the carrier in the cache, or read it themselves if it was not kept
+    BatchJob *waiter = job->waiters;
+    job->waiters = NULL;
+    while (waiter != NULL)
+    {
+        BatchJob *next = waiter->next;
+        waiter->no_wait = job->io[0].cached == NULL;
+        ctx->active--; // start_job counts it again
+        start_job(ctx, waiter);
+        waiter = next;
+    }
+}
+
+static void dispatch_job(BatchCtx *ctx, BatchJob *job)
+{
+    // All inputs are in memory: size the output buffer, then hand the job to a worker
+    BatchIO *in = &job->io[0];
+    size_t out_len = in->len; // Encode: the stego image is as large as the carrier
+    if (!job->failed && !job->blocking)
+    {
+        if (job->op == e_decode)
+        {
+            // Unknown magic, damaged header or framed payload: let the blocking path handle and report it
+            if (stego_peek(in->buf, in->len, job->fields[2], &job->info) != e_success ||
+                job->info.size == STEGO_SIZE_UNKNOWN)
+            {
+                job->blocking = 1;
+            }
+            out_len = job->info.size;
+        }
+        else
+        {
+            // Encoded carriers (PNG) are stored back by the file calls: the output size is not known up front
+            BmpInfo layout;
+            if (probe_carrier_header(in->buf, in->len, &layout) == e_success && carrier_encoded(&layout))
+                job->blocking = 1;
+        }
+
+        // A carrier the cache admits is kept; its slot goes back at once
+        if (job->op == e_encode && !job->blocking && ctx->cache != NULL && in->cached == NULL)
+        {
+            const CarrierEntry *entry = carrier_cache_add(ctx->cache, &job->carrier, in->buf, in->len);
+            if (entry != NULL)
+            {
+                release_io(ctx, in);
+                in->cached = entry;
+                in->buf = entry->data;
+                in->len = entry->len;
+            }
+        }
+    }
+    wake_waiters(ctx, job);
+
+    if (!job->failed && !job->blocking)
+    {
+        if (alloc_io(ctx, &job->io[job->inputs], job, out_len) != e_success)
+            job->failed = 1;
+    }
+
+    if (job->blocking)
+    {
+        for (int i = 0; i < 3; i++)
+            release_io(ctx, &job->io[i]);
+    }
+
+    if (job->failed || pool_submit(ctx->pool, run_uring_job, job) != e_success)
+    {
+        job->failed = 1;
+        finish_job(ctx, job);
+    }
+}
+
+static void start_job(BatchCtx *ctx, BatchJob *job)
+{
+    ctx->active++;
+    job->status = e_failure;
+    job->inputs = job->op == e_encode ? 2 : 1;
+    job->finish.job = job;
+    for (int i = 0; i < 3; i++)
+    {
+        job->io[i].fd = -1;
+        job->io[i].slot = -1;
+    }
+
+    // Open every input first; anything but a regular file goes to the blocking path
+    for (int i = 0; i < job->inputs && !job->blocking; i++)
+    {
+        struct stat st;
+        BatchIO *io = &job->io[i];
+        io->fd = open(job->fields[i], O_RDONLY);
+        if (io->fd < 0 || fstat(io->fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            job->blocking = 1;
+            break;
+        }
+
+        // A cached carrier needs no read at all
+        if (i == 0 && job->op == e_encode && ctx->cache != NULL)
+        {
+            // Another job in the window is reading this carrier already: wait for its copy
+            carrier_key(&st, &job->carrier);
+            BatchJob *loader = job->no_wait ? NULL : find_loader(ctx, &job->carrier);
+            if (loader != NULL)
+            {
+                release_io(ctx, io);
+                job->next = loader->waiters;
+                loader->waiters = job;
+                return;
+            }
+            io->cached = carrier_cache_find(ctx->cache, &job->carrier);
+        }
+        if (io->cached != NULL)
+        {
+            io->job = job;
+            io->buf = io->cached->data;
+            io->len = io->done = io->cached->len;
+        }
+        else if (alloc_io(ctx, io, job, st.st_size) != e_success)
+        {
+            job->blocking = 1;
+        }
+        else if (i == 0 && job->op == e_encode && ctx->cache != NULL)
+        {
+            job->loading = 1;
+            job->next = ctx->loading;
+            ctx->loading = job;
+        }
+    }
+
+    if (!job->blocking)
+    {
+        for (int i = 0; i < job->inputs && !job->failed; i++)
+        {
+            if (job->io[i].done == job->io[i].len)
+                continue;
+            if (queue_io(ctx, &job->io[i]) == e_success)
+                job->inflight++;
+            else
+                job->failed = 1;
+        }
+    }
+
+    if (job->inflight == 0)
+        dispatch_job(ctx, job);
+}
+
+static void complete_io(BatchCtx *ctx, BatchIO *io, int res)
+{
+    BatchJob *job = io->job;
+    if (io == &job->finish)
+    {
+        finish_job(ctx, job);
+        return;
+    }
+
+    StegoStats *stats = ctx->record_stats ? &ctx->io_stats : NULL;
+    STATS_BEGIN(stats, io->write ? STAGE_CLOSE : STAGE_OPEN);
+    STATS_IO(stats, io->write || res < 0 ? 0 : res, io->write && res > 0 ? res : 0, 1);
+    STATS_END(stats);
+
+    // A file that shrank under us reads short with 0
+    if (res <= 0)
+    {
+        job->failed = 1;
+    }
+    else
+    {
+        io->done += res;
+        if (io->done < io->len)
+        {
+            if (queue_io(ctx, io) == e_success)
+                return; // Same request count, rest of the transfer
+            job->failed = 1;
+        }
+    }
+
+    if (--job->inflight > 0)
+        return;
+    if (io->write)
+        finish_job(ctx, job);
+    else
+        dispatch_job(ctx, job);
+}
+
+static Status run_uring_batch(BatchCtx *ctx, int nthreads)
+{
+    int window = BATCH_JOBS_PER_THREAD * nthreads;
+    int nslots = uring_slot_count(ctx->ring);
+    ctx->free_slots = malloc((nslots + 1) * sizeof(int));
+    if (ctx->free_slots == NULL)
+        return e_failure;
+    for (ctx->nfree = 0; ctx->nfree < nslots; ctx->nfree++)
+        ctx->free_slots[ctx->nfree] = nslots - 1 - ctx->nfree;
+
+    UringEvent events[BATCH_EVENTS];
+    int next = 0;
+    Status status = e_success;
+    while (next < ctx->njobs || ctx->active > 0)
+    {
+        while (ctx->active < window && next < ctx->njobs)
+            start_job(ctx, &ctx->jobs[next++]);
+
+        // Reads of new jobs go to the kernel together
+        if (ctx->active == 0)
+            continue;
+        int n = uring_wait(ctx->ring, events, BATCH_EVENTS);
+        if (n < 0)
+        {
+            printf("ERROR: %s function failed\n", "uring_wait");
+            status = e_failure; // Jobs still in flight keep their failure status
+            break;
+        }
+        for (int i = 0; i < n; i++)
+            complete_io(ctx, events[i].user_data, events[i].res);
+    }
+
+    return status;
+}
+
+static Status parse_job(char *line, int line_no, BatchJob *job)
+{
+    char *argv[7] = {"batch"};
+    int argc = 1;
+
+    // Split the line into an argv-style array
+    for (char *tok = strtok(line, " \t\r\n"); tok != NULL && argc < 7; tok = strtok(NULL, " \t\r\n"))
+        argv[argc++] = tok;
+
+    if (argc == 1 || argv[1][0] == '#')
+        return e_success; // Blank or comment
+
+    // A bare job line is an encode job
+    if (strcmp(argv[1], "-e") != 0 && strcmp(argv[1], "-d") != 0)
+    {
+        if (argc > 5)
+            return e_failure;
+        memmove(&argv[2], &argv[1], argc * sizeof(char *));
+        argv[1] = "-e";
+        argc++;
+    }
+
+    job->line = line_no;
+    job->op = check_operation_type(argv);
+    if (job->op == e_encode)
+    {
+        if (argc != 6 || read_and_validate_encode_args(argc, argv) != e_success)
+            return e_failure;
+    }
+    else if (argc != 5 || read_and_validate_decode_args(argc, argv) != e_success)
+    {
+        return e_failure;
+    }
+
+    // Paths may be any length; the magic string must fit the Info fields
+    if (strlen(argv[argc - 1]) > STEGO_MAX_MAGIC)
+    {
+        printf("ERROR: Magic string too long on manifest line %d\n", line_no);
+        return e_failure;
+    }
+
+    for (int i = 0; i < argc - 2; i++)
+        job->fields[i] = argv[i + 2];
+    return e_success;
+}
+
+static Status read_manifest(const char *manifest, BatchCtx *ctx)
+{
+    FILE *fptr = fopen(manifest, "r");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", manifest);
+        return e_failure;
+    }
+
+    int line_no = 0, cap_jobs = 0;
+    char *line = NULL; // Grown by getline: lines of long paths are read whole
+    size_t line_cap = 0;
+    Status status = e_success;
+
+    while (status == e_success && getline(&line, &line_cap, fptr) != -1)
+    {
+        line_no++;
+        if (ctx->njobs == cap_jobs)
+        {
+            cap_jobs = cap_jobs ? 2 * cap_jobs : 64;
+            BatchJob *jobs = realloc(ctx->jobs, cap_jobs * sizeof(BatchJob));
+            if (jobs == NULL)
+            {
+                status = e_failure;
+                break;
+            }
+            ctx->jobs = jobs;
+        }
+
+        // Each job keeps its own copy of the line for its fields
+        BatchJob *job = &ctx->jobs[ctx->njobs];
+        memset(job, 0, sizeof(BatchJob));
+        job->text = strdup(line);
+        if (job->text == NULL)
+        {
+            status = e_failure;
+        }
+        else if (parse_job(job->text, line_no, job) != e_success)
+        {
+            printf("ERROR: Invalid job on manifest line %d\n", line_no);
+            free(job->text);
+            status = e_failure;
+        }
+        else if (job->fields[0] == NULL)
+        {
+            free(job->text); // Blank or comment line
+        }
+        else
+        {
+            job->ctx = ctx;
+            ctx->njobs++;
+        }
+    }
+
+    free(line);
+    fclose(fptr);
+    return status;
+}
+
+static void free_jobs(BatchCtx *ctx)
+{
+    for (int i = 0; i < ctx->njobs; i++)
+        free(ctx->jobs[i].text);
+    free(ctx->jobs);
+    free(ctx->workers);
+    free(ctx->free_slots);
+}
+
+Status do_batch(const char *manifest, int nthreads, int use_uring, size_t cache_bytes, StegoStats *stats)
+{
+    BatchCtx ctx = {0};
+    ctx.record_stats = stats != NULL;
+
+    if (read_manifest(manifest, &ctx) != e_success)
+    {
+        free_jobs(&ctx);
+        return e_failure;
+    }
+
+    if (nthreads > ctx.njobs && ctx.njobs > 0)
+        nthreads = ctx.njobs;
+
+    ctx.workers = calloc(nthreads, sizeof(BatchWorker));
+    ThreadPool *pool = ctx.workers ? pool_create(nthreads) : NULL;
+    if (pool == NULL)
+    {
+        free_jobs(&ctx);
+        return e_failure;
+    }
+
+    // Without io_uring (old kernel, seccomp, --no-uring) every job does blocking I/O on its worker
+    if (use_uring && ctx.njobs > 0)
+        ctx.ring = uring_create(BATCH_RING_ENTRIES, BATCH_SLOTS_PER_JOB * BATCH_JOBS_PER_THREAD * nthreads);
+
+    // Both paths share carriers through the cache
+    ctx.cache = cache_bytes > 0 ? carrier_cache_create(cache_bytes) : NULL;
+
+    Status status = e_success;
+    if (ctx.ring != NULL)
+    {
+        ctx.pool = pool;
+        status = run_uring_batch(&ctx, nthreads);
+    }
+    else
+    {
+        for (int i = 0; i < ctx.njobs; i++)
+        {
+            ctx.jobs[i].status = e_failure;
+            if (pool_submit(pool, run_batch_job, &ctx.jobs[i]) != e_success)
+                printf("ERROR: Unable to queue job on manifest line %d\n", ctx.jobs[i].line);
+        }
+    }
+
+    pool_wait(pool);
+    pool_destroy(pool);
+    uring_destroy(ctx.ring);
+
+    // Workers count without locks; add them up once all jobs are done
+    for (int i = 0; i < nthreads; i++)
+    {
+        if (stats != NULL)
+            stats_merge(stats, &ctx.workers[i].stats);
+        arena_free(&ctx.workers[i].encInfo.arena);
+        arena_free(&ctx.workers[i].decInfo.arena);
+    }
+    if (stats != NULL)
+        stats_merge(stats, &ctx.io_stats);
+
+    // Every job has released its carrier
+    if (ctx.cache != NULL)
+    {
+        StegoStats cache_stats;
+        stats_reset(&cache_stats);
+        carrier_cache_stats(ctx.cache, &cache_stats);
+        if (cache_stats.cache_hits + cache_stats.cache_misses > 0)
+            printf("Carrier cache: %llu hits, %llu misses\n", cache_stats.cache_hits, cache_stats.cache_misses);
+        if (stats != NULL)
+            stats_merge(stats, &cache_stats);
+    }
+    carrier_cache_destroy(ctx.cache);
+
+    // Summarise per-job results
+    int passed = 0;
+    for (int i = 0; i < ctx.njobs; i++)
+        if (ctx.jobs[i].status == e_success)
+            passed++;
+    printf("Batch: %d of %d jobs succeeded\n", passed, ctx.njobs);
+
+    free_jobs(&ctx);
+    return passed == ctx.njobs && status == e_success ? e_success : e_failure;
+}
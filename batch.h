@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "stats.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Batch mode: run many encode/decode jobs from a manifest
+ * inside one process on a work-stealing thread pool.
+ *
+ * Manifest format, one job per line (blank lines and lines
+ * starting with '#' are skipped):
+ *   [-e] <carrier.bmp> <secret_file> <output.bmp> <magic_string>
+ *   -d   <stego.bmp> <output_name> <magic_string>
+ * Images may be of any carrier format (carrier.h); PNG carriers are
+ * always encoded on the blocking path.
+ *
+ * Where the kernel allows io_uring, the calling thread reads the
+ * inputs of upcoming jobs and writes the outputs of finished ones
+ * through one ring while the workers embed and extract in memory.
+ * Otherwise each worker does blocking I/O for its own jobs.
+ * On both paths, carriers used by more than one job are kept in a
+ * carrier cache (carrier_cache.h) and read from disk only once.
+ */
+
+#define BATCH_JOBS_PER_THREAD 2 // Jobs in flight per worker on the io_uring path
+#define BATCH_SLOTS_PER_JOB 3   // Registered buffers a job can use (carrier, secret, stego)
+#define BATCH_RING_ENTRIES 256  // Submission queue size
+#define BATCH_EVENTS 64         // Completions reaped per wait
+
+/* Run every job in manifest on nthreads workers (use_uring: try io_uring first, with cache_bytes of carrier cache), adding stage counters to stats (if not NULL) */
+Status do_batch(const char *manifest, int nthreads, int use_uring, size_t cache_bytes, StegoStats *stats);
+
+#endif
@@ -0,0 +1,450 @@
+/*
+Benchmark harness for the encode and decode paths.
+
+Generates synthetic BMP carriers (several sizes, 24 and 32 bits per
+pixel) and payloads from a few bytes to megabytes in a scratch
+directory, then runs every encoder and decoder stage on them.
+
+Each line of output is one JSON object:
+
+  {"op":"encode","stage":"payload","width":1024,"height":768,"bpp":24,
+   "depth":1,"payload":262144,"bytes":262144,"best_ns":...,"mb_per_s":...,
+   "cycles_per_byte":...,"peak_rss_kb":...}
+
+  stage     open, header, magic, fields, payload, tail, close or total
+  bytes     bytes handled by that stage (mb_per_s and cycles_per_byte use it);
+            open counts the carrier when it is cloned into the output, and
+            header and tail then count 0 (their copies are skipped)
+  best_ns   fastest of the iterations
+  peak_rss  process high-water mark so far (ru_maxrss)
+
+Cycles come from the time stamp counter where there is one, else 0.
+Status messages of the stages are discarded; only results reach stdout.
+
+Usage:
+  ./stegobench [-n iterations] [-k depth] [-j threads]
+*/
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, mkdtemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "encode.h"
+#include "decode.h"
+#include "stego_header.h"
+#include "types.h"
+
+#define BENCH_CARRIER "carrier.bmp"
+#define BENCH_SECRET "secret.bin"
+#define BENCH_STEGO "stego.bmp"
+#define BENCH_OUT "out"
+#define BENCH_MAGIC "#*"
+
+typedef enum
+{
+    st_open,
+    st_header,
+    st_magic,
+    st_fields,
+    st_payload,
+    st_tail,
+    st_close,
+    st_total,
+    st_count
+} Stage;
+
+static const char *stage_names[st_count] = {"open", "header", "magic", "fields", "payload", "tail", "close", "total"};
+
+typedef struct
+{
+    unsigned long long ns;     // Wall time
+    unsigned long long cycles; // Time stamp counter ticks
+    size_t bytes;              // Bytes handled
+} Sample;
+
+typedef struct
+{
+    uint width, height, bpp;
+} Carrier;
+
+static const Carrier carriers[] = {{256, 256, 24}, {1024, 768, 24}, {1024, 768, 32}, {2048, 2048, 24}};
+static const size_t payloads[] = {16, 4096, 256 * 1024, 1024 * 1024};
+
+static FILE *report; // Real stdout; stdout itself goes to /dev/null
+
+/* Function Definitions */
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned long long now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void sample_begin(Sample *s)
+{
+    s->ns = now_ns();
+    s->cycles = now_cycles();
+}
+
+static void sample_end(Sample *s, size_t bytes)
+{
+    s->ns = now_ns() - s->ns;
+    s->cycles = now_cycles() - s->cycles;
+    s->bytes = bytes;
+}
+
+static uint xorshift(uint *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void put_le(uchar *p, uint value, int n)
+{
+    for (int i = 0; i < n; i++)
+        p[i] = value >> (8 * i);
+}
+
+static Status write_carrier(const Carrier *c)
+{
+    // 54-byte BITMAPINFOHEADER image with noisy pixels and padded rows
+    size_t row = ((size_t)c->width * c->bpp / 8 + 3) & ~(size_t)3;
+    uchar header[BMP_HEADER_SIZE] = {'B', 'M'};
+    put_le(header + 2, BMP_HEADER_SIZE + row * c->height, 4);
+    put_le(header + 10, BMP_HEADER_SIZE, 4);
+    put_le(header + 14, 40, 4);
+    put_le(header + 18, c->width, 4);
+    put_le(header + 22, c->height, 4);
+    put_le(header + 26, 1, 2);
+    put_le(header + 28, c->bpp, 2);
+
+    FILE *fp = fopen(BENCH_CARRIER, "wb");
+    uchar *line = calloc(row, 1);
+    uint seed = 0x2545F491u;
+    Status status = (fp != NULL && line != NULL && fwrite(header, 1, sizeof(header), fp) == sizeof(header)) ? e_success : e_failure;
+
+    for (uint y = 0; y < c->height && status == e_success; y++)
+    {
+        for (size_t x = 0; x < (size_t)c->width * c->bpp / 8; x++)
+            line[x] = xorshift(&seed);
+        if (fwrite(line, 1, row, fp) != row)
+            status = e_failure;
+    }
+
+    free(line);
+    if (fp != NULL)
+        fclose(fp);
+    return status;
+}
+
+static Status write_secret(size_t size)
+{
+    // Text-like payload: repeated words with some noise
+    static const char words[] = "alpha beta gamma delta {\"id\": 42, \"name\": \"stego\"}\n";
+    FILE *fp = fopen(BENCH_SECRET, "wb");
+    uint seed = 0x9E3779B9u;
+    if (fp == NULL)
+        return e_failure;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        int c = (xorshift(&seed) & 7) ? words[i % (sizeof(words) - 1)] : (char)('a' + xorshift(&seed) % 26);
+        fputc(c, fp);
+    }
+    return fclose(fp) == 0 ? e_success : e_failure;
+}
+
+static Status bench_encode(Sample *samples, uint depth, int threads)
+{
+    EncodeInfo encInfo;
+    Sample total;
+
+    memset(&encInfo, 0, sizeof(encInfo));
+    encInfo.src_image_fname = BENCH_CARRIER;
+    encInfo.secret_fname = BENCH_SECRET;
+    encInfo.stego_image_fname = BENCH_STEGO;
+    strcpy(encInfo.usr_migc_str, BENCH_MAGIC);
+    encInfo.size_usr_migc_str = strlen(BENCH_MAGIC);
+    encInfo.depth = depth;
+    encInfo.checksum = 1;
+    encInfo.threads = threads;
+
+    // Same steps as run_encode/do_encoding, one sample per stage
+    sample_begin(&total);
+    sample_begin(&samples[st_open]);
+    if (open_files(&encInfo) != e_success)
+        return e_failure;
+    sample_end(&samples[st_open], encInfo.cloned ? encInfo.map_size : 0); // Opening clones the carrier
+    encInfo.image_capacity = get_image_size_for_bmp(&encInfo.bmp);
+    encInfo.size_secret_file = get_file_size(encInfo.fptr_secret);
+    get_secret_file_extn(&encInfo);
+
+    Status status = alloc_encode_buffers(&encInfo);
+    if (status == e_success)
+        status = check_capacity(&encInfo);
+    size_t payload = encInfo.size_secret_file;
+
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_header]);
+        status = copy_bmp_header(&encInfo);
+        sample_end(&samples[st_header], encInfo.cloned ? 0 : encInfo.bmp.data_offset);
+    }
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_magic]);
+        status = encode_magic_string(encInfo.usr_migc_str, &encInfo);
+        if (status == e_success)
+            status = encode_stego_header(&encInfo);
+        sample_end(&samples[st_magic], encInfo.size_usr_migc_str);
+    }
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_fields]);
+        status = encode_secret_file_extn(&encInfo);
+        if (status == e_success)
+            status = encode_secret_file_size(encInfo.size_secret_file, &encInfo);
+        if (status == e_success)
+            status = encode_header_crc(&encInfo);
+        sample_end(&samples[st_fields], 4 + encInfo.size_extn_secret_file + 4);
+    }
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_payload]);
+        status = encode_secret_file_data(&encInfo);
+        sample_end(&samples[st_payload], payload);
+    }
+    if (status == e_success)
+    {
+        size_t tail = encInfo.cloned ? 0 : encInfo.bmp.image_end - encInfo.carrier_pos;
+        sample_begin(&samples[st_tail]);
+        status = copy_remaining_carrier(&encInfo);
+        sample_end(&samples[st_tail], tail);
+    }
+
+    sample_begin(&samples[st_close]);
+    close_files(&encInfo);
+    sample_end(&samples[st_close], encInfo.bmp.image_end);
+    arena_free(&encInfo.arena);
+    sample_end(&total, payload);
+    samples[st_total] = total;
+    return status;
+}
+
+static Status bench_decode(Sample *samples, int threads, size_t payload)
+{
+    DecodeInfo decInfo;
+    Sample total;
+
+    memset(&decInfo, 0, sizeof(decInfo));
+    decInfo.inp_image_fname = BENCH_STEGO;
+    decInfo.out_fname = BENCH_OUT;
+    strcpy(decInfo.usr_migc_str, BENCH_MAGIC);
+    decInfo.size_usr_migc_str = strlen(BENCH_MAGIC);
+    decInfo.threads = threads;
+
+    // Same steps as run_decode/do_decoding, one sample per stage
+    sample_begin(&total);
+    sample_begin(&samples[st_open]);
+    if (open_files_dec(&decInfo) != e_success)
+        return e_failure;
+    sample_end(&samples[st_open], 0);
+
+    sample_begin(&samples[st_header]);
+    Status status = parse_stego_image(&decInfo);
+    sample_end(&samples[st_header], decInfo.bmp.data_offset);
+
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_magic]);
+        status = magic_string_status(decInfo.usr_migc_str, &decInfo);
+        sample_end(&samples[st_magic], decInfo.size_usr_migc_str);
+    }
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_fields]);
+        if (get_size_extn_out_file(&decInfo) != e_success || get_extn_out_file(&decInfo) != e_success ||
+            get_size_out_file(&decInfo) != e_success)
+            status = e_failure;
+        sample_end(&samples[st_fields], 4 + decInfo.size_extn_out_file + 4);
+    }
+    if (status == e_success)
+    {
+        sample_begin(&samples[st_payload]);
+        status = write_out_file(&decInfo);
+        sample_end(&samples[st_payload], payload);
+    }
+    samples[st_tail].ns = samples[st_tail].cycles = samples[st_tail].bytes = 0; // Decode never reads the tail
+
+    sample_begin(&samples[st_close]);
+    close_files_dec(&decInfo);
+    sample_end(&samples[st_close], payload);
+    arena_free(&decInfo.arena);
+    sample_end(&total, payload);
+    samples[st_total] = total;
+    return status;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void print_samples(const char *op, const Carrier *c, uint depth, size_t payload, const Sample *best)
+{
+    for (int st = 0; st < st_count; st++)
+    {
+        const Sample *s = &best[st];
+        if (s->bytes == 0 && st == st_tail && strcmp(op, "decode") == 0)
+            continue;
+
+        double mbps = s->ns ? (double)s->bytes / (1024.0 * 1024.0) / (s->ns / 1e9) : 0.0;
+        double cpb = s->bytes ? (double)s->cycles / s->bytes : 0.0;
+        fprintf(report,
+                "{\"op\":\"%s\",\"stage\":\"%s\",\"width\":%u,\"height\":%u,\"bpp\":%u,\"depth\":%u,"
+                "\"payload\":%zu,\"bytes\":%zu,\"best_ns\":%llu,\"mb_per_s\":%.2f,\"cycles_per_byte\":%.2f,"
+                "\"peak_rss_kb\":%ld}\n",
+                op, stage_names[st], c->width, c->height, c->bpp, depth, payload, s->bytes, s->ns, mbps, cpb,
+                peak_rss_kb());
+    }
+    fflush(report);
+}
+
+static void keep_best(Sample *best, const Sample *run, int first)
+{
+    for (int st = 0; st < st_count; st++)
+    {
+        if (first || run[st].ns < best[st].ns)
+            best[st] = run[st];
+    }
+}
+
+static Status run_case(const Carrier *c, size_t payload, uint depth, int threads, int iterations)
+{
+    Sample best[st_count], run[st_count];
+    memset(best, 0, sizeof(best));
+
+    // Skip payloads the carrier cannot hold at this depth
+    size_t capacity = (size_t)c->width * c->height * (c->bpp / 8) * depth / 8;
+    if (payload + 64 > capacity)
+        return e_success;
+
+    if (write_secret(payload) != e_success)
+        return e_failure;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        memset(run, 0, sizeof(run));
+        if (bench_encode(run, depth, threads) != e_success)
+            return e_failure;
+        keep_best(best, run, i == 0);
+    }
+    print_samples("encode", c, depth, payload, best);
+
+    for (int i = 0; i < iterations; i++)
+    {
+        memset(run, 0, sizeof(run));
+        if (bench_decode(run, threads, payload) != e_success)
+            return e_failure;
+        keep_best(best, run, i == 0);
+    }
+    print_samples("decode", c, depth, payload, best);
+    return e_success;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = 5;
+    int depth = 1;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-n iterations] [-k depth] [-j threads]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations < 1 || depth < 1 || depth > STEGO_MAX_DEPTH || threads < 1)
+    {
+        fprintf(stderr, "ERROR: Invalid benchmark settings.\n");
+        return 1;
+    }
+
+    // Work in a scratch directory: Info structs hold short file names
+    char dir[] = "/tmp/stegobench.XXXXXX";
+    if (mkdtemp(dir) == NULL || chdir(dir) != 0)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    // Results keep the real stdout; stage status messages are dropped
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (report == NULL || freopen("/dev/null", "w", stdout) == NULL)
+    {
+        perror("stdout");
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t c = 0; c < sizeof(carriers) / sizeof(carriers[0]) && status == 0; c++)
+    {
+        if (write_carrier(&carriers[c]) != e_success)
+        {
+            fprintf(stderr, "ERROR: Unable to create carrier %ux%u\n", carriers[c].width, carriers[c].height);
+            status = 1;
+            break;
+        }
+
+        for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++)
+        {
+            if (run_case(&carriers[c], payloads[p], depth, threads, iterations) != e_success)
+            {
+                fprintf(stderr, "ERROR: Benchmark %ux%u/%u failed for %zu bytes\n", carriers[c].width,
+                        carriers[c].height, carriers[c].bpp, payloads[p]);
+                status = 1;
+                break;
+            }
+        }
+    }
+
+    // Clean up the scratch directory
+    unlink(BENCH_CARRIER);
+    unlink(BENCH_SECRET);
+    unlink(BENCH_STEGO);
+    unlink(BENCH_OUT);
+    if (chdir("/") == 0)
+        rmdir(dir);
+
+    fclose(report);
+    return status;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include "bmp.h"
+#include "carrier.h"
+#include "types.h"
+
+/* Function Definitions */
+
+static uint read_u16(const uchar *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint read_u32(const uchar *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint)p[3] << 24);
+}
+
+const char *check_bmp_header(const uchar *buf, size_t len, BmpInfo *bmp)
+{
+    // Returns the reason the header is rejected, NULL if it is usable
+    if (len < BMP_HEADER_SIZE)
+        return carrier_short;
+    if (buf[0] != 'B' || buf[1] != 'M')
+        return "Not a BMP image.";
+
+    bmp->data_offset = read_u32(buf + 10);
+    bmp->info_size = read_u32(buf + 14);
+    bmp->width = read_u32(buf + 18);
+    int height = (int)read_u32(buf + 22);
+    uint planes = read_u16(buf + 26);
+    bmp->bpp = read_u16(buf + 28);
+    uint compression = read_u32(buf + 30);
+
+    // Only uncompressed true-colour images carry raw channel bytes
+    if (bmp->info_size < 40 || planes != 1 || (bmp->bpp != 24 && bmp->bpp != 32) ||
+        !(compression == 0 || (compression == 3 && bmp->bpp == 32)))
+        return "Unsupported BMP format (only uncompressed 24/32-bit).";
+
+    if (bmp->width == 0 || height == 0 || height == (int)0x80000000 || bmp->width > 0x7FFFFFFF / 4 ||
+        bmp->data_offset < BMP_FILE_HEADER_SIZE + bmp->info_size)
+        return "Corrupt BMP header.";
+
+    bmp->top_down = height < 0;
+    bmp->height = height < 0 ? -height : height;
+    bmp->row_bytes = bmp->width * (bmp->bpp / 8);
+    bmp->row_stride = (bmp->row_bytes + 3) & ~3u;
+    bmp->pixel_bytes = (size_t)bmp->row_bytes * bmp->height;
+    bmp->image_end = bmp->data_offset + (size_t)bmp->row_stride * bmp->height;
+    return NULL;
+}
+
+size_t bmp_pixel_offset(const BmpInfo *bmp, size_t index)
+{
+    return bmp->data_offset + (index / bmp->row_bytes) * bmp->row_stride + index % bmp->row_bytes;
+}
@@ -0,0 +1,47 @@
+#ifndef BMP_H
+#define BMP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * BMP header parser. Pixel bytes are walked in file order, row by
+ * row, starting at bfOffBits and skipping the padding that rounds
+ * each row up to a multiple of 4 bytes. Each row is one contiguous
+ * span, so the LSB kernels can process it in a single call.
+ *
+ * Supported: uncompressed 24-bit BGR and 32-bit BGRA (BI_RGB or
+ * BI_BITFIELDS) with BITMAPINFOHEADER, V4 or V5 info headers,
+ * bottom-up or top-down rows, optional palette/gap before pixels.
+ *
+ * BmpInfo is also the pixel layout every other carrier format reads
+ * its header into (carrier.h).
+ */
+
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_HEADER_SIZE 54      // File header + BITMAPINFOHEADER
+#define BMP_MAX_HEADER 4096     // Largest bfOffBits accepted on streamed input
+
+typedef struct _BmpInfo
+{
+    uint data_offset; // bfOffBits: first pixel byte
+    uint info_size;   // biSize: 40, 108 (V4) or 124 (V5)
+    uint width;       // Pixels per row
+    uint height;      // Rows (absolute value of biHeight)
+    int top_down;     // biHeight was negative
+    uint bpp;         // 24 or 32 bits per pixel
+    uint row_bytes;   // Pixel bytes per row (width * bpp / 8)
+    uint row_stride;  // Row size in the file, padded to 4 bytes
+    size_t pixel_bytes; // row_bytes * height: bytes usable for LSBs
+    size_t image_end;   // data_offset + row_stride * height
+    uint format;        // CARRIER_* the layout was read from
+} BmpInfo;
+
+/* Read the headers in buf into bmp; returns why they are rejected, carrier_short if more bytes are needed, NULL if usable */
+const char *check_bmp_header(const uchar *buf, size_t len, BmpInfo *bmp);
+
+/* File offset of pixel byte index (counted in file order, padding excluded) */
+size_t bmp_pixel_offset(const BmpInfo *bmp, size_t index);
+
+#endif
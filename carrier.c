@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "carrier.h"
+#include "bmp.h"
+#include "png.h"
+#include "pnm.h"
+#include "tga.h"
+#include "types.h"
+
+const char carrier_short[] = "Truncated image header.";
+
+static const CarrierOps carriers[CARRIER_FORMATS] = {
+    [CARRIER_BMP] = {"BMP", check_bmp_header, NULL, NULL},
+    [CARRIER_PNM] = {"PPM/PGM", check_pnm_header, NULL, NULL},
+    [CARRIER_TGA] = {"TGA", check_tga_header, NULL, NULL},
+    [CARRIER_PNG] = {"PNG", check_png_header, load_png, store_png},
+};
+
+static const struct
+{
+    const char *extn;
+    uint format;
+} carrier_extns[] = {
+    {".bmp", CARRIER_BMP}, {".ppm", CARRIER_PNM}, {".pgm", CARRIER_PNM},
+    {".pnm", CARRIER_PNM}, {".tga", CARRIER_TGA}, {".png", CARRIER_PNG},
+};
+
+/* Function Definitions */
+
+const CarrierOps *carrier_ops(uint format)
+{
+    return format < CARRIER_FORMATS ? &carriers[format] : NULL;
+}
+
+const char *check_carrier_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    // The first two bytes pick the format; TGA has no signature and takes whatever is left
+    if (len < 2)
+        return carrier_short;
+
+    uint format = CARRIER_TGA;
+    if (buf[0] == 'B' && buf[1] == 'M')
+        format = CARRIER_BMP;
+    else if (buf[0] == 'P' && (buf[1] == '5' || buf[1] == '6'))
+        format = CARRIER_PNM;
+    else if (buf[0] == 0x89 && buf[1] == 'P')
+        format = CARRIER_PNG;
+
+    memset(layout, 0, sizeof(*layout));
+    layout->format = format;
+    return carriers[format].check(buf, len, layout);
+}
+
+Status parse_carrier_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    const char *error = check_carrier_header(buf, len, layout);
+    if (error != NULL)
+    {
+        printf("ERROR: %s\n", error);
+        return e_failure;
+    }
+    return e_success;
+}
+
+Status probe_carrier_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    return check_carrier_header(buf, len, layout) == NULL ? e_success : e_failure;
+}
+
+Status read_carrier_header(FILE *fptr, uchar *buf, size_t size, BmpInfo *layout)
+{
+    // Headers have no fixed size (PPM/PGM): take a byte at a time until the format can size it
+    size_t len = 0;
+    const char *error = carrier_short;
+    while (error == carrier_short && len < size && fread(buf + len, 1, 1, fptr) == 1)
+        error = check_carrier_header(buf, ++len, layout);
+
+    if (error == carrier_short)
+    {
+        printf("ERROR: %s\n", len < size ? "Unable to read image header." : "Image header too large.");
+        return e_failure;
+    }
+    if (error != NULL)
+    {
+        printf("ERROR: %s\n", error);
+        return e_failure;
+    }
+    if (carrier_encoded(layout))
+    {
+        printf("ERROR: %s images must be read from a regular file.\n", carriers[layout->format].name);
+        return e_failure;
+    }
+
+    // Pull in the rest of the header, palette and gap before the pixels
+    if (layout->data_offset > size)
+    {
+        printf("ERROR: Image header too large.\n");
+        return e_failure;
+    }
+    size_t rest = layout->data_offset - len;
+    if (fread(buf + len, 1, rest, fptr) != rest)
+    {
+        printf("ERROR: Unable to read image header.\n");
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+int carrier_encoded(const BmpInfo *layout)
+{
+    return carriers[layout->format].load != NULL;
+}
+
+Status load_carrier(const uchar *file, size_t len, const BmpInfo *layout, int partial, uchar **pixels, size_t *pixels_len)
+{
+    const char *error = carriers[layout->format].load(file, len, layout, partial, pixels, pixels_len);
+    if (error == NULL)
+        return e_success;
+    if (!partial)
+        printf("ERROR: %s\n", error);
+    return e_failure;
+}
+
+Status store_carrier(const uchar *file, size_t len, const BmpInfo *layout, const uchar *pixels, FILE *fptr)
+{
+    return carriers[layout->format].store(file, len, layout, pixels, fptr);
+}
+
+int carrier_name_format(const char *name)
+{
+    size_t len = strlen(name);
+    for (size_t i = 0; i < sizeof(carrier_extns) / sizeof(carrier_extns[0]); i++)
+    {
+        size_t extn = strlen(carrier_extns[i].extn);
+        if (len > extn && strcasecmp(name + len - extn, carrier_extns[i].extn) == 0)
+            return carrier_extns[i].format;
+    }
+    return -1;
+}
+
+int is_carrier_name(const char *name)
+{
+    return carrier_name_format(name) >= 0;
+}
@@ -0,0 +1,83 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "bmp.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Carrier formats. Every format reads its header into the common pixel
+ * layout (BmpInfo): height rows of row_bytes channel bytes, the first
+ * at data_offset and each row_stride after the last. The rows are the
+ * pixel spans the engines walk, so the LSB kernels are the same for
+ * every format.
+ *
+ *   BMP      uncompressed 24/32-bit (bmp.c)
+ *   PPM/PGM  binary P6/P5, maxval 255 (pnm.c)
+ *   TGA      uncompressed true-colour or greyscale, 8/24/32-bit (tga.c)
+ *   PNG      8-bit greyscale/RGB with optional alpha, not interlaced (png.c)
+ *
+ * Raw formats keep their pixels in the file as is: the layout points
+ * into the file, which is mapped, cloned or streamed like a BMP. An
+ * encoded format (PNG) is loaded into a pixel buffer first (layout
+ * with data_offset 0 and no padding) and stored back from it, keeping
+ * every other chunk of the original file.
+ */
+
+#define CARRIER_BMP 0
+#define CARRIER_PNM 1
+#define CARRIER_TGA 2
+#define CARRIER_PNG 3
+#define CARRIER_FORMATS 4
+
+#define CARRIER_PEEK_BYTES (64 * 1024) // Pixel bytes a partial load decodes (enough for any stego header)
+
+typedef struct _CarrierOps
+{
+    const char *name;
+
+    /* Read the header in buf (len bytes) into layout; returns why it is rejected, carrier_short if more bytes are needed, NULL if usable */
+    const char *(*check)(const uchar *buf, size_t len, BmpInfo *layout);
+
+    /* Encoded formats: decode the pixels of a whole file (partial: at least the first CARRIER_PEEK_BYTES of a file that may be cut short); returns why it fails, NULL on success */
+    const char *(*load)(const uchar *file, size_t len, const BmpInfo *layout, int partial, uchar **pixels, size_t *pixels_len);
+
+    /* Encoded formats: write the file again with the pixels replaced */
+    Status (*store)(const uchar *file, size_t len, const BmpInfo *layout, const uchar *pixels, FILE *fptr);
+} CarrierOps;
+
+/* Returned by check when the header continues past the bytes given */
+extern const char carrier_short[];
+
+/* Operations of a format (CARRIER_*) */
+const CarrierOps *carrier_ops(uint format);
+
+/* Read the header of any supported format in buf (len bytes) into layout; returns why it is rejected, NULL if usable */
+const char *check_carrier_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+/* Parse and validate the header of any supported format in buf (len bytes) */
+Status parse_carrier_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+/* Same checks as parse_carrier_header without printing why a header is rejected */
+Status probe_carrier_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+/* Read every byte up to the first pixel from a stream into buf and parse it (raw formats only) */
+Status read_carrier_header(FILE *fptr, uchar *buf, size_t size, BmpInfo *layout);
+
+/* Pixels are not stored as is in the file (load and store them) */
+int carrier_encoded(const BmpInfo *layout);
+
+/* Decode the pixels of an encoded carrier into a new buffer (free it with free); a partial load prints nothing */
+Status load_carrier(const uchar *file, size_t len, const BmpInfo *layout, int partial, uchar **pixels, size_t *pixels_len);
+
+/* Write an encoded carrier with its pixels replaced */
+Status store_carrier(const uchar *file, size_t len, const BmpInfo *layout, const uchar *pixels, FILE *fptr);
+
+/* Format (CARRIER_*) the extension of name stands for, -1 if none */
+int carrier_name_format(const char *name);
+
+/* Name ends in the extension of a supported format */
+int is_carrier_name(const char *name);
+
+#endif
@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200809L // pread, st_mtim
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "carrier_cache.h"
+#include "bmp.h"
+#include "carrier.h"
+#include "encode.h"
+#include "types.h"
+
+struct _CarrierCache
+{
+    pthread_mutex_t lock; // Guards everything below
+    CarrierEntry *head;   // Most recently used
+    CarrierEntry *tail;   // Next to evict
+    size_t budget;
+    size_t used; // Bytes of carriers on the list
+    CarrierKey ghosts[CARRIER_GHOSTS]; // Missed once, admitted on the next miss
+    int nghosts;
+    int next_ghost; // Ring position to overwrite when full
+    unsigned long hits;
+    unsigned long misses;
+};
+
+/* Function Definitions */
+
+static int same_file(const CarrierKey *a, const CarrierKey *b)
+{
+    return a->dev == b->dev && a->ino == b->ino;
+}
+
+static int same_key(const CarrierKey *a, const CarrierKey *b)
+{
+    return same_file(a, b) && a->size == b->size && a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+static void free_entry(CarrierEntry *entry)
+{
+    free(entry->data);
+    free(entry);
+}
+
+static void unlink_entry(CarrierCache *cache, CarrierEntry *entry)
+{
+    // Callers hold the lock; a referenced entry lives on until its last release
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        cache->head = entry->next;
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        cache->tail = entry->prev;
+
+    cache->used -= entry->len;
+    entry->prev = entry->next = NULL;
+    entry->evicted = 1;
+    if (entry->refs == 0)
+        free_entry(entry);
+}
+
+static void push_front(CarrierCache *cache, CarrierEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = entry;
+    cache->head = entry;
+    if (cache->tail == NULL)
+        cache->tail = entry;
+}
+
+static CarrierEntry *lookup(CarrierCache *cache, const CarrierKey *key)
+{
+    // Callers hold the lock. A few dozen covers at most: a list walk is cheap next to a copy
+    for (CarrierEntry *entry = cache->head; entry != NULL; entry = entry->next)
+    {
+        if (!same_file(&entry->key, key))
+            continue;
+        if (!same_key(&entry->key, key))
+        {
+            unlink_entry(cache, entry); // Carrier rewritten since it was cached
+            return NULL;
+        }
+        if (entry != cache->head)
+        {
+            // Move to the front without dropping the bytes
+            entry->prev->next = entry->next;
+            if (entry->next != NULL)
+                entry->next->prev = entry->prev;
+            else
+                cache->tail = entry->prev;
+            push_front(cache, entry);
+        }
+        entry->refs++;
+        return entry;
+    }
+    return NULL;
+}
+
+static int admit(CarrierCache *cache, const CarrierKey *key, size_t len)
+{
+    // Free room: admit at once. Otherwise first miss: remember the key; second miss: admit the carrier
+    pthread_mutex_lock(&cache->lock);
+    if (cache->used + len <= cache->budget)
+    {
+        pthread_mutex_unlock(&cache->lock);
+        return 1;
+    }
+    for (int i = 0; i < cache->nghosts; i++)
+    {
+        if (same_key(&cache->ghosts[i], key))
+        {
+            cache->ghosts[i] = cache->ghosts[--cache->nghosts];
+            pthread_mutex_unlock(&cache->lock);
+            return 1;
+        }
+    }
+
+    if (cache->nghosts < CARRIER_GHOSTS)
+    {
+        cache->ghosts[cache->nghosts++] = *key;
+    }
+    else
+    {
+        cache->ghosts[cache->next_ghost] = *key;
+        cache->next_ghost = (cache->next_ghost + 1) % CARRIER_GHOSTS;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+static const CarrierEntry *insert(CarrierCache *cache, const CarrierKey *key, uchar *data, size_t len)
+{
+    // Takes ownership of data; only carriers the buffer encoder accepts (raw formats) are kept
+    CarrierEntry *entry = calloc(1, sizeof(CarrierEntry));
+    if (entry == NULL || probe_carrier_header(data, len, &entry->bmp) != e_success || carrier_encoded(&entry->bmp) ||
+        entry->bmp.image_end > len)
+    {
+        free(entry);
+        free(data);
+        return NULL;
+    }
+    entry->key = *key;
+    entry->data = data;
+    entry->len = len;
+    entry->capacity = get_image_size_for_bmp(&entry->bmp);
+    entry->refs = 1;
+
+    pthread_mutex_lock(&cache->lock);
+    CarrierEntry *existing = lookup(cache, key); // Another thread may have added it meanwhile
+    if (existing == NULL)
+    {
+        while (cache->tail != NULL && cache->used + len > cache->budget)
+            unlink_entry(cache, cache->tail);
+        push_front(cache, entry);
+        cache->used += len;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (existing != NULL)
+    {
+        free_entry(entry);
+        return existing;
+    }
+    return entry;
+}
+
+CarrierCache *carrier_cache_create(size_t budget)
+{
+    CarrierCache *cache = calloc(1, sizeof(CarrierCache));
+    if (cache == NULL)
+        return NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->budget = budget;
+    return cache;
+}
+
+void carrier_cache_destroy(CarrierCache *cache)
+{
+    if (cache == NULL)
+        return;
+    while (cache->head != NULL)
+        unlink_entry(cache, cache->head);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void carrier_cache_stats(CarrierCache *cache, StegoStats *stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    stats->cache_hits += cache->hits;
+    stats->cache_misses += cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void carrier_key(const struct stat *st, CarrierKey *key)
+{
+    memset(key, 0, sizeof(CarrierKey));
+    key->dev = st->st_dev;
+    key->ino = st->st_ino;
+    key->size = st->st_size;
+    key->mtime = st->st_mtim;
+}
+
+const CarrierEntry *carrier_cache_find(CarrierCache *cache, const CarrierKey *key)
+{
+    pthread_mutex_lock(&cache->lock);
+    CarrierEntry *entry = lookup(cache, key);
+    if (entry != NULL)
+        cache->hits++;
+    else
+        cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+const CarrierEntry *carrier_cache_add(CarrierCache *cache, const CarrierKey *key, const uchar *data, size_t len)
+{
+    if (len == 0 || len > cache->budget || !admit(cache, key, len))
+        return NULL;
+
+    uchar *copy = malloc(len);
+    if (copy == NULL)
+        return NULL;
+    memcpy(copy, data, len);
+    return insert(cache, key, copy, len);
+}
+
+const CarrierEntry *carrier_cache_load(CarrierCache *cache, int fd)
+{
+    struct stat st;
+    CarrierKey key;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+        return NULL;
+    carrier_key(&st, &key);
+
+    const CarrierEntry *entry = carrier_cache_find(cache, &key);
+    if (entry != NULL || (size_t)st.st_size > cache->budget || !admit(cache, &key, st.st_size))
+        return entry;
+
+    size_t len = st.st_size, done = 0;
+    uchar *data = malloc(len);
+    while (data != NULL && done < len)
+    {
+        ssize_t n = pread(fd, data + done, len - done, done);
+        if (n <= 0)
+        {
+            free(data); // Shrank or unreadable: the caller's own read reports it
+            return NULL;
+        }
+        done += n;
+    }
+    return data != NULL ? insert(cache, &key, data, len) : NULL;
+}
+
+void carrier_cache_release(CarrierCache *cache, const CarrierEntry *entry)
+{
+    CarrierEntry *owned = (CarrierEntry *)entry;
+    pthread_mutex_lock(&cache->lock);
+    if (--owned->refs == 0 && owned->evicted)
+        free_entry(owned);
+    pthread_mutex_unlock(&cache->lock);
+}
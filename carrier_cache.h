@@ -0,0 +1,80 @@
+#ifndef CARRIER_CACHE_H
+#define CARRIER_CACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "bmp.h"
+#include "stats.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Carrier cache: decoded cover images kept in memory between jobs, so
+ * batch and daemon modes that embed into the same few carriers over
+ * and over stop reading and parsing them.
+ *
+ * An entry holds the whole file, its parsed BMP header and capacity.
+ * It is keyed by file identity (device and inode) plus size and
+ * modification time, so a rewritten carrier is a miss and replaces
+ * its stale entry. Entries are kept in LRU order within a byte
+ * budget. While the budget has room a carrier is admitted on its
+ * first miss. Once it is full, a carrier is only admitted the second
+ * time it is missed, so a run of one-off carriers does not evict the
+ * ones that are reused.
+ *
+ * Lookups return a counted reference: the entry stays valid until
+ * carrier_cache_release, even if it is evicted in the meantime. All
+ * calls are thread-safe.
+ */
+
+#define CARRIER_CACHE_MB 256 // Default budget
+#define CARRIER_GHOSTS 256   // Keys remembered for admission
+
+typedef struct _CarrierKey
+{
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} CarrierKey;
+
+typedef struct _CarrierEntry
+{
+    struct _CarrierEntry *prev; // LRU list, most recent first
+    struct _CarrierEntry *next;
+    CarrierKey key;
+    uchar *data;     // Whole carrier file
+    size_t len;      // Bytes in data
+    BmpInfo bmp;     // Parsed header
+    size_t capacity; // Pixel bytes usable for payload bits (get_image_size_for_bmp)
+    int refs;        // Lookups not yet released
+    int evicted;     // Off the list: freed by the last release
+} CarrierEntry;
+
+typedef struct _CarrierCache CarrierCache;
+
+/* Cache holding up to budget bytes of carriers (NULL on failure) */
+CarrierCache *carrier_cache_create(size_t budget);
+
+/* Free every entry (all references must have been released) */
+void carrier_cache_destroy(CarrierCache *cache);
+
+/* Add the hit and miss counts to stats */
+void carrier_cache_stats(CarrierCache *cache, StegoStats *stats);
+
+/* Identity of the file described by st */
+void carrier_key(const struct stat *st, CarrierKey *key);
+
+/* Entry for key, or NULL (a miss) */
+const CarrierEntry *carrier_cache_find(CarrierCache *cache, const CarrierKey *key);
+
+/* Copy len bytes read from the file with key into the cache (NULL: not admitted yet, too large or not a BMP) */
+const CarrierEntry *carrier_cache_add(CarrierCache *cache, const CarrierKey *key, const uchar *data, size_t len);
+
+/* Entry for the regular file open on fd, read into the cache on an admitted miss (NULL: caller reads it itself) */
+const CarrierEntry *carrier_cache_load(CarrierCache *cache, int fd);
+
+/* Drop a reference from find, add or load */
+void carrier_cache_release(CarrierCache *cache, const CarrierEntry *entry);
+
+#endif
@@ -0,0 +1,131 @@
+#include <pthread.h>
+#include <string.h>
+#include "crc32c.h"
+#include "types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define CRC_ARM 1
+#include <arm_acle.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78u // Reflected Castagnoli polynomial
+
+typedef uint (*crc_fn)(uint crc, const uchar *data, size_t len);
+
+static uint crc_table[8][256]; // Slice-by-8 tables, filled by select_kernel
+
+/* Function Definitions */
+
+static uint crc_tables(uint crc, const uchar *data, size_t len)
+{
+    // 8 bytes per step, one table per byte position
+    for (; len >= 8; len -= 8, data += 8)
+    {
+        uint lo = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | ((uint)data[3] << 24));
+        uint hi = data[4] | (data[5] << 8) | (data[6] << 16) | ((uint)data[7] << 24);
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^ crc_table[5][(lo >> 16) & 0xFF] ^
+              crc_table[4][lo >> 24] ^ crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+    }
+
+    while (len--)
+        crc = crc_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC_X86
+
+__attribute__((target("sse4.2"))) static uint crc_sse42(uint crc, const uchar *data, size_t len)
+{
+#ifdef __x86_64__
+    unsigned long long c = crc;
+    for (; len >= 8; len -= 8, data += 8)
+    {
+        unsigned long long quad;
+        memcpy(&quad, data, 8);
+        c = _mm_crc32_u64(c, quad);
+    }
+    crc = (uint)c;
+#endif
+    for (; len >= 4; len -= 4, data += 4)
+    {
+        uint word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    while (len--)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+
+#endif
+
+#ifdef CRC_ARM
+
+static uint crc_armv8(uint crc, const uchar *data, size_t len)
+{
+    for (; len >= 8; len -= 8, data += 8)
+    {
+        unsigned long long quad;
+        memcpy(&quad, data, 8);
+        crc = __crc32cd(crc, quad);
+    }
+    while (len--)
+        crc = __crc32cb(crc, *data++);
+    return crc;
+}
+
+#endif
+
+static crc_fn crc_impl;
+static const char *crc_name;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT; // Workers may race on the first call
+
+static void select_kernel(void)
+{
+    // Tables: entry [k][b] is byte b followed by k zero bytes
+    for (uint b = 0; b < 256; b++)
+    {
+        uint crc = b;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        crc_table[0][b] = crc;
+    }
+    for (uint b = 0; b < 256; b++)
+    {
+        for (int k = 1; k < 8; k++)
+            crc_table[k][b] = crc_table[0][crc_table[k - 1][b] & 0xFF] ^ (crc_table[k - 1][b] >> 8);
+    }
+
+    crc_impl = crc_tables;
+    crc_name = "table";
+
+#if defined(CRC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        crc_impl = crc_sse42;
+        crc_name = "sse4.2";
+    }
+#elif defined(CRC_ARM)
+    crc_impl = crc_armv8;
+    crc_name = "armv8";
+#endif
+}
+
+uint crc32c(uint crc, const uchar *data, size_t len)
+{
+    pthread_once(&crc_once, select_kernel);
+
+    return ~crc_impl(~crc, data, len);
+}
+
+const char *crc32c_kernel_name(void)
+{
+    pthread_once(&crc_once, select_kernel);
+
+    return crc_name;
+}
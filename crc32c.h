@@ -0,0 +1,19 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * CRC32C (Castagnoli), used to check the extended header and the
+ * payload. SSE4.2 or ARMv8 CRC instructions are used when the CPU
+ * has them, slice-by-8 tables otherwise; all give the same value.
+ */
+
+/* Continue crc (0 to start) over len bytes */
+uint crc32c(uint crc, const uchar *data, size_t len);
+
+/* Name of the CRC kernel selected for this CPU */
+const char *crc32c_kernel_name(void);
+
+#endif
@@ -1,7 +1,19 @@
 
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "aead.h"
+#include "carrier.h"
+#include "crc32c.h"
 #include "decode.h"
+#include "lsb.h"
+#include "lz.h"
+#include "mmap_io.h"
+#include "scatter.h"
+#include "stego_header.h"
+#include "stream_io.h"
+#include "stripe.h"
 #include "types.h"
 
 /* Function Definitions */
@@ -15,8 +27,8 @@ Status read_and_validate_decode_args(int argc, char *argv[])
         return e_failure;
     }
 
-    // Check input file type is .bmp
-    if (strstr(argv[2], ".bmp") == NULL)
+    // Check input file type is a supported image ("-" reads the image from stdin)
+    if (!is_carrier_name(argv[2]) && !is_stream_name(argv[2]))
     {
         printf("ERROR: Incorrect input file type.\n");
         return e_failure;
@@ -37,7 +49,7 @@ Status read_and_validate_decode_args(int argc, char *argv[])
 
 Status open_files_dec(DecodeInfo *decInfo)
 {
-    decInfo->fptr_inp_image = fopen(decInfo->inp_image_fname, "r");
+    decInfo->fptr_inp_image = open_input(decInfo->inp_image_fname);
     // Fail if input image cannot be opened
     if (decInfo->fptr_inp_image == NULL)
     {
@@ -46,158 +58,967 @@ Status open_files_dec(DecodeInfo *decInfo)
         return e_failure;
     }
 
-    decInfo->fptr_out = fopen(decInfo->out_fname, "w");
+    decInfo->fptr_out = open_output(decInfo->out_fname);
     // Fail if output file cannot be opened
     if (decInfo->fptr_out == NULL)
     {
         perror("fopen");
         fprintf(stderr, "ERROR: Unable to open file %s\n", decInfo->out_fname);
+        close_stream(decInfo->fptr_inp_image);
         return e_failure;
     }
 
+    // Read LSBs straight from a mapping when the input is a regular file
+    decInfo->inp_map = map_file_read(decInfo->fptr_inp_image, &decInfo->map_size);
+    decInfo->image_pos = 0;
+    decInfo->pixel_pos = 0;
+
+    // Fixed-size job memory: allocated by the first job, reused by the next
+    if (arena_reserve(&decInfo->arena, DECODE_ARENA_BYTES) != e_success || alloc_decode_buffers(decInfo) != e_success)
+    {
+        fprintf(stderr, "ERROR: Unable to allocate decode buffers\n");
+        close_files_dec(decInfo);
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+Status alloc_decode_buffers(DecodeInfo *decInfo)
+{
+    // Memory output (library calls) inflates in place; mapped input needs no window
+    StegoArena *arena = &decInfo->arena;
+    arena_reset(arena);
+    decInfo->chunk = arena_alloc(arena, DECODE_CHUNK);
+    decInfo->lz_packed = arena_alloc(arena, LZ_BLOCK_SIZE);
+    decInfo->lz_data = decInfo->fptr_out != NULL ? arena_alloc(arena, LZ_BLOCK_SIZE) : NULL;
+    decInfo->window = decInfo->inp_map == NULL ? arena_alloc(arena, DECODE_WINDOW) : NULL;
+    decInfo->aead.buf = arena_alloc(arena, AEAD_CHUNK);
+
+    if (decInfo->chunk == NULL || decInfo->lz_packed == NULL || (decInfo->fptr_out != NULL && decInfo->lz_data == NULL) ||
+        (decInfo->inp_map == NULL && decInfo->window == NULL) || decInfo->aead.buf == NULL)
+        return e_failure;
+    return e_success;
+}
+
+void release_stego_pixels(DecodeInfo *decInfo)
+{
+    // Put the image itself back in place of the pixels loaded from it
+    if (decInfo->image_file == NULL)
+        return;
+    free((uchar *)decInfo->inp_map);
+    decInfo->inp_map = decInfo->image_file;
+    decInfo->map_size = decInfo->image_size;
+    decInfo->image_file = NULL;
+}
+
+Status close_files_dec(DecodeInfo *decInfo)
+{
+    release_stego_pixels(decInfo);
+    unmap_file(decInfo->inp_map, decInfo->map_size);
+    decInfo->inp_map = NULL;
+
+    close_stream(decInfo->fptr_inp_image);
+    close_stream(decInfo->fptr_out);
+    return e_success;
+}
+
+Status run_decode(DecodeInfo *decInfo)
+{
+    decInfo->size_usr_migc_str = strlen(decInfo->usr_migc_str);
+
+    STATS_BEGIN(decInfo->stats, STAGE_OPEN);
+    Status status = open_files_dec(decInfo); // Open files for decoding
+    STATS_END(decInfo->stats);
+    if (status == e_failure)
+    {
+        printf("ERROR: %s function failed\n", "open_files");
+        return e_failure;
+    }
+
+    status = do_decoding(decInfo); // Perform decoding
+
+    STATS_BEGIN(decInfo->stats, STAGE_CLOSE);
+    close_files_dec(decInfo);
+    STATS_END(decInfo->stats);
+    return status;
+}
+
+static Status load_stego_pixels(DecodeInfo *decInfo)
+{
+    // Encoded images (PNG) are decoded into a pixel buffer that takes the place of the input mapping
+    uchar *pixels;
+    size_t len;
+    if (load_carrier(decInfo->inp_map, decInfo->map_size, &decInfo->bmp, decInfo->header_only, &pixels, &len) != e_success)
+        return e_failure;
+    decInfo->image_file = decInfo->inp_map;
+    decInfo->image_size = decInfo->map_size;
+    decInfo->inp_map = pixels;
+    decInfo->map_size = len;
+    return e_success;
+}
+
+Status parse_stego_image(DecodeInfo *decInfo)
+{
+    // Parse the image header and skip to the pixels (read past it so piped input works too)
+    if (decInfo->inp_map != NULL)
+    {
+        if (decInfo->quiet)
+        {
+            if (probe_carrier_header(decInfo->inp_map, decInfo->map_size, &decInfo->bmp) != e_success)
+                return e_failure;
+        }
+        else if (parse_carrier_header(decInfo->inp_map, decInfo->map_size, &decInfo->bmp) != e_success)
+        {
+            return e_failure;
+        }
+        if (carrier_encoded(&decInfo->bmp))
+        {
+            if (load_stego_pixels(decInfo) != e_success)
+                return e_failure;
+        }
+        else if (decInfo->bmp.image_end > decInfo->map_size && !decInfo->header_only)
+        {
+            printf("ERROR: Truncated image.\n");
+            return e_failure;
+        }
+    }
+    else
+    {
+        uchar header[BMP_MAX_HEADER];
+        if (read_carrier_header(decInfo->fptr_inp_image, header, sizeof(header), &decInfo->bmp) != e_success)
+            return e_failure;
+        STATS_IO(decInfo->stats, decInfo->bmp.data_offset, 0, 1);
+    }
+    decInfo->image_pos = decInfo->bmp.data_offset;
+    decInfo->pixel_pos = 0;
+    decInfo->depth = 1;
+    decInfo->codec = STEGO_CODEC_NONE;
+    decInfo->checksum = 0;
+    decInfo->scatter = 0;
+    decInfo->wide_sizes = 0;
+    decInfo->sealed = 0;
+    memset(&decInfo->shard, 0, sizeof(decInfo->shard));
+    decInfo->cur_depth = 1;
+    decInfo->bit_phase = 0;
     return e_success;
 }
 
 Status do_decoding(DecodeInfo *decInfo)
 {
-    fseek(decInfo->fptr_inp_image, 54, SEEK_SET); // Skip BMP header
+    Status status = decode_stego_header(decInfo);
+    if (status == e_success && decInfo->shard.count > 0)
+    {
+        // One slice on its own is not the secret
+        printf("ERROR: Image holds shard %u of %u; decode all shards together with --shards.\n", decInfo->shard.index + 1,
+               decInfo->shard.count);
+        status = e_failure;
+    }
+    if (status == e_success)
+    {
+        STATS_BEGIN(decInfo->stats, STAGE_PAYLOAD);
+        status = write_out_file(decInfo); // Decode and write secret data
+        STATS_END(decInfo->stats);
+    }
 
-    // Abort if magic string not found
-    if (magic_string_status(decInfo->usr_migc_str, decInfo) != e_success)
+    if (status != e_success)
     {
-        printf("ERROR: Magic Sting not found.\n");
+        // Drop the partial output of a rejected image
+        if (!is_stream_name(decInfo->out_fname))
+            remove(decInfo->out_fname);
         return e_failure;
     }
 
-    get_size_extn_out_file(decInfo); // Decode extension size
-    get_extn_out_file(decInfo);      // Decode extension
-    get_size_out_file(decInfo);      // Decode secret file size
-    write_out_file(decInfo);         // Decode and write secret data
+    // Output streamed to stdout has no name to fix up
+    if (is_stream_name(decInfo->out_fname))
+        return e_success;
 
     // Rename output file to include extension
-    char new_name[20];
-    strcpy(new_name, decInfo->out_fname);
-    strcat(new_name, decInfo->extn_out_file);
-    rename(decInfo->out_fname, new_name);
+    char *new_name = output_file_name(decInfo->out_fname, decInfo->extn_out_file);
+    if (new_name == NULL || rename(decInfo->out_fname, new_name) != 0)
+    {
+        printf("ERROR: Unable to rename %s to include its extension.\n", decInfo->out_fname);
+        free(new_name);
+        return e_failure;
+    }
 
+    free(new_name);
     return e_success;
 }
 
-Status magic_string_status(const char *magic_string, DecodeInfo *decInfo)
+char *output_file_name(const char *out_fname, const char *extn)
 {
-    char dec_char[decInfo->size_usr_migc_str];
+    // Sized to the name given: paths are not limited to a fixed field
+    size_t size = strlen(out_fname) + strlen(extn) + 1;
+    char *name = malloc(size);
+    if (name != NULL)
+        snprintf(name, size, "%s%s", out_fname, extn);
+    return name;
+}
 
-    // Decode 2 characters from image LSBs
-    for (int i = 0; i < decInfo->size_usr_migc_str; i++)
+Status decode_stego_header(DecodeInfo *decInfo)
+{
+    StegoStats *stats = decInfo->stats;
+    Status status;
+
+    STATS_BEGIN(stats, STAGE_HEADER);
+    status = parse_stego_image(decInfo); // Locate the pixel array
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    // Abort if magic string not found
+    STATS_BEGIN(stats, STAGE_MAGIC);
+    status = magic_string_status(decInfo->usr_migc_str, decInfo);
+    STATS_END(stats);
+    if (status != e_success)
     {
-        char decoded_char = 0;
-        for (int j = 0; j < 8; j++)
-        {
-            char temp_char = fgetc(decInfo->fptr_inp_image);
-            decoded_char = decoded_char << 1;
-            if ((temp_char & 1) == 1)
-            {
-                decoded_char = decoded_char | 1;
-            }
-        }
-        dec_char[i] = decoded_char;
+        if (!decInfo->quiet)
+            printf("ERROR: Magic Sting not found.\n");
+        return e_failure;
     }
 
+    STATS_BEGIN(stats, STAGE_FIELDS);
+    if (get_size_extn_out_file(decInfo) != e_success || // Decode extension size
+        get_extn_out_file(decInfo) != e_success ||      // Decode extension
+        get_size_out_file(decInfo) != e_success)        // Decode secret file size
+        status = e_failure;
+    STATS_END(stats);
+    return status;
+}
+
+Status decode_secret(DecodeInfo *decInfo)
+{
+    if (decode_stego_header(decInfo) != e_success)
+        return e_failure;
+
+    STATS_BEGIN(decInfo->stats, STAGE_PAYLOAD);
+    Status status = write_out_file(decInfo); // Decode and write secret data
+    STATS_END(decInfo->stats);
+    return status;
+}
+
+Status magic_string_status(const char *magic_string, DecodeInfo *decInfo)
+{
+    uchar dec_char[sizeof(decInfo->usr_migc_str)];
+    if (decInfo->size_usr_migc_str > sizeof(dec_char))
+        return e_failure;
+
+    // Decode magic string characters from image LSBs
+    if (decode_data(decInfo, dec_char, decInfo->size_usr_migc_str) != e_success)
+        return e_failure;
+
     // Compare decoded string with expected magic string
-    if (strcmp(dec_char, magic_string) == 0)
+    if (memcmp(dec_char, magic_string, decInfo->size_usr_migc_str) == 0)
         return e_success;
     else
         return e_failure;
 }
 
-Status get_size_extn_out_file(DecodeInfo *decInfo)
+static Status get_stego_header(DecodeInfo *decInfo)
 {
-    int decoded_int = 0;
+    // Extended header follows the marker: read the settings it records
+    uchar buf[STEGO_HEADER_BYTES];
+    StegoHeader hdr;
+    if (decode_data(decInfo, buf, sizeof(buf)) != e_success || unpack_stego_header(buf, &hdr) != e_success)
+    {
+        if (!decInfo->quiet)
+            printf("ERROR: Unsupported stego header.\n");
+        return e_failure;
+    }
 
+    decInfo->depth = hdr.depth;
+    decInfo->codec = hdr.codec;
+    decInfo->scatter = (hdr.flags & STEGO_FLAG_SCATTER) != 0;
+    decInfo->wide_sizes = (hdr.flags & STEGO_FLAG_SIZE64) != 0;
+    decInfo->sealed = (hdr.flags & STEGO_FLAG_AEAD) != 0;
+
+    // Version 2: every header byte from the marker on is covered by the header crc
+    if (hdr.version == STEGO_VERSION)
+    {
+        uchar marker[4] = {STEGO_HEADER_MARKER >> 24, (STEGO_HEADER_MARKER >> 16) & 0xFF, (STEGO_HEADER_MARKER >> 8) & 0xFF, STEGO_HEADER_MARKER & 0xFF};
+        decInfo->checksum = 1;
+        decInfo->crc = crc32c(crc32c(0, marker, sizeof(marker)), buf, sizeof(buf));
+    }
+
+    // The shard record follows the flags (and counts towards the header crc)
+    if (hdr.flags & STEGO_FLAG_SHARD)
+    {
+        uchar shard[STEGO_SHARD_BYTES];
+        if (decode_data(decInfo, shard, sizeof(shard)) != e_success || unpack_stego_shard(shard, &decInfo->shard) != e_success)
+            return e_failure;
+    }
+    return e_success;
+}
+
+Status get_size_extn_out_file(DecodeInfo *decInfo)
+{
     // Decode 32 bits for extension size
-    for (int j = 0; j < 32; j++)
+    if (decode_32(decInfo, &decInfo->size_extn_out_file) != e_success)
+        return e_failure;
+
+    // An extended header marker stands in front of the real extension size
+    if ((uint)decInfo->size_extn_out_file == STEGO_HEADER_MARKER)
     {
-        int temp_int = fgetc(decInfo->fptr_inp_image);
-        decoded_int = decoded_int << 1;
-        if ((temp_int & 1) == 1)
-        {
-            decoded_int = decoded_int | 1;
-        }
+        if (get_stego_header(decInfo) != e_success || decode_32(decInfo, &decInfo->size_extn_out_file) != e_success)
+            return e_failure;
     }
 
-    decInfo->size_extn_out_file = (long)decoded_int;
     return e_success;
 }
 
 Status get_extn_out_file(DecodeInfo *decInfo)
 {
     int size = decInfo->size_extn_out_file;
-    char dec_char[size + 1];
 
-    // Decode extension characters from image
-    for (int i = 0; i < size; i++)
+    // Reject sizes no encoder writes before reading that many bytes
+    if (size < 0 || size >= MAX_FILE_SUFFIX)
+    {
+        if (!decInfo->quiet)
+            printf("ERROR: Invalid extension size in stego image.\n");
+        return e_failure;
+    }
+
+    // Decode extension characters from image (the size check above keeps room for the terminator)
+    if (decode_data(decInfo, (uchar *)decInfo->extn_out_file, size) != e_success)
+        return e_failure;
+
+    decInfo->extn_out_file[size] = '\0';
+    return e_success;
+}
+
+Status get_size_out_file(DecodeInfo *decInfo)
+{
+    // Decode 32 bits (64 with STEGO_FLAG_SIZE64) for secret file size
+    Status (*decode_size)(DecodeInfo *, long *) = decInfo->wide_sizes ? decode_64 : decode_32;
+    if (decode_size(decInfo, &decInfo->size_out_file) != e_success)
+        return e_failure;
+
+    // Packed secrets also record their unpacked size
+    decInfo->size_raw_out_file = decInfo->size_out_file;
+    if (decInfo->codec != STEGO_CODEC_NONE && decode_size(decInfo, &decInfo->size_raw_out_file) != e_success)
+        return e_failure;
+
+    if (get_header_crc(decInfo) != e_success)
+        return e_failure;
+
+    // The payload (and its crc) must fit in the pixels left
+    long size = decInfo->size_out_file;
+    if (size != FRAMED_OUT_SIZE)
     {
-        char decoded_char = 0;
-        for (int j = 0; j < 8; j++)
+        // Compare in bytes: 8 * size wraps for 64-bit sizes
+        size_t crc_bits = decInfo->checksum ? 32 : 0;
+        size_t room = decInfo->bmp.pixel_bytes - decInfo->pixel_pos;
+        if (decInfo->scatter)
+            room = scatter_blocks(&decInfo->bmp, decInfo->pixel_pos) * SCATTER_BLOCK;
+        size_t room_bits = room * decInfo->depth;
+        if (size < 0 || decInfo->size_raw_out_file < 0 || room_bits < crc_bits || (size_t)size > (room_bits - crc_bits) / 8)
         {
-            char temp_char = fgetc(decInfo->fptr_inp_image);
-            decoded_char = decoded_char << 1;
-            if ((temp_char & 1) == 1)
-            {
-                decoded_char = decoded_char | 1;
-            }
+            if (!decInfo->quiet)
+                printf("ERROR: Secret size exceeds image capacity.\n");
+            return e_failure;
         }
-        dec_char[i] = decoded_char;
     }
 
-    dec_char[size] = '\0';
-    strcpy(decInfo->extn_out_file, dec_char);
+    // A sealed size counts the nonce prefix, length words and tags: from here on sizes are plaintext
+    if (decInfo->sealed && size != FRAMED_OUT_SIZE)
+    {
+        size_t plain = aead_plain_size(size);
+        if (plain == (size_t)-1)
+        {
+            if (!decInfo->quiet)
+                printf("ERROR: Invalid sealed payload size in stego image.\n");
+            return e_failure;
+        }
+        decInfo->size_out_file = plain;
+        if (decInfo->codec == STEGO_CODEC_NONE)
+            decInfo->size_raw_out_file = plain;
+    }
+
+    // Callers size their output buffers from the unpacked size: it must be one the packed bytes can hold
+    if (decInfo->codec != STEGO_CODEC_NONE && size != FRAMED_OUT_SIZE &&
+        (size_t)decInfo->size_raw_out_file > LZ_UNPACK_BOUND((size_t)decInfo->size_out_file))
+    {
+        if (!decInfo->quiet)
+            printf("ERROR: Invalid unpacked size in stego image.\n");
+        return e_failure;
+    }
+
     return e_success;
 }
 
-Status get_size_out_file(DecodeInfo *decInfo)
+Status get_header_crc(DecodeInfo *decInfo)
+{
+    // Only version 2 headers carry checksums
+    if (!decInfo->checksum)
+        return e_success;
+
+    uint expected = decInfo->crc;
+    long stored;
+    if (decode_32(decInfo, &stored) != e_success || (uint)stored != expected)
+    {
+        if (!decInfo->quiet)
+            printf("ERROR: Stego header checksum mismatch.\n");
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+static Status write_out(DecodeInfo *decInfo, const uchar *data, size_t len)
+{
+    // Library calls collect the secret in the caller's buffer
+    if (decInfo->fptr_out == NULL)
+    {
+        if (len > decInfo->out_cap - decInfo->out_len)
+            return e_failure;
+        memcpy(decInfo->out_mem + decInfo->out_len, data, len);
+        decInfo->out_len += len;
+        STATS_IO(decInfo->stats, 0, len, 0);
+        return e_success;
+    }
+
+    if (fwrite(data, 1, len, decInfo->fptr_out) != len)
+        return e_failure;
+    STATS_IO(decInfo->stats, 0, len, 1);
+    return e_success;
+}
+
+static Status open_chunk(DecodeInfo *decInfo)
+{
+    // Extract the next chunk (length word, ciphertext, tag); its bytes are handed out only once the tag checks out
+    uchar word[4], tag[AEAD_TAG_BYTES];
+    size_t len;
+    int final;
+    if (decode_data(decInfo, word, 4) != e_success)
+        return e_failure;
+    if (aead_chunk_size(word, &len, &final) == e_success)
+    {
+        decInfo->aead.len = len;
+        if (decode_data(decInfo, decInfo->aead.buf, len) != e_success || decode_data(decInfo, tag, AEAD_TAG_BYTES) != e_success)
+            return e_failure;
+        if (aead_open_chunk(&decInfo->aead, word, tag) == e_success)
+            return e_success;
+    }
+
+    printf("ERROR: Payload authentication failed.\n");
+    return e_failure;
+}
+
+static Status extract_payload(DecodeInfo *decInfo, uchar *data, size_t len)
+{
+    // Payload bytes come straight from the LSBs, or out of the last chunk opened
+    if (!decInfo->sealed)
+        return decode_data(decInfo, data, len);
+
+    AeadStream *aead = &decInfo->aead;
+    while (len > 0)
+    {
+        if (aead->pos == aead->len && (aead->final || open_chunk(decInfo) != e_success))
+            return e_failure;
+        size_t take = aead->len - aead->pos < len ? aead->len - aead->pos : len;
+        memcpy(data, aead->buf + aead->pos, take);
+        aead->pos += take;
+        data += take;
+        len -= take;
+    }
+    return e_success;
+}
+
+static Status extract_payload_32(DecodeInfo *decInfo, long *value)
+{
+    // Frame length, read like decode_32
+    uchar bytes[4];
+    if (!decInfo->sealed)
+        return decode_32(decInfo, value);
+    if (extract_payload(decInfo, bytes, 4) != e_success)
+        return e_failure;
+    *value = (int)(((uint)bytes[0] << 24) | ((uint)bytes[1] << 16) | ((uint)bytes[2] << 8) | bytes[3]);
+    return e_success;
+}
+
+static Status write_out_file_striped(DecodeInfo *decInfo)
+{
+    // Extract straight into the output mapping (or buffer), one stripe per thread
+    size_t size = decInfo->size_out_file;
+    uint depth = decInfo->cur_depth;
+    size_t carriers = size / depth * 8 + (size % depth * 8 + depth - 1) / depth;
+    if (decInfo->bmp.row_bytes != decInfo->bmp.row_stride || decInfo->bit_phase != 0 || decInfo->pixel_pos + carriers > decInfo->bmp.pixel_bytes)
+        return e_failure; // Stripes need one contiguous run of pixel bytes
+
+    uchar *out;
+    if (decInfo->fptr_out != NULL)
+        out = map_file_write(decInfo->fptr_out, size);
+    else
+        out = size <= decInfo->out_cap - decInfo->out_len ? decInfo->out_mem + decInfo->out_len : NULL;
+    if (out == NULL)
+        return e_failure;
+
+    stripe_extract(out, decInfo->inp_map + decInfo->image_pos, size, decInfo->cur_depth, decInfo->threads);
+    if (decInfo->checksum)
+        decInfo->crc = crc32c(decInfo->crc, out, size);
+    STATS_IO(decInfo->stats, carriers, size, 0);
+    decInfo->image_pos += carriers;
+    decInfo->pixel_pos += carriers;
+
+    // Bits left in a part-read last carrier byte belong to the crc
+    uint used = (size % depth * 8) % depth;
+    if (used != 0)
+    {
+        decInfo->pending = decInfo->inp_map[decInfo->image_pos - 1];
+        decInfo->bit_phase = used;
+    }
+    if (decInfo->fptr_out != NULL)
+        unmap_file(out, size);
+    else
+        decInfo->out_len += size;
+    return e_success;
+}
+
+static Status write_out_frames(DecodeInfo *decInfo)
+{
+    // Framed payload: decode frames until the zero-length terminator
+    uchar *data = decInfo->chunk;
+    long frame_len;
+    do
+    {
+        if (extract_payload_32(decInfo, &frame_len) != e_success || frame_len < 0)
+            return e_failure;
+
+        for (long remaining = frame_len; remaining > 0;)
+        {
+            uint len = remaining < DECODE_CHUNK ? remaining : DECODE_CHUNK;
+            if (extract_payload(decInfo, data, len) != e_success || write_out(decInfo, data, len) != e_success)
+                return e_failure;
+            remaining -= len;
+        }
+    } while (frame_len > 0);
+
+    return e_success;
+}
+
+static Status write_out_block(DecodeInfo *decInfo, long avail, long *used, long *written)
 {
-    int decoded_int = 0;
+    // Read one packed block (header and body) and write it out inflated
+    uchar header[LZ_BLOCK_HEADER];
+    size_t raw_len, packed_len;
 
-    // Decode 32 bits for secret file size
-    for (int j = 0; j < 32; j++)
+    if (avail < LZ_BLOCK_HEADER || extract_payload(decInfo, header, LZ_BLOCK_HEADER) != e_success ||
+        lz_block_sizes(header, &raw_len, &packed_len) != e_success || (long)packed_len > avail - LZ_BLOCK_HEADER)
+        return e_failure;
+
+    if (extract_payload(decInfo, decInfo->lz_packed, packed_len) != e_success)
+        return e_failure;
+
+    // Memory output: inflate straight into the caller's buffer
+    if (decInfo->lz_data == NULL)
     {
-        int temp_int = fgetc(decInfo->fptr_inp_image);
-        decoded_int = decoded_int << 1;
-        if ((temp_int & 1) == 1)
+        if (raw_len > decInfo->out_cap - decInfo->out_len ||
+            lz_unpack_block(decInfo->lz_packed, packed_len, decInfo->out_mem + decInfo->out_len, raw_len) != e_success)
+            return e_failure;
+        decInfo->out_len += raw_len;
+        STATS_IO(decInfo->stats, 0, raw_len, 0);
+    }
+    else if (lz_unpack_block(decInfo->lz_packed, packed_len, decInfo->lz_data, raw_len) != e_success ||
+             write_out(decInfo, decInfo->lz_data, raw_len) != e_success)
+    {
+        return e_failure;
+    }
+
+    *used = LZ_BLOCK_HEADER + packed_len;
+    *written += raw_len;
+    return e_success;
+}
+
+static Status write_out_packed(DecodeInfo *decInfo)
+{
+    // Inflate block by block while streaming out
+    long written = 0;
+    long used;
+
+    if (decInfo->size_out_file == FRAMED_OUT_SIZE)
+    {
+        // One block per frame, up to the zero-length terminator
+        long frame_len = -1;
+        while (extract_payload_32(decInfo, &frame_len) == e_success && frame_len > 0)
         {
-            decoded_int = decoded_int | 1;
+            if (write_out_block(decInfo, frame_len, &used, &written) != e_success || used != frame_len)
+                return e_failure;
         }
+        return frame_len == 0 ? e_success : e_failure;
     }
 
-    decInfo->size_out_file = (long)decoded_int;
+    for (long remaining = decInfo->size_out_file; remaining > 0; remaining -= used)
+    {
+        if (write_out_block(decInfo, remaining, &used, &written) != e_success)
+            return e_failure;
+    }
+
+    return written == decInfo->size_raw_out_file ? e_success : e_failure;
+}
+
+static Status write_out_payload(DecodeInfo *decInfo)
+{
+    if (decInfo->codec != STEGO_CODEC_NONE)
+    {
+        if (write_out_packed(decInfo) != e_success)
+        {
+            if (!decInfo->quiet)
+                printf("ERROR: %s function failed\n", "write_out_file");
+            return e_failure;
+        }
+        return e_success;
+    }
+
+    if (decInfo->size_out_file == FRAMED_OUT_SIZE)
+    {
+        if (write_out_frames(decInfo) != e_success)
+        {
+            if (!decInfo->quiet)
+                printf("ERROR: %s function failed\n", "write_out_file");
+            return e_failure;
+        }
+        return e_success;
+    }
+
+    // Large payloads from mapped images are split across threads
+    if (decInfo->inp_map != NULL && !decInfo->scattering && !decInfo->sealed && decInfo->threads > 1 &&
+        decInfo->size_out_file >= STRIPE_MIN_BYTES &&
+        write_out_file_striped(decInfo) == e_success)
+    {
+        return e_success;
+    }
+
+    // Library calls: decode straight into the caller's buffer, at most 1 GB per call
+    if (decInfo->fptr_out == NULL)
+    {
+        size_t size = decInfo->size_out_file;
+        if (size > decInfo->out_cap - decInfo->out_len)
+        {
+            if (!decInfo->quiet)
+                printf("ERROR: %s function failed\n", "write_out_file");
+            return e_failure;
+        }
+        for (size_t done = 0; done < size;)
+        {
+            size_t len = size - done < (1u << 30) ? size - done : (1u << 30);
+            if (extract_payload(decInfo, decInfo->out_mem + decInfo->out_len, len) != e_success)
+            {
+                if (!decInfo->quiet)
+                    printf("ERROR: %s function failed\n", "write_out_file");
+                return e_failure;
+            }
+            decInfo->out_len += len;
+            done += len;
+        }
+        return e_success;
+    }
+
+    // Decode secret file into a block buffer and write each block at once
+    uchar *data = decInfo->chunk;
+    long remaining = decInfo->size_out_file;
+    while (remaining > 0)
+    {
+        uint len = remaining < DECODE_CHUNK ? remaining : DECODE_CHUNK;
+        if (extract_payload(decInfo, data, len) != e_success || write_out(decInfo, data, len) != e_success)
+        {
+            printf("ERROR: %s function failed\n", "write_out_file");
+            return e_failure;
+        }
+        remaining -= len;
+    }
     return e_success;
 }
 
+static Status begin_scatter(DecodeInfo *decInfo)
+{
+    // Slots are read out of order: the whole pixel array must be mapped
+    if (decInfo->inp_map == NULL || decInfo->bmp.image_end > decInfo->map_size || decInfo->bit_phase != 0)
+    {
+        printf("ERROR: Scattered payload needs a regular image file.\n");
+        return e_failure;
+    }
+
+    scatter_init(&decInfo->scatter_map, &decInfo->bmp, decInfo->pixel_pos,
+                 decInfo->key != NULL ? decInfo->key : decInfo->usr_migc_str);
+    if (decInfo->scatter_map.nblocks == 0)
+        return e_failure;
+
+    // From here on positions count bytes of the scattered stream
+    scatter_view(&decInfo->scatter_map, &decInfo->bmp);
+    decInfo->image_pos = 0;
+    decInfo->pixel_pos = 0;
+    decInfo->scattering = 1;
+    return e_success;
+}
+
+static void end_scatter(DecodeInfo *decInfo)
+{
+    decInfo->bmp = decInfo->scatter_map.bmp;
+    decInfo->image_pos = decInfo->bmp.image_end;
+    decInfo->pixel_pos = decInfo->bmp.pixel_bytes;
+    decInfo->scattering = 0;
+}
+
+static size_t image_offset(const DecodeInfo *decInfo)
+{
+    // File offset of the image byte at image_pos
+    if (decInfo->scattering)
+        return scatter_offset(&decInfo->scatter_map, decInfo->image_pos);
+    return decInfo->image_pos;
+}
+
 Status write_out_file(DecodeInfo *decInfo)
 {
-    // Decode and write each character of secret file
-    for (int i = 0; i < decInfo->size_out_file; i++)
+    // Payload (and its crc) is stored at the header's depth; the rest of its last carrier byte is unused
+    decInfo->cur_depth = decInfo->depth;
+    decInfo->crc = 0;
+    if (decInfo->scatter && begin_scatter(decInfo) != e_success)
+        return e_failure;
+
+    Status status = e_success;
+    if (decInfo->sealed)
+    {
+        // Sealed payload: the nonce prefix, then the chunks
+        uchar prefix[AEAD_PREFIX_BYTES];
+        if (decInfo->aead_key == NULL)
+        {
+            printf("ERROR: Payload is encrypted; pass its key file with --encrypt.\n");
+            status = e_failure;
+        }
+        else if ((status = decode_data(decInfo, prefix, sizeof(prefix))) == e_success)
+            aead_stream_init(&decInfo->aead, decInfo->aead_key, prefix, decInfo->aead.buf);
+    }
+
+    if (status == e_success)
+        status = write_out_payload(decInfo);
+    if (decInfo->sealed && decInfo->aead_key != NULL)
     {
-        decode_8(decInfo);
+        // The secret must end exactly with the last chunk: an empty one is still to be read
+        if (status == e_success && decInfo->aead.pos == decInfo->aead.len && !decInfo->aead.final)
+            status = open_chunk(decInfo);
+        if (status == e_success && (!decInfo->aead.final || decInfo->aead.pos != decInfo->aead.len))
+        {
+            printf("ERROR: Payload authentication failed.\n");
+            status = e_failure;
+        }
+        aead_stream_wipe(&decInfo->aead);
+    }
+    if (status == e_success && decInfo->checksum)
+    {
+        uint expected = decInfo->crc;
+        long stored;
+        if (decode_32(decInfo, &stored) != e_success || (uint)stored != expected)
+        {
+            printf("ERROR: Payload checksum mismatch.\n");
+            status = e_failure;
+        }
     }
+    if (decInfo->scattering)
+        end_scatter(decInfo);
+    decInfo->cur_depth = 1;
+    decInfo->bit_phase = 0;
+    return status;
+}
+
+static Status skip_image(DecodeInfo *decInfo, size_t len)
+{
+    // Step over len image bytes (row padding)
+    if (decInfo->inp_map == NULL)
+    {
+        uchar block[64];
+        for (size_t n; len > 0; len -= n)
+        {
+            n = len < sizeof(block) ? len : sizeof(block);
+            if (fread(block, 1, n, decInfo->fptr_inp_image) != n)
+                return e_failure;
+            STATS_IO(decInfo->stats, n, 0, 1);
+        }
+        return e_success;
+    }
+
+    decInfo->image_pos += len;
     return e_success;
 }
 
-Status decode_8(DecodeInfo *decInfo)
+static void extract_scattered(DecodeInfo *decInfo, uchar *data, size_t first_bit, size_t ncarrier)
 {
-    char decoded_char = 0;
+    // Look up a batch of slots at a time; each block is one contiguous kernel call
+    uint depth = decInfo->cur_depth;
+    size_t offsets[SCATTER_BATCH];
+    STATS_IO(decInfo->stats, ncarrier, 0, 0);
 
-    // Decode 8 bits to get one character
-    for (int i = 0; i < 8; i++)
+    while (ncarrier > 0)
     {
-        char temp_char = fgetc(decInfo->fptr_inp_image);
-        decoded_char = decoded_char << 1;
-        if ((temp_char & 1) == 1)
+        size_t skip = decInfo->image_pos % SCATTER_BLOCK;
+        size_t nblocks = (skip + ncarrier + SCATTER_BLOCK - 1) / SCATTER_BLOCK;
+        if (nblocks > SCATTER_BATCH)
+            nblocks = SCATTER_BATCH;
+        scatter_offsets(&decInfo->scatter_map, decInfo->image_pos / SCATTER_BLOCK, nblocks, offsets);
+
+        // Start every miss of the batch before the first block is read
+        for (size_t i = 0; i < nblocks; i++)
+            __builtin_prefetch(decInfo->inp_map + offsets[i], 0);
+
+        for (size_t i = 0; i < nblocks && ncarrier > 0; i++)
         {
-            decoded_char = decoded_char | 1;
+            size_t n = SCATTER_BLOCK - skip < ncarrier ? SCATTER_BLOCK - skip : ncarrier;
+            lsb_extract_k(data, decInfo->inp_map + offsets[i] + skip, first_bit, n * depth, depth);
+            first_bit += n * depth;
+            ncarrier -= n;
+            decInfo->image_pos += n;
+            skip = 0;
         }
     }
+}
+
+static Status extract_span(DecodeInfo *decInfo, uchar *data, size_t first_bit, size_t ncarrier)
+{
+    // Extract payload bits from ncarrier contiguous pixel bytes of one row
+    uint depth = decInfo->cur_depth;
+    if (decInfo->scattering)
+    {
+        extract_scattered(decInfo, data, first_bit, ncarrier);
+        return e_success;
+    }
+    if (decInfo->inp_map != NULL)
+    {
+        if (decInfo->image_pos > decInfo->map_size || ncarrier > decInfo->map_size - decInfo->image_pos)
+            return e_failure; // Past the end of a partial image
+        lsb_extract_k(data, decInfo->inp_map + decInfo->image_pos, first_bit, ncarrier * depth, depth);
+        STATS_IO(decInfo->stats, ncarrier, 0, 0);
+        decInfo->image_pos += ncarrier;
+        return e_success;
+    }
+
+    uchar *carrier = decInfo->window;
+    while (ncarrier > 0)
+    {
+        size_t n = ncarrier < DECODE_WINDOW ? ncarrier : DECODE_WINDOW;
+        if (fread(carrier, 1, n, decInfo->fptr_inp_image) != n)
+            return e_failure;
+
+        lsb_extract_k(data, carrier, first_bit, n * depth, depth);
+        STATS_IO(decInfo->stats, n, 0, 1);
+
+        decInfo->image_pos += n;
+        first_bit += n * depth;
+        ncarrier -= n;
+    }
+    return e_success;
+}
+
+static Status end_of_row(DecodeInfo *decInfo)
+{
+    // Skip row padding once the last pixel byte of a row is done
+    const BmpInfo *bmp = &decInfo->bmp;
+    if (decInfo->pixel_pos % bmp->row_bytes != 0)
+        return e_success;
+    return skip_image(decInfo, bmp->row_stride - bmp->row_bytes);
+}
+
+static void drain_pending(DecodeInfo *decInfo, uchar *data, size_t *bit, size_t nbits)
+{
+    // Take payload bits from the unread LSBs of the pending carrier byte, highest first
+    uint depth = decInfo->cur_depth;
+    for (; *bit < nbits && decInfo->bit_phase < depth; (*bit)++, decInfo->bit_phase++)
+    {
+        uint value = (decInfo->pending >> (depth - 1 - decInfo->bit_phase)) & 1;
+        uchar mask = 0x80 >> (*bit % 8);
+        data[*bit / 8] = value ? (data[*bit / 8] | mask) : (data[*bit / 8] & ~mask);
+    }
+    if (decInfo->bit_phase == depth)
+        decInfo->bit_phase = 0;
+}
+
+Status decode_data(DecodeInfo *decInfo, uchar *data, uint len)
+{
+    const BmpInfo *bmp = &decInfo->bmp;
+    uint depth = decInfo->cur_depth;
+    size_t nbits = 8 * (size_t)len;
+    size_t bit = 0;
+
+    // Finish the carrier byte left part-read by the previous call
+    if (decInfo->bit_phase > 0)
+        drain_pending(decInfo, data, &bit, nbits);
+
+    size_t whole = (nbits - bit) / depth;
+    size_t partial = ((nbits - bit) % depth) ? 1 : 0;
+    if (decInfo->pixel_pos + whole + partial > bmp->pixel_bytes)
+        return e_failure; // Out of pixel bytes
+
+    // Walk the rows: each row is one span, padding is skipped
+    while (whole > 0)
+    {
+        size_t span = bmp->row_bytes - decInfo->pixel_pos % bmp->row_bytes;
+        if (span > whole)
+            span = whole;
+
+        if (extract_span(decInfo, data, bit, span) != e_success)
+            return e_failure;
+        bit += span * depth;
+        whole -= span;
+        decInfo->pixel_pos += span;
+
+        if (end_of_row(decInfo) != e_success)
+            return e_failure;
+    }
+
+    // Leftover bits come from a new carrier byte, kept for the next call
+    if (partial)
+    {
+        if (decInfo->inp_map != NULL && decInfo->image_pos < decInfo->map_size)
+            decInfo->pending = decInfo->inp_map[image_offset(decInfo)];
+        else if (decInfo->inp_map != NULL || fread(&decInfo->pending, 1, 1, decInfo->fptr_inp_image) != 1)
+            return e_failure;
+        STATS_IO(decInfo->stats, 1, 0, decInfo->inp_map == NULL);
+        decInfo->image_pos++;
+        decInfo->pixel_pos++;
+        if (end_of_row(decInfo) != e_success)
+            return e_failure;
+        drain_pending(decInfo, data, &bit, nbits);
+    }
+
+    if (decInfo->checksum)
+        decInfo->crc = crc32c(decInfo->crc, data, len);
+    return e_success;
+}
+
+Status decode_32(DecodeInfo *decInfo, long *value)
+{
+    // Decode 32 bits (MSB first) as a signed integer
+    uchar bytes[4];
+    if (decode_data(decInfo, bytes, 4) != e_success)
+        return e_failure;
+
+    *value = (int)(((uint)bytes[0] << 24) | ((uint)bytes[1] << 16) | ((uint)bytes[2] << 8) | bytes[3]);
+    return e_success;
+}
+
+Status decode_64(DecodeInfo *decInfo, long *value)
+{
+    // Decode 64 bits (MSB first); sizes past LONG_MAX are not written by any encoder
+    uchar bytes[8];
+    if (decode_data(decInfo, bytes, 8) != e_success)
+        return e_failure;
+
+    unsigned long long v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | bytes[i];
+    if (v > LONG_MAX)
+        return e_failure;
+    *value = (long)v;
+    return e_success;
+}
+
+Status decode_8(DecodeInfo *decInfo)
+{
+    uchar decoded_char;
+
+    // Decode 8 bits to get one character
+    if (decode_data(decInfo, &decoded_char, 1) != e_success)
+        return e_failure;
 
     fputc(decoded_char, decInfo->fptr_out); // Write decoded character to output
+    return e_success;
 }
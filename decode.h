@@ -2,6 +2,15 @@
 #ifndef DECODE_H
 #define DECODE_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include "aead.h"
+#include "arena.h"
+#include "bmp.h"
+#include "lz.h"
+#include "scatter.h"
+#include "stats.h"
+#include "stego_header.h"
 #include "types.h" // Contains user defined types
 
 /*
@@ -11,23 +20,92 @@
  * also stored
  */
 
-#define MAX_FILE_SUFFIX 4
+#define MAX_FILE_SUFFIX 8
+#define DECODE_CHUNK 4096 // Payload bytes extracted per block
+#define FRAMED_OUT_SIZE (-1L) // Size field of a framed payload (see FRAMED_SIZE)
+#define DECODE_WINDOW (8 * DECODE_CHUNK) // Image bytes read per step on stdio
+
+/* Arena of a decode job: payload chunk, packed and inflated block, stdio window, opened chunk */
+#define DECODE_ARENA_BYTES (ARENA_BYTES(DECODE_CHUNK) + 2 * ARENA_BYTES(LZ_BLOCK_SIZE) + ARENA_BYTES(DECODE_WINDOW) + \
+                            ARENA_BYTES(AEAD_CHUNK))
+#define DECODE_LIB_ARENA_BYTES (ARENA_BYTES(DECODE_CHUNK) + ARENA_BYTES(LZ_BLOCK_SIZE) + ARENA_BYTES(AEAD_CHUNK)) // Mapped input, memory output
 
 typedef struct _DecodeInfo
 {
     /* Input Image info */
-    char inp_image_fname[20]; // Input stego image filename
+    const char *inp_image_fname; // Input stego image filename (caller's string)
     FILE *fptr_inp_image;     // File pointer for input stego image
     char usr_migc_str[10];    // Input magic string
     uint size_usr_migc_str;   // Length of input magic string
 
     /* Output File Info */
-    char out_fname[20];                  // Output filename for decoded secret
+    const char *out_fname;               // Output filename for decoded secret (caller's string, no extension)
     FILE *fptr_out;                      // File pointer for output file
     long size_extn_out_file;             // Size of secret file extension
     char extn_out_file[MAX_FILE_SUFFIX]; // Secret file extension
     long size_out_file;                  // Size of decoded secret file
 
+    /* Output buffer used instead of fptr_out when that is NULL (library calls) */
+    uchar *out_mem;
+    size_t out_cap; // Size of out_mem
+    size_t out_len; // Bytes written to out_mem so far
+
+    /* Memory mapped input image (NULL when using stdio) */
+    const uchar *inp_map; // Read-only mapping of input stego image
+    size_t map_size; // Size of the mapping
+
+    /* Encoded image (PNG): inp_map holds the pixels loaded from it */
+    const uchar *image_file; // Mapping of the image itself (NULL: pixels are read in place)
+    size_t image_size;       // Size of image_file
+
+    /* Extraction position */
+    BmpInfo bmp;        // Parsed header: pixel layout (any carrier format)
+    size_t image_pos;   // File offset of the next image byte
+    size_t pixel_pos;   // Pixel bytes used so far (padding excluded)
+
+    /* LSB depth */
+    uint depth;     // Payload bits per channel, 1-4 (from the extended header)
+    uint cur_depth; // Depth decode_data uses right now (header fields always use 1)
+    uint bit_phase; // Bits already taken from the pending carrier byte
+    uchar pending;  // Carrier byte being drained across decode_data calls
+
+    /* Compression */
+    uint codec;             // STEGO_CODEC_* applied to the stored secret
+    long size_raw_out_file; // Secret size after decompression
+    int wide_sizes;         // Size fields are 64 bits (STEGO_FLAG_SIZE64)
+
+    /* Integrity */
+    int checksum; // Image carries header and payload CRC32C (extended header version 2)
+    uint crc;     // Running CRC32C of the bytes decoded since the last reset
+
+    int threads; // Threads used to stripe large payloads (<= 1: serial)
+
+    /* Keyed scattering */
+    int scatter;            // Payload stored in keyed blocks (STEGO_FLAG_SCATTER in the header)
+    const char *key;        // Scatter passphrase (NULL: the magic string)
+    int scattering;         // image_pos and bmp describe the scattered stream (payload stage)
+    ScatterMap scatter_map; // Slot order and real layout while scattering
+
+    /* Encryption */
+    const uchar *aead_key; // AEAD_KEY_BYTES key opening a sealed payload (NULL: none given)
+    int sealed;            // Payload sealed with ChaCha20-Poly1305 (STEGO_FLAG_AEAD in the header)
+    AeadStream aead;       // Chunk being handed out (buf carved from arena)
+
+    StegoShard shard; // Shard record (STEGO_FLAG_SHARD; count 0: whole payload)
+
+    StegoStats *stats; // Stage counters (NULL: not recorded)
+
+    /* Header-only use (scan mode, stego_peek) */
+    int header_only; // Only header fields are decoded: inp_map may hold just the start of the image
+    int quiet;       // Do not print why an image or a library call is rejected
+
+    /* Job memory: kept across jobs by batch workers, freed with arena_free */
+    StegoArena arena;
+    uchar *chunk;     // DECODE_CHUNK payload bytes
+    uchar *lz_packed; // One packed block as stored
+    uchar *lz_data;   // One inflated block (NULL: inflate straight into out_mem)
+    uchar *window;    // DECODE_WINDOW image bytes (stdio input)
+
 } DecodeInfo;
 
 /* Read and validate Decode args from argv */
@@ -36,12 +114,36 @@ Status read_and_validate_decode_args(int argc, char *argv[]); // Validate decode
 /* Get File pointers for input and output files */
 Status open_files_dec(DecodeInfo *decInfo); // Open files for decoding
 
+/* Unmap and close input and output files */
+Status close_files_dec(DecodeInfo *decInfo); // Close decoding files
+
+/* Free the pixels loaded from an encoded image and point inp_map at the image again */
+void release_stego_pixels(DecodeInfo *decInfo);
+
+/* Carve the work buffers from the job arena (reserved by open_files_dec or set up by the caller) */
+Status alloc_decode_buffers(DecodeInfo *decInfo);
+
 /* Check magic string in stego image */
 Status magic_string_status(const char *magic_string, DecodeInfo *decInfo); // Verify magic string
 
+/* Open files, decode and close (one complete job) */
+Status run_decode(DecodeInfo *decInfo); // Run one decode job
+
 /* Perform the decoding */
 Status do_decoding(DecodeInfo *decInfo); // Main decoding function
 
+/* Output name plus the stored extension (NULL if out of memory; free it with free) */
+char *output_file_name(const char *out_fname, const char *extn);
+
+/* Parse the image header (loading the pixels of an encoded image) and position at the first pixel byte */
+Status parse_stego_image(DecodeInfo *decInfo);
+
+/* Parse image, check magic string and read extension and size fields */
+Status decode_stego_header(DecodeInfo *decInfo);
+
+/* Decode header and secret into fptr_out (or out_mem), without renaming */
+Status decode_secret(DecodeInfo *decInfo);
+
 /* Get size of secret file extension */
 Status get_size_extn_out_file(DecodeInfo *decInfo); // Get extension size
 
@@ -51,9 +153,21 @@ Status get_extn_out_file(DecodeInfo *decInfo); // Get extension
 /* Get size of secret file */
 Status get_size_out_file(DecodeInfo *decInfo); // Get secret file size
 
+/* Check the CRC32C of the extended header fields (version 2 only) */
+Status get_header_crc(DecodeInfo *decInfo); // Verify header checksum
+
 /* Write decoded data to output file */
 Status write_out_file(DecodeInfo *decInfo); // Write secret data to file
 
+/* Decode a block of bytes from image into a buffer */
+Status decode_data(DecodeInfo *decInfo, uchar *data, uint len); // Extract len bytes
+
+/* Decode a 32-bit integer from image */
+Status decode_32(DecodeInfo *decInfo, long *value); // Decode 32 bits to an int
+
+/* Decode a 64-bit size from image (fails above LONG_MAX) */
+Status decode_64(DecodeInfo *decInfo, long *value);
+
 /* Decode a character from image */
 Status decode_8(DecodeInfo *decInfo); // Decode 8 bits to a char
 
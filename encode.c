@@ -1,7 +1,18 @@
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "aead.h"
+#include "carrier.h"
+#include "crc32c.h"
 #include "encode.h"
+#include "lsb.h"
+#include "lz.h"
+#include "stego_header.h"
+#include "mmap_io.h"
+#include "scatter.h"
+#include "stream_io.h"
+#include "stripe.h"
 #include "types.h"
 
 /* Function Definitions */
@@ -15,8 +26,8 @@ Status read_and_validate_encode_args(int argc, char *argv[])
         return e_failure;
     }
 
-    // Check input file type is .bmp
-    if (strstr(argv[2], ".bmp") == NULL)
+    // Check input file type is a supported image ("-" reads the image from stdin)
+    if (!is_carrier_name(argv[2]) && !is_stream_name(argv[2]))
     {
         printf("ERROR: Incorrect input file type.\n");
         return e_failure;
@@ -29,32 +40,55 @@ Status read_and_validate_encode_args(int argc, char *argv[])
     //     return e_failure;
     // }
 
-    // Check output file type is .bmp (if provided)
+    // Check output file type is an image of the same format (if provided, "-" writes to stdout)
     if (argc == 6)
     {
-        if (strstr(argv[4], ".bmp") == NULL)
+        if (!is_carrier_name(argv[4]) && !is_stream_name(argv[4]))
         {
             printf("ERROR: Incorrect output file type.\n");
             return e_failure;
         }
+        if (!is_stream_name(argv[2]) && !is_stream_name(argv[4]) && carrier_name_format(argv[2]) != carrier_name_format(argv[4]))
+        {
+            printf("ERROR: Output image must have the format of the input image.\n");
+            return e_failure;
+        }
     }
 
     return e_success;
 }
 
-uint get_image_size_for_bmp(FILE *fptr_image)
+size_t get_image_size_for_bmp(const BmpInfo *bmp)
+{
+    // Pixel bytes only: row padding and header bytes carry no payload
+    return bmp->pixel_bytes;
+}
+
+static Status load_encoded_carrier(EncodeInfo *encInfo)
 {
-    uint width, height;
-    fseek(fptr_image, 18, SEEK_SET);            // Seek to width in BMP header
-    fread(&width, sizeof(int), 1, fptr_image);  // Read width
-    fread(&height, sizeof(int), 1, fptr_image); // Read height
-    fseek(fptr_image, 0, SEEK_SET);             // Reset file pointer
-    return width * height * 3;                  // Return image capacity in bytes
+    // Encoded carriers (PNG) are embedded in pixel buffers and stored again at the end: nothing is cloned or mapped
+    uchar *pixels, *stego;
+    size_t len;
+    if (load_carrier(encInfo->src_map, encInfo->map_size, &encInfo->bmp, 0, &pixels, &len) != e_success)
+        return e_failure;
+    if ((stego = malloc(len)) == NULL)
+    {
+        printf("ERROR: Unable to allocate image buffer.\n");
+        free(pixels);
+        return e_failure;
+    }
+
+    encInfo->carrier_file = encInfo->src_map;
+    encInfo->carrier_size = encInfo->map_size;
+    encInfo->src_map = pixels;
+    encInfo->stego_map = stego;
+    encInfo->map_size = len;
+    return e_success;
 }
 
 Status open_files(EncodeInfo *encInfo)
 {
-    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    encInfo->fptr_src_image = open_input(encInfo->src_image_fname);
     // Fail if source image cannot be opened
     if (encInfo->fptr_src_image == NULL)
     {
@@ -63,27 +97,106 @@ Status open_files(EncodeInfo *encInfo)
         return e_failure;
     }
 
-    encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
+    encInfo->fptr_secret = open_input(encInfo->secret_fname);
     // Fail if secret file cannot be opened
     if (encInfo->fptr_secret == NULL)
     {
         perror("fopen");
         fprintf(stderr, "ERROR: Unable to open file %s\n", encInfo->secret_fname);
+        close_stream(encInfo->fptr_src_image);
         return e_failure;
     }
 
-    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");
+    encInfo->fptr_stego_image = open_output(encInfo->stego_image_fname);
     // Fail if stego image cannot be opened
     if (encInfo->fptr_stego_image == NULL)
     {
         perror("fopen");
         fprintf(stderr, "ERROR: Unable to open file %s\n", encInfo->stego_image_fname);
+        close_stream(encInfo->fptr_src_image);
+        close_stream(encInfo->fptr_secret);
+        return e_failure;
+    }
+
+    // Map carrier and stego image when both are regular files, else stay on stdio
+    encInfo->src_map = map_file_read(encInfo->fptr_src_image, &encInfo->map_size);
+    encInfo->stego_map = NULL;
+    encInfo->carrier_file = NULL;
+    encInfo->cloned = 0;
+    encInfo->carrier_pos = 0;
+    encInfo->pixel_pos = 0;
+
+    // Parse the header once so capacity checks never seek the carrier
+    Status status = e_success;
+    if (encInfo->src_map != NULL)
+    {
+        status = parse_carrier_header(encInfo->src_map, encInfo->map_size, &encInfo->bmp);
+        if (status == e_success && carrier_encoded(&encInfo->bmp))
+        {
+            status = load_encoded_carrier(encInfo);
+        }
+        else if (status == e_success && encInfo->bmp.image_end > encInfo->map_size)
+        {
+            printf("ERROR: Truncated image.\n");
+            status = e_failure;
+        }
+        else if (status == e_success)
+        {
+            // Clone the carrier first, so header and tail never pass through user space
+            encInfo->cloned = clone_file(encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo->map_size) == e_success;
+            STATS_IO(encInfo->stats, 0, 0, 1);
+            encInfo->stego_map = map_file_write(encInfo->fptr_stego_image, encInfo->map_size);
+            if (encInfo->stego_map == NULL)
+            {
+                unmap_file(encInfo->src_map, encInfo->map_size);
+                encInfo->src_map = NULL;
+                encInfo->cloned = 0;
+            }
+        }
+    }
+    if (status == e_success && encInfo->src_map == NULL)
+    {
+        status = read_carrier_header(encInfo->fptr_src_image, encInfo->bmp_header, sizeof(encInfo->bmp_header), &encInfo->bmp);
+        STATS_IO(encInfo->stats, encInfo->bmp.data_offset, 0, 1);
+    }
+
+    if (status != e_success)
+    {
+        fprintf(stderr, "ERROR: Unable to read image header from %s\n", encInfo->src_image_fname);
+        close_files(encInfo);
         return e_failure;
     }
 
     return e_success;
 }
 
+Status close_files(EncodeInfo *encInfo)
+{
+    if (encInfo->carrier_file != NULL)
+    {
+        free(encInfo->stego_map);
+        free((uchar *)encInfo->src_map);
+        unmap_file(encInfo->carrier_file, encInfo->carrier_size);
+        encInfo->carrier_file = NULL;
+        encInfo->stego_map = NULL;
+        encInfo->src_map = NULL;
+    }
+    else if (encInfo->src_map != NULL)
+    {
+        unmap_file(encInfo->stego_map, encInfo->map_size);
+        unmap_file(encInfo->src_map, encInfo->map_size);
+        encInfo->stego_map = NULL;
+        encInfo->src_map = NULL;
+    }
+
+    encInfo->packed = NULL; // Arena memory, reused by the next job
+
+    close_stream(encInfo->fptr_src_image);
+    close_stream(encInfo->fptr_secret);
+    close_stream(encInfo->fptr_stego_image);
+    return e_success;
+}
+
 OperationType check_operation_type(char *argv[])
 {
     // Determine operation type from argument
@@ -91,62 +204,364 @@ OperationType check_operation_type(char *argv[])
         return e_encode;
     else if (strcmp(argv[1], "-d") == 0)
         return e_decode;
+    else if (strcmp(argv[1], "-b") == 0)
+        return e_batch;
+    else if (strcmp(argv[1], "-s") == 0)
+        return e_scan;
+    else if (strcmp(argv[1], "-D") == 0)
+        return e_serve;
     else
         return e_unsupported;
 }
 
-uint get_file_size(FILE *fptr)
+size_t get_file_size(FILE *fptr)
 {
-    fseek(fptr, 0, SEEK_END);     // Go to end of file
+    // Pipes cannot be sized up front: the payload is then framed
+    if (fseek(fptr, 0, SEEK_END) != 0) // Go to end of file
+        return FRAMED_SIZE;
     long file_size = ftell(fptr); // Get file size
     fseek(fptr, 0, SEEK_SET);     // Reset file pointer
-    return file_size;
+    return file_size < 0 ? FRAMED_SIZE : (size_t)file_size;
+}
+
+static size_t stored_size(const EncodeInfo *encInfo)
+{
+    // Payload bytes the file size field counts: sealing adds the nonce prefix and each chunk's length word and tag
+    size_t size = encInfo->size_secret_file;
+    if (encInfo->aead_key == NULL || size == FRAMED_SIZE)
+        return size;
+    return aead_sealed_size(size);
+}
+
+static int wide_sizes(const EncodeInfo *encInfo)
+{
+    // 64-bit size fields only when a size does not fit the original 32-bit ones
+    return encInfo->size_secret_file != FRAMED_SIZE &&
+           (stored_size(encInfo) > STEGO_SIZE32_MAX || encInfo->size_raw_secret > STEGO_SIZE32_MAX);
+}
+
+Status alloc_encode_buffers(EncodeInfo *encInfo)
+{
+    // One reservation per job: the fixed buffers plus the packed copy of a sized secret
+    size_t size = encInfo->size_secret_file;
+    size_t packed = 0;
+    if (encInfo->codec != STEGO_CODEC_NONE && size != FRAMED_SIZE && size > 0 && size <= ENCODE_PACK_MAX)
+        packed = ARENA_BYTES(LZ_PACK_BOUND(size));
+
+    encInfo->packed = NULL;
+    if (arena_reserve(&encInfo->arena, ENCODE_ARENA_BYTES + packed) != e_success)
+        return e_failure;
+
+    encInfo->window = arena_alloc(&encInfo->arena, ENCODE_WINDOW);
+    encInfo->chunk = arena_alloc(&encInfo->arena, FRAME_SIZE);
+    encInfo->chunk_packed = arena_alloc(&encInfo->arena, LZ_BLOCK_BOUND(FRAME_SIZE));
+    encInfo->lz_table = arena_alloc(&encInfo->arena, LZ_TABLE_BYTES);
+    encInfo->aead.buf = arena_alloc(&encInfo->arena, AEAD_CHUNK);
+    if (packed > 0)
+        encInfo->packed = arena_alloc(&encInfo->arena, packed);
+    return e_success;
+}
+
+Status compress_secret_file(EncodeInfo *encInfo)
+{
+    // Framed secrets are packed frame by frame while they stream
+    size_t size = encInfo->size_secret_file;
+    if (encInfo->codec == STEGO_CODEC_NONE || size == FRAMED_SIZE)
+        return e_success;
+
+    if (size == 0)
+    {
+        encInfo->codec = STEGO_CODEC_NONE;
+        return e_success;
+    }
+
+    // A whole packed copy of a huge secret would not fit the job's memory: stream it as packed frames instead
+    if (size > ENCODE_PACK_MAX)
+    {
+        encInfo->size_secret_file = FRAMED_SIZE;
+        return e_success;
+    }
+
+    // Pack the whole secret up front (into the arena): its stored size goes in the header
+    size_t packed = 0;
+    for (size_t done = 0; done < size;)
+    {
+        size_t len = size - done < LZ_BLOCK_SIZE ? size - done : LZ_BLOCK_SIZE;
+        if (fread(encInfo->chunk, 1, len, encInfo->fptr_secret) != len)
+            return e_failure;
+        STATS_IO(encInfo->stats, len, 0, 1);
+        packed += lz_pack_block(encInfo->chunk, len, encInfo->packed + packed, encInfo->lz_table);
+        done += len;
+    }
+
+    if (packed >= size)
+    {
+        // Not worth it: embed the secret as is
+        printf("INFO: Secret does not compress, storing it as is\n");
+        encInfo->packed = NULL;
+        encInfo->codec = STEGO_CODEC_NONE;
+        return fseek(encInfo->fptr_secret, 0, SEEK_SET) == 0 ? e_success : e_failure;
+    }
+
+    printf("INFO: Compressed secret from %zu to %zu bytes\n", size, packed);
+    encInfo->secret_mem = encInfo->packed;
+    encInfo->size_raw_secret = size;
+    encInfo->size_secret_file = packed;
+    return e_success;
+}
+
+static size_t required_capacity(EncodeInfo *encInfo, uint depth)
+{
+    // Header fields take 8 pixel bytes per byte, the payload 8 / depth (a framed secret is checked as it streams)
+    size_t size_secret_file = (encInfo->size_secret_file == FRAMED_SIZE) ? 0 : stored_size(encInfo);
+    size_t size_field = wide_sizes(encInfo) ? 8 : 4;
+    size_t header = encInfo->size_usr_migc_str + encInfo->size_extn_secret_file + 4 + size_field;
+    if (depth != 1 || encInfo->codec != STEGO_CODEC_NONE || encInfo->checksum || encInfo->scatter || size_field == 8 ||
+        encInfo->aead_key != NULL || encInfo->shard != NULL)
+        header += 4 + STEGO_HEADER_BYTES; // Extended header records depth, codec, flags and version
+    if (encInfo->shard != NULL)
+        header += STEGO_SHARD_BYTES;
+    if (encInfo->codec != STEGO_CODEC_NONE)
+        header += size_field; // Raw size
+    if (encInfo->checksum)
+    {
+        header += 4;           // Header crc
+        size_secret_file += 4; // Payload crc, stored at depth after the data
+    }
+
+    size_t payload = (8 * size_secret_file + depth - 1) / depth;
+    if (encInfo->scatter)
+    {
+        // Only whole slots in the rows after the header take a scattered payload
+        size_t slots = scatter_blocks(&encInfo->bmp, 8 * header) * SCATTER_BLOCK;
+        return payload <= slots ? 8 * header + payload : (size_t)-1;
+    }
+    return 8 * header + payload;
 }
 
 Status check_capacity(EncodeInfo *encInfo)
 {
+    // Slots are written out of order, which a stream cannot do
+    if (encInfo->scatter && encInfo->src_map == NULL)
+    {
+        printf("ERROR: Scattering needs a regular carrier file.\n");
+        return e_failure;
+    }
+
+    // Auto depth: smallest number of LSBs per channel that fits
+    if (encInfo->depth == STEGO_DEPTH_AUTO)
+    {
+        for (uint depth = 1; depth <= STEGO_MAX_DEPTH; depth++)
+        {
+            if (required_capacity(encInfo, depth) <= encInfo->image_capacity)
+            {
+                encInfo->depth = depth;
+                if (!encInfo->quiet)
+                    printf("INFO: Using %u bit(s) per channel\n", depth);
+                break;
+            }
+        }
+        if (encInfo->depth == STEGO_DEPTH_AUTO)
+            return e_failure;
+    }
+
     // Check if image can hold secret file
-    if ((encInfo->size_secret_file + (encInfo->size_usr_migc_str) + (encInfo->size_extn_secret_file) + ((uint)4) + ((uint)4)) > encInfo->image_capacity)
+    if (required_capacity(encInfo, encInfo->depth) > encInfo->image_capacity)
     {
         return e_failure;
     }
     else
     {
-        printf("SUCCESS: %s function completed\n", "check_capacity");
+        if (!encInfo->quiet)
+            printf("SUCCESS: %s function completed\n", "check_capacity");
         return e_success;
     }
 }
 
-Status do_encoding(EncodeInfo *encInfo)
+Status run_encode(EncodeInfo *encInfo)
 {
-    if (copy_bmp_header(encInfo->fptr_src_image, encInfo->fptr_stego_image) != e_success)
+    encInfo->size_usr_migc_str = strlen(encInfo->usr_migc_str);
+    encInfo->packed = NULL;
+    encInfo->secret_mem = NULL;
+
+    STATS_BEGIN(encInfo->stats, STAGE_OPEN);
+    if (open_files(encInfo) == e_failure) // Open files for encoding
     {
+        STATS_END(encInfo->stats);
+        printf("ERROR: %s function failed\n", "open_files");
         return e_failure;
     }
 
-    encode_magic_string(encInfo->usr_migc_str, encInfo); // Encode magic string
+    encInfo->image_capacity = get_image_size_for_bmp(&encInfo->bmp); // Get image capacity
+    encInfo->size_secret_file = get_file_size(encInfo->fptr_secret);     // Get secret file size
+    get_secret_file_extn(encInfo);                                        // Get secret file extension
+    Status status = alloc_encode_buffers(encInfo);                        // Carve work buffers from the job arena
+    STATS_END(encInfo->stats);
+
+    if (status != e_success)
+    {
+        printf("ERROR: %s function failed\n", "alloc_encode_buffers");
+        STATS_BEGIN(encInfo->stats, STAGE_CLOSE);
+        close_files(encInfo);
+        STATS_END(encInfo->stats);
+        return e_failure;
+    }
+
+    STATS_BEGIN(encInfo->stats, STAGE_COMPRESS);
+    status = compress_secret_file(encInfo); // Pack secret (optional)
+    STATS_END(encInfo->stats);
+    if (status != e_success)
+    {
+        printf("ERROR: %s function failed\n", "compress_secret_file");
+    }
+    else if ((status = check_capacity(encInfo)) != e_success) // Check if image can hold secret
+    {
+        printf("ERROR: %s function failed\n", "capacity_status");
+    }
+    else if ((status = do_encoding(encInfo)) != e_success) // Perform encoding
+    {
+        printf("ERROR: %s function failed\n", "do_encoding");
+    }
+
+    STATS_BEGIN(encInfo->stats, STAGE_CLOSE);
+    close_files(encInfo);
+    STATS_END(encInfo->stats);
+    return status;
+}
+
+Status do_encoding(EncodeInfo *encInfo)
+{
+    StegoStats *stats = encInfo->stats;
+    Status status;
+
+    STATS_BEGIN(stats, STAGE_HEADER);
+    status = copy_bmp_header(encInfo); // Copy BMP header
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    STATS_BEGIN(stats, STAGE_MAGIC);
+    status = encode_magic_string(encInfo->usr_migc_str, encInfo); // Encode magic string
+    if (status == e_success)
+        status = encode_stego_header(encInfo); // Encode extended header (if needed)
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    STATS_BEGIN(stats, STAGE_FIELDS);
+    status = encode_secret_file_extn(encInfo); // Encode extension
+    if (status == e_success)
+        status = encode_secret_file_size(stored_size(encInfo), encInfo); // Encode secret file size
+    if (status == e_success)
+        status = encode_header_crc(encInfo); // Encode header checksum
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    STATS_BEGIN(stats, STAGE_PAYLOAD);
+    status = encode_secret_file_data(encInfo); // Encode secret file data
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    STATS_BEGIN(stats, STAGE_TAIL);
+    status = copy_remaining_carrier(encInfo); // Copy rest of image
+    if (status == e_success && encInfo->carrier_file != NULL)
+        status = store_carrier(encInfo->carrier_file, encInfo->carrier_size, &encInfo->bmp, encInfo->stego_map,
+                               encInfo->fptr_stego_image); // Write the encoded image back
+    STATS_END(stats);
+    if (status != e_success)
+        return e_failure;
+
+    return e_success;
+}
+
+Status copy_remaining_carrier(EncodeInfo *encInfo)
+{
+    if (encInfo->cloned)
+    {
+        encInfo->carrier_pos = encInfo->map_size; // Already in place
+        return e_success;
+    }
+    if (encInfo->src_map != NULL)
+    {
+        // Copy rest of image in one go
+        size_t len = encInfo->map_size - encInfo->carrier_pos;
+        memcpy(encInfo->stego_map + encInfo->carrier_pos, encInfo->src_map + encInfo->carrier_pos, len);
+        STATS_IO(encInfo->stats, len, len, 0);
+        encInfo->carrier_pos = encInfo->map_size;
+        return e_success;
+    }
 
-    encInfo->extn_secret_file[0] = '.';
-    sscanf(encInfo->secret_fname, "%*[^.].%s", &encInfo->extn_secret_file[1]); // Extract extension
-    encode_secret_file_extn(encInfo);                                          // Encode extension
+    return copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo->window, ENCODE_WINDOW,
+                                   encInfo->stats);
+}
 
-    encode_secret_file_size(encInfo->size_secret_file, encInfo); // Encode secret file size
+Status get_secret_file_extn(EncodeInfo *encInfo)
+{
+    secret_name_extn(encInfo->secret_fname, encInfo->extn_secret_file);
+    encInfo->size_extn_secret_file = strlen(encInfo->extn_secret_file);
+    return e_success;
+}
 
-    encode_secret_file_data(encInfo); // Encode secret file data
+void secret_name_extn(const char *name, char *extn)
+{
+    // Extension is everything after the first '.' of the name (kept to MAX_FILE_SUFFIX - 1 chars)
+    char fmt[16];
+    extn[0] = '.';
+    extn[1] = '\0';
+    sprintf(fmt, "%%*[^.].%%%ds", MAX_FILE_SUFFIX - 2);
+    sscanf(name, fmt, &extn[1]); // Extract extension
+}
 
-    copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image); // Copy rest of image
+Status copy_bmp_header(EncodeInfo *encInfo)
+{
+    // Copy every byte before the pixel array (headers, palette, gap)
+    size_t size = encInfo->bmp.data_offset;
+    if (encInfo->src_map != NULL && !encInfo->cloned) // A cloned stego image has it already
+    {
+        memcpy(encInfo->stego_map, encInfo->src_map, size);
+        STATS_IO(encInfo->stats, size, size, 0);
+    }
+    else if (encInfo->src_map == NULL)
+    {
+        if (fwrite(encInfo->bmp_header, 1, size, encInfo->fptr_stego_image) != size)
+            return e_failure;
+        STATS_IO(encInfo->stats, 0, size, 1); // Header was read while opening
+    }
 
+    encInfo->carrier_pos = size;
+    encInfo->pixel_pos = 0;
+    encInfo->cur_depth = 1;
+    encInfo->bit_phase = 0;
     return e_success;
 }
 
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_stego_header(EncodeInfo *encInfo)
 {
-    // Copy BMP header (first 54 bytes)
-    char ch;
-    for (int i = 0; i < 54; i++)
+    // Without checksums, default settings keep the original layout
+    int wide = wide_sizes(encInfo);
+    int sealed = encInfo->aead_key != NULL;
+    if (encInfo->depth <= 1 && encInfo->codec == STEGO_CODEC_NONE && !encInfo->checksum && !encInfo->scatter && !wide &&
+        !sealed && encInfo->shard == NULL)
+        return e_success;
+
+    uint flags = (encInfo->scatter ? STEGO_FLAG_SCATTER : 0) | (wide ? STEGO_FLAG_SIZE64 : 0) | (sealed ? STEGO_FLAG_AEAD : 0) |
+                 (encInfo->shard != NULL ? STEGO_FLAG_SHARD : 0);
+    StegoHeader hdr = {encInfo->checksum ? STEGO_VERSION : STEGO_VERSION_PLAIN, flags, encInfo->depth, encInfo->codec};
+    uchar buf[STEGO_HEADER_BYTES];
+    uchar shard[STEGO_SHARD_BYTES];
+    int marker = STEGO_HEADER_MARKER;
+
+    pack_stego_header(&hdr, buf);
+    if (encInfo->shard != NULL)
+        pack_stego_shard(encInfo->shard, shard);
+    encInfo->crc = 0; // Header crc starts at the marker
+    if (encode_32(&marker, encInfo) != e_success || encode_data(buf, sizeof(buf), encInfo) != e_success ||
+        (encInfo->shard != NULL && encode_data(shard, sizeof(shard), encInfo) != e_success))
     {
-        ch = fgetc(fptr_src_image);
-        putc(ch, fptr_stego_image);
+        printf("ERROR: %s function failed\n", "encode_stego_header");
+        return e_failure;
     }
 
     return e_success;
@@ -161,6 +576,7 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
         if (encode_8(&magic_char, encInfo) != e_success)
         {
             printf("ERROR: %s function failed\n", "encode_magic_string");
+            return e_failure;
         }
     }
 
@@ -169,8 +585,9 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 
 Status encode_secret_file_extn(EncodeInfo *encInfo)
 {
-    encInfo->size_extn_secret_file = strlen(encInfo->extn_secret_file);
-    encode_32(&encInfo->size_extn_secret_file, encInfo); // Encode extension length
+    int size_extn = encInfo->size_extn_secret_file;
+    if (encode_32(&size_extn, encInfo) != e_success) // Encode extension length
+        return e_failure;
 
     // Encode extension characters
     for (int i = 0; i < encInfo->size_extn_secret_file; i++)
@@ -178,17 +595,31 @@ Status encode_secret_file_extn(EncodeInfo *encInfo)
         if (encode_8(&encInfo->extn_secret_file[i], encInfo) != e_success)
         {
             printf("ERROR: %s function failed\n", "encode_secret_file_extn");
+            return e_failure;
         }
     }
 
     return e_success;
 }
 
-Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
+Status encode_secret_file_size(size_t file_size, EncodeInfo *encInfo)
 {
-    int file_size_int = (int)encInfo->size_secret_file;
-    // Encode secret file size as 32 bits
-    if (encode_32(&file_size_int, encInfo) == e_success)
+    size_t raw_size = (file_size == FRAMED_SIZE) ? FRAMED_SIZE : encInfo->size_raw_secret;
+
+    // Sizes of 2 GB and more take 64-bit fields (flagged in the extended header)
+    if (wide_sizes(encInfo))
+    {
+        if (encode_64(file_size, encInfo) == e_success &&
+            (encInfo->codec == STEGO_CODEC_NONE || encode_64(raw_size, encInfo) == e_success))
+            return e_success;
+        return e_failure;
+    }
+
+    int file_size_int = (file_size == FRAMED_SIZE) ? (int)FRAMED_FIELD : (int)file_size;
+    int raw_size_int = (raw_size == FRAMED_SIZE) ? (int)FRAMED_FIELD : (int)raw_size;
+    // Encode secret file size as 32 bits, then the unpacked size if a codec is used
+    if (encode_32(&file_size_int, encInfo) == e_success &&
+        (encInfo->codec == STEGO_CODEC_NONE || encode_32(&raw_size_int, encInfo) == e_success))
     {
         return e_success;
     }
@@ -198,81 +629,490 @@ Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
     }
 }
 
-Status encode_secret_file_data(EncodeInfo *encInfo)
+Status encode_header_crc(EncodeInfo *encInfo)
 {
-    // Encode each character of secret file
-    char a_char;
-    for (int i = 0; i < encInfo->size_secret_file; i++)
+    // Only version 2 headers carry checksums (the marker was written by encode_stego_header)
+    if (!encInfo->checksum)
+        return e_success;
+
+    int crc = (int)encInfo->crc;
+    if (encode_32(&crc, encInfo) != e_success)
     {
-        a_char = fgetc(encInfo->fptr_secret);
-        if (encode_8(&a_char, encInfo) != e_success)
-        {
-            printf("ERROR: %s function failed\n", "encode_secret_file_data");
-            return e_failure;
-        }
+        printf("ERROR: %s function failed\n", "encode_header_crc");
+        return e_failure;
     }
 
     return e_success;
 }
 
-Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
+static Status encode_secret_file_striped(EncodeInfo *encInfo)
 {
-    // Copy remaining image data after secret is encoded
-    char a_char;
-    while (fread(&a_char, 1, 1, fptr_src) > 0)
+    // Stripes need one contiguous run of pixel bytes (rows without padding)
+    size_t size = encInfo->size_secret_file;
+    size_t carriers = (8 * size + encInfo->cur_depth - 1) / encInfo->cur_depth;
+    if (encInfo->bmp.row_bytes != encInfo->bmp.row_stride || encInfo->bit_phase != 0 || encInfo->pixel_pos + carriers > encInfo->bmp.pixel_bytes)
+        return e_failure;
+
+    // Embed the whole secret from memory (or its mapping), one stripe per thread
+    size_t secret_size = 0;
+    const uchar *secret = encInfo->secret_mem;
+    if (secret == NULL && ((secret = map_file_read(encInfo->fptr_secret, &secret_size)) == NULL || secret_size < size))
     {
-        fputc(a_char, fptr_dest);
+        unmap_file(secret, secret_size);
+        return e_failure;
     }
 
+    stripe_embed(encInfo->stego_map + encInfo->carrier_pos, encInfo->src_map + encInfo->carrier_pos, secret, size, encInfo->cur_depth, encInfo->threads);
+    if (encInfo->checksum)
+        encInfo->crc = crc32c(encInfo->crc, secret, size);
+    STATS_IO(encInfo->stats, size + carriers, carriers, 0);
+    encInfo->carrier_pos += carriers;
+    encInfo->pixel_pos += carriers;
+
+    // A part-filled last carrier byte becomes the pending byte, so the crc can continue in it
+    uint used = (8 * size) % encInfo->cur_depth;
+    if (used != 0)
+    {
+        encInfo->carrier_pos--;
+        encInfo->pixel_pos--;
+        encInfo->pending = encInfo->stego_map[encInfo->carrier_pos];
+        encInfo->bit_phase = used;
+    }
+    if (secret != encInfo->secret_mem)
+        unmap_file(secret, secret_size);
     return e_success;
 }
 
-Status encode_8(char *en_char, EncodeInfo *encInfo)
+static Status seal_chunk(EncodeInfo *encInfo, int final)
 {
-    // Encode 8 bits of a character into image
-    for (int i = 0; i < 8; i++)
+    // Encrypt the buffered chunk in place and embed it behind its length word, then its tag
+    uchar word[4], tag[AEAD_TAG_BYTES];
+    if (aead_seal_chunk(&encInfo->aead, final, word, tag) != e_success || encode_data(word, 4, encInfo) != e_success ||
+        encode_data(encInfo->aead.buf, encInfo->aead.len, encInfo) != e_success ||
+        encode_data(tag, AEAD_TAG_BYTES, encInfo) != e_success)
+        return e_failure;
+    encInfo->aead.len = 0;
+    return e_success;
+}
+
+static Status embed_payload(const uchar *data, size_t len, EncodeInfo *encInfo)
+{
+    // Payload bytes go straight to the LSBs, or through the chunk being sealed
+    if (encInfo->aead_key == NULL)
+        return encode_data(data, len, encInfo);
+
+    while (len > 0)
     {
-        int bit = (*en_char >> (7 - i)) & 1; // Get bit (MSB first)
-        char file_bit = fgetc(encInfo->fptr_src_image);
+        // A full chunk is sealed only once more bytes arrive, so the last chunk is never empty
+        if (encInfo->aead.len == AEAD_CHUNK && seal_chunk(encInfo, 0) != e_success)
+            return e_failure;
+        size_t take = AEAD_CHUNK - encInfo->aead.len < len ? AEAD_CHUNK - encInfo->aead.len : len;
+        memcpy(encInfo->aead.buf + encInfo->aead.len, data, take);
+        encInfo->aead.len += take;
+        data += take;
+        len -= take;
+    }
+    return e_success;
+}
+
+static Status embed_payload_32(int value, EncodeInfo *encInfo)
+{
+    // Frame length, big-endian like encode_32
+    uchar buf[4] = {(uchar)((uint)value >> 24), (uchar)((uint)value >> 16), (uchar)((uint)value >> 8), (uchar)value};
+    if (encInfo->aead_key == NULL)
+        return encode_32(&value, encInfo);
+    return embed_payload(buf, 4, encInfo);
+}
 
-        if (bit == 1)
+static Status encode_secret_file_frames(EncodeInfo *encInfo)
+{
+    // Secret of unknown length: send it as length-prefixed frames, then a 0 frame
+    int frame_len;
+    do
+    {
+        frame_len = fread(encInfo->chunk, 1, FRAME_SIZE, encInfo->fptr_secret);
+        STATS_IO(encInfo->stats, frame_len, 0, 1);
+        uchar *frame = encInfo->chunk;
+        if (encInfo->codec != STEGO_CODEC_NONE && frame_len > 0)
         {
-            file_bit = file_bit | 1; // Set LSB
+            // One packed block per frame
+            frame_len = lz_pack_block(encInfo->chunk, frame_len, encInfo->chunk_packed, encInfo->lz_table);
+            frame = encInfo->chunk_packed;
+        }
+        if (embed_payload_32(frame_len, encInfo) != e_success || embed_payload(frame, frame_len, encInfo) != e_success)
+        {
+            printf("ERROR: %s function failed\n", "encode_secret_file_frames");
+            return e_failure;
         }
-        else
+    } while (frame_len > 0);
+
+    return e_success;
+}
+
+static Status encode_secret_file_payload(EncodeInfo *encInfo)
+{
+    if (encInfo->size_secret_file == FRAMED_SIZE)
+        return encode_secret_file_frames(encInfo);
+
+    // Large payloads on mapped carriers are split across threads
+    if (encInfo->src_map != NULL && !encInfo->scattering && encInfo->aead_key == NULL && encInfo->threads > 1 &&
+        encInfo->size_secret_file >= STRIPE_MIN_BYTES &&
+        encode_secret_file_striped(encInfo) == e_success)
+    {
+        return e_success;
+    }
+
+    // Secret already in memory (packed copy or library caller's buffer), at most 1 GB per call
+    if (encInfo->secret_mem != NULL)
+    {
+        for (size_t done = 0; done < encInfo->size_secret_file;)
         {
-            file_bit = file_bit & ~1; // Clear LSB
+            size_t len = encInfo->size_secret_file - done < (1u << 30) ? encInfo->size_secret_file - done : (1u << 30);
+            if (embed_payload(encInfo->secret_mem + done, len, encInfo) != e_success)
+            {
+                printf("ERROR: %s function failed\n", "encode_secret_file_data");
+                return e_failure;
+            }
+            done += len;
         }
+        return e_success;
+    }
 
-        fputc(file_bit, encInfo->fptr_stego_image);
+    // Encode secret file one block at a time
+    size_t remaining = encInfo->size_secret_file;
+    while (remaining > 0)
+    {
+        uint len = remaining < ENCODE_CHUNK ? remaining : ENCODE_CHUNK;
+        STATS_IO(encInfo->stats, len, 0, 1);
+        if (fread(encInfo->chunk, 1, len, encInfo->fptr_secret) != len ||
+            embed_payload(encInfo->chunk, len, encInfo) != e_success)
+        {
+            printf("ERROR: %s function failed\n", "encode_secret_file_data");
+            return e_failure;
+        }
+        remaining -= len;
     }
 
     return e_success;
 }
 
-Status encode_32(int *en_int, EncodeInfo *encInfo)
+static Status begin_scatter(EncodeInfo *encInfo)
+{
+    // The carrier after the header goes out unchanged first; the payload then overwrites its slots
+    if (encInfo->src_map == NULL || encInfo->bit_phase != 0 || copy_remaining_carrier(encInfo) != e_success)
+        return e_failure;
+
+    scatter_init(&encInfo->scatter_map, &encInfo->bmp, encInfo->pixel_pos,
+                 encInfo->key != NULL ? encInfo->key : encInfo->usr_migc_str);
+    if (encInfo->scatter_map.nblocks == 0)
+        return e_failure;
+
+    // From here on positions count bytes of the scattered stream
+    scatter_view(&encInfo->scatter_map, &encInfo->bmp);
+    encInfo->carrier_pos = 0;
+    encInfo->pixel_pos = 0;
+    encInfo->scattering = 1;
+    return e_success;
+}
+
+static void end_scatter(EncodeInfo *encInfo)
+{
+    encInfo->bmp = encInfo->scatter_map.bmp;
+    encInfo->carrier_pos = encInfo->map_size; // Everything after the header is written
+    encInfo->pixel_pos = encInfo->bmp.pixel_bytes;
+    encInfo->scattering = 0;
+}
+
+static size_t carrier_offset(const EncodeInfo *encInfo)
+{
+    // File offset of the carrier byte at carrier_pos
+    if (encInfo->scattering)
+        return scatter_offset(&encInfo->scatter_map, encInfo->carrier_pos);
+    return encInfo->carrier_pos;
+}
+
+Status encode_secret_file_data(EncodeInfo *encInfo)
+{
+    // Payload (and its crc) is stored at the configured depth, then the last carrier byte is completed
+    encInfo->cur_depth = encInfo->depth ? encInfo->depth : 1;
+    encInfo->crc = 0;
+    if (encInfo->scatter && begin_scatter(encInfo) != e_success)
+    {
+        printf("ERROR: %s function failed\n", "begin_scatter");
+        return e_failure;
+    }
+
+    Status status = e_success;
+    if (encInfo->aead_key != NULL)
+    {
+        // Sealed payload: a fresh nonce prefix, then the chunks
+        uchar prefix[AEAD_PREFIX_BYTES];
+        status = aead_random_prefix(prefix);
+        if (status == e_success)
+            status = encode_data(prefix, sizeof(prefix), encInfo);
+        aead_stream_init(&encInfo->aead, encInfo->aead_key, prefix, encInfo->aead.buf);
+    }
+
+    if (status == e_success)
+        status = encode_secret_file_payload(encInfo);
+    if (encInfo->aead_key != NULL)
+    {
+        if (status == e_success)
+            status = seal_chunk(encInfo, 1);
+        aead_stream_wipe(&encInfo->aead);
+    }
+    if (status == e_success && encInfo->checksum)
+    {
+        int crc = (int)encInfo->crc;
+        status = encode_32(&crc, encInfo);
+    }
+    if (status == e_success)
+        status = encode_flush(encInfo);
+    if (encInfo->scattering)
+        end_scatter(encInfo);
+    encInfo->cur_depth = 1;
+    return status;
+}
+
+Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest, uchar *block, size_t size, StegoStats *stats)
+{
+    // Copy remaining image data after secret is encoded, size bytes at a time
+    size_t len;
+    while ((len = fread(block, 1, size, fptr_src)) > 0)
+    {
+        STATS_IO(stats, len, len, 2);
+        if (fwrite(block, 1, len, fptr_dest) != len)
+            return e_failure;
+    }
+
+    return e_success;
+}
+
+static Status copy_carrier(EncodeInfo *encInfo, size_t len)
+{
+    // Copy len carrier bytes unchanged (row padding)
+    if (encInfo->src_map != NULL)
+    {
+        memcpy(encInfo->stego_map + encInfo->carrier_pos, encInfo->src_map + encInfo->carrier_pos, len);
+        STATS_IO(encInfo->stats, len, len, 0);
+        encInfo->carrier_pos += len;
+        return e_success;
+    }
+
+    uchar block[64];
+    while (len > 0)
+    {
+        size_t n = len < sizeof(block) ? len : sizeof(block);
+        STATS_IO(encInfo->stats, n, n, 2);
+        if (fread(block, 1, n, encInfo->fptr_src_image) != n || fwrite(block, 1, n, encInfo->fptr_stego_image) != n)
+            return e_failure;
+        encInfo->carrier_pos += n;
+        len -= n;
+    }
+    return e_success;
+}
+
+static void embed_scattered(EncodeInfo *encInfo, const uchar *data, size_t first_bit, size_t ncarrier)
 {
-    // Encode 32 bits of an integer into image
-    for (int i = 0; i < 32; i++)
+    // Look up a batch of slots at a time; each block is one contiguous kernel call
+    uint depth = encInfo->cur_depth;
+    size_t offsets[SCATTER_BATCH];
+    STATS_IO(encInfo->stats, ncarrier, ncarrier, 0);
+
+    while (ncarrier > 0)
     {
-        int bit = (*en_int >> (31 - i)) & 1; // Get bit (MSB first)
-        char file_bit = fgetc(encInfo->fptr_src_image);
+        size_t skip = encInfo->carrier_pos % SCATTER_BLOCK;
+        size_t nblocks = (skip + ncarrier + SCATTER_BLOCK - 1) / SCATTER_BLOCK;
+        if (nblocks > SCATTER_BATCH)
+            nblocks = SCATTER_BATCH;
+        scatter_offsets(&encInfo->scatter_map, encInfo->carrier_pos / SCATTER_BLOCK, nblocks, offsets);
 
-        if (bit == 1)
+        // Start every miss of the batch before the first block is touched
+        for (size_t i = 0; i < nblocks; i++)
         {
-            file_bit = file_bit | 1;
+            __builtin_prefetch(encInfo->src_map + offsets[i], 0);
+            __builtin_prefetch(encInfo->stego_map + offsets[i], 1);
         }
-        else if (bit == 0)
+
+        for (size_t i = 0; i < nblocks && ncarrier > 0; i++)
         {
-            file_bit = file_bit & ~1;
+            size_t n = SCATTER_BLOCK - skip < ncarrier ? SCATTER_BLOCK - skip : ncarrier;
+            size_t off = offsets[i] + skip;
+            lsb_embed_k(encInfo->stego_map + off, encInfo->src_map + off, data, first_bit, n * depth, depth);
+            first_bit += n * depth;
+            ncarrier -= n;
+            encInfo->carrier_pos += n;
+            skip = 0;
         }
-        else
-        {
-            printf("ERROR: %s function failed\n", "encode_32");
+    }
+}
+
+static Status embed_span(EncodeInfo *encInfo, const uchar *data, size_t first_bit, size_t ncarrier)
+{
+    // Embed payload bits into ncarrier contiguous pixel bytes of one row
+    uint depth = encInfo->cur_depth;
+    if (encInfo->scattering)
+    {
+        embed_scattered(encInfo, data, first_bit, ncarrier);
+        return e_success;
+    }
+    if (encInfo->src_map != NULL)
+    {
+        lsb_embed_k(encInfo->stego_map + encInfo->carrier_pos, encInfo->src_map + encInfo->carrier_pos, data, first_bit, ncarrier * depth, depth);
+        STATS_IO(encInfo->stats, ncarrier, ncarrier, 0);
+        encInfo->carrier_pos += ncarrier;
+        return e_success;
+    }
+
+    uchar *carrier = encInfo->window;
+    while (ncarrier > 0)
+    {
+        size_t n = ncarrier < ENCODE_WINDOW ? ncarrier : ENCODE_WINDOW;
+        if (fread(carrier, 1, n, encInfo->fptr_src_image) != n)
             return e_failure;
-        }
 
-        fputc(file_bit, encInfo->fptr_stego_image);
+        lsb_embed_k(carrier, carrier, data, first_bit, n * depth, depth);
+        STATS_IO(encInfo->stats, n, n, 2);
+
+        if (fwrite(carrier, 1, n, encInfo->fptr_stego_image) != n)
+            return e_failure;
+        encInfo->carrier_pos += n;
+        first_bit += n * depth;
+        ncarrier -= n;
+    }
+    return e_success;
+}
+
+static Status end_of_row(EncodeInfo *encInfo)
+{
+    // Copy row padding once the last pixel byte of a row is done
+    const BmpInfo *bmp = &encInfo->bmp;
+    if (encInfo->pixel_pos % bmp->row_bytes != 0)
+        return e_success;
+    return copy_carrier(encInfo, bmp->row_stride - bmp->row_bytes);
+}
+
+Status encode_flush(EncodeInfo *encInfo)
+{
+    if (encInfo->bit_phase == 0)
+        return e_success;
+
+    // Write the part-filled carrier byte; its unused LSBs keep the source bits
+    if (encInfo->src_map != NULL)
+        encInfo->stego_map[carrier_offset(encInfo)] = encInfo->pending;
+    else if (fputc(encInfo->pending, encInfo->fptr_stego_image) == EOF)
+        return e_failure;
+    STATS_IO(encInfo->stats, 0, 1, encInfo->src_map == NULL);
+
+    encInfo->carrier_pos++;
+    encInfo->pixel_pos++;
+    encInfo->bit_phase = 0;
+    return end_of_row(encInfo);
+}
+
+static void fill_pending(EncodeInfo *encInfo, const uchar *data, size_t *bit, size_t nbits)
+{
+    // Place payload bits into the free LSBs of the pending carrier byte, highest first
+    uint depth = encInfo->cur_depth;
+    for (; *bit < nbits && encInfo->bit_phase < depth; (*bit)++, encInfo->bit_phase++)
+    {
+        uint shift = depth - 1 - encInfo->bit_phase;
+        uint value = (data[*bit / 8] >> (7 - *bit % 8)) & 1;
+        encInfo->pending = (encInfo->pending & ~(1 << shift)) | (value << shift);
+    }
+}
+
+Status encode_data(const uchar *data, uint len, EncodeInfo *encInfo)
+{
+    const BmpInfo *bmp = &encInfo->bmp;
+    uint depth = encInfo->cur_depth;
+    size_t nbits = 8 * (size_t)len;
+    size_t bit = 0;
+
+    if (encInfo->checksum)
+        encInfo->crc = crc32c(encInfo->crc, data, len);
+
+    // Finish the carrier byte left part-filled by the previous call
+    if (encInfo->bit_phase > 0)
+    {
+        fill_pending(encInfo, data, &bit, nbits);
+        if (encInfo->bit_phase < depth)
+            return e_success;
+        if (encode_flush(encInfo) != e_success)
+            return e_failure;
+    }
+
+    size_t whole = (nbits - bit) / depth;
+    size_t partial = ((nbits - bit) % depth) ? 1 : 0;
+    if (encInfo->pixel_pos + whole + partial > bmp->pixel_bytes)
+        return e_failure; // Out of pixel bytes
+
+    // Walk the rows: each row is one span, padding is copied as is
+    while (whole > 0)
+    {
+        size_t span = bmp->row_bytes - encInfo->pixel_pos % bmp->row_bytes;
+        if (span > whole)
+            span = whole;
+
+        if (embed_span(encInfo, data, bit, span) != e_success)
+            return e_failure;
+        bit += span * depth;
+        whole -= span;
+        encInfo->pixel_pos += span;
+
+        if (end_of_row(encInfo) != e_success)
+            return e_failure;
+    }
+
+    // Leftover bits start a new part-filled carrier byte
+    if (partial)
+    {
+        if (encInfo->src_map != NULL)
+            encInfo->pending = encInfo->src_map[carrier_offset(encInfo)];
+        else if (fread(&encInfo->pending, 1, 1, encInfo->fptr_src_image) != 1)
+            return e_failure;
+        STATS_IO(encInfo->stats, 1, 0, encInfo->src_map == NULL);
+        fill_pending(encInfo, data, &bit, nbits);
+    }
+
+    return e_success;
+}
+
+Status encode_8(char *en_char, EncodeInfo *encInfo)
+{
+    // Encode 8 bits of a character into image
+    return encode_data((const uchar *)en_char, 1, encInfo);
+}
+
+Status encode_32(int *en_int, EncodeInfo *encInfo)
+{
+    // Encode 32 bits of an integer into image (MSB first)
+    uchar bytes[4];
+    bytes[0] = (uint)*en_int >> 24;
+    bytes[1] = (uint)*en_int >> 16;
+    bytes[2] = (uint)*en_int >> 8;
+    bytes[3] = (uint)*en_int;
+
+    if (encode_data(bytes, 4, encInfo) != e_success)
+    {
+        printf("ERROR: %s function failed\n", "encode_32");
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+Status encode_64(unsigned long long value, EncodeInfo *encInfo)
+{
+    // Encode 64 bits (MSB first)
+    uchar bytes[8];
+    for (int i = 0; i < 8; i++)
+        bytes[i] = value >> (56 - 8 * i);
+
+    if (encode_data(bytes, 8, encInfo) != e_success)
+    {
+        printf("ERROR: %s function failed\n", "encode_64");
+        return e_failure;
     }
 
     return e_success;
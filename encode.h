@@ -1,6 +1,15 @@
 #ifndef ENCODE_H
 #define ENCODE_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include "aead.h"
+#include "arena.h"
+#include "bmp.h"
+#include "lz.h"
+#include "scatter.h"
+#include "stats.h"
+#include "stego_header.h"
 #include "types.h" // Contains user defined types
 
 /*
@@ -10,28 +19,101 @@
  * also stored
  */
 
-#define MAX_FILE_SUFFIX 4
+#define MAX_FILE_SUFFIX 8
+#define ENCODE_CHUNK 4096 // Payload bytes embedded per block
+
+/*
+ * Secret size written when the secret cannot be sized up front (pipe).
+ * The payload then follows as frames of a 32-bit length and that many
+ * bytes, ending with a zero-length frame.
+ */
+#define FRAMED_SIZE ((size_t)-1)
+#define FRAMED_FIELD 0xFFFFFFFFu // What FRAMED_SIZE is stored as
+#define FRAME_SIZE (16 * ENCODE_CHUNK) // Largest frame written by the encoder (at least LZ_BLOCK_SIZE)
+#define ENCODE_WINDOW (8 * ENCODE_CHUNK) // Carrier bytes read per step on stdio
+#define ENCODE_PACK_MAX (256u << 20) // Larger secrets are packed frame by frame instead of in one piece
+
+/* Fixed part of an encode job's arena: window, secret chunk, one packed frame, the packer's table and one sealed chunk */
+#define ENCODE_ARENA_BYTES (ARENA_BYTES(ENCODE_WINDOW) + ARENA_BYTES(FRAME_SIZE) + ARENA_BYTES(LZ_BLOCK_BOUND(FRAME_SIZE)) + \
+                            ARENA_BYTES(LZ_TABLE_BYTES) + ARENA_BYTES(AEAD_CHUNK))
 
 typedef struct _EncodeInfo
 {
     /* Source Image info */
-    char src_image_fname[20];
+    const char *src_image_fname; // Carrier path (caller's string)
     FILE *fptr_src_image;
-    uint image_capacity;
+    uchar bmp_header[BMP_MAX_HEADER]; // Bytes before the pixels, read once at open
+    BmpInfo bmp;                      // Parsed header: pixel layout (any carrier format)
+    size_t image_capacity;            // Pixel bytes available for LSBs
     char usr_migc_str[10];  // Input magic string
     uint size_usr_migc_str; // Length of input magic string
 
     /* Secret File Info */
-    char secret_fname[20];
+    const char *secret_fname; // Secret path (caller's string)
     FILE *fptr_secret;
     char extn_secret_file[MAX_FILE_SUFFIX];
     uint size_extn_secret_file;
-    uint size_secret_file;
+    size_t size_secret_file;
 
     /* Stego Image Info */
-    char stego_image_fname[20];
+    const char *stego_image_fname; // Output path (caller's string)
     FILE *fptr_stego_image;
 
+    /* Memory mapped carrier and stego image (NULL when using stdio) */
+    const uchar *src_map;
+    uchar *stego_map;
+    size_t map_size;
+    int cloned; // Stego image already holds a copy of the carrier: only payload bytes are written
+
+    /* Encoded carrier (PNG): src_map and stego_map are pixel buffers, the image is stored again at the end */
+    const uchar *carrier_file; // Mapped carrier file (NULL: pixels are read and written in place)
+    size_t carrier_size;       // Size of carrier_file
+
+    /* Embedding position */
+    size_t carrier_pos; // File offset of the next carrier byte
+    size_t pixel_pos;   // Pixel bytes used so far (padding excluded)
+
+    /* LSB depth */
+    uint depth;     // Payload bits per channel, 1-4 (STEGO_DEPTH_AUTO: chosen by check_capacity)
+    uint cur_depth; // Depth encode_data uses right now (header fields always use 1)
+    uint bit_phase; // Bits already placed in the pending carrier byte
+    uchar pending;  // Carrier byte being filled across encode_data calls
+
+    /* Compression */
+    uint codec;           // STEGO_CODEC_* for the secret (dropped when it does not help)
+    size_t size_raw_secret; // Secret size before compression
+    uchar *packed;        // Packed copy of a secret file (carved from arena)
+
+    const uchar *secret_mem; // Secret held in memory (packed copy or caller's buffer); NULL: read from fptr_secret
+
+    /* Integrity */
+    int checksum; // Store header and payload CRC32C (extended header version 2)
+    uint crc;     // Running CRC32C of the bytes embedded since the last reset
+
+    int threads; // Threads used to stripe large payloads (<= 1: serial)
+
+    /* Keyed scattering */
+    int scatter;            // Store the payload in keyed blocks (STEGO_FLAG_SCATTER)
+    const char *key;        // Scatter passphrase (NULL: the magic string)
+    int scattering;         // carrier_pos and bmp describe the scattered stream (payload stage)
+    ScatterMap scatter_map; // Slot order and real layout while scattering
+
+    /* Encryption */
+    const uchar *aead_key; // AEAD_KEY_BYTES key sealing the payload (STEGO_FLAG_AEAD); NULL: stored in clear
+    AeadStream aead;       // Chunk being sealed (buf carved from arena)
+
+    const StegoShard *shard; // Slice of a split payload this image holds (STEGO_FLAG_SHARD); NULL: whole payload
+
+    StegoStats *stats; // Stage counters (NULL: not recorded)
+    int quiet;         // Do not print progress lines (library calls)
+
+    /* Job memory: kept across jobs by batch workers, freed with arena_free */
+    StegoArena arena;
+    uchar *window;       // ENCODE_WINDOW carrier bytes (stdio carriers)
+    uchar *chunk;        // FRAME_SIZE secret bytes (stdio secrets, compression, frames)
+    uchar *chunk_packed; // One packed frame
+    uint *lz_table;      // Match table of the packer
+
 } EncodeInfo;
 
 /* Encoding function prototype */
@@ -42,23 +124,44 @@ OperationType check_operation_type(char *argv[]);
 /* Read and validate Encode args from argv */
 Status read_and_validate_encode_args(int argc, char *argv[]);
 
+/* Open files, check capacity, encode and close (one complete job) */
+Status run_encode(EncodeInfo *encInfo);
+
 /* Perform the encoding */
 Status do_encoding(EncodeInfo *encInfo);
 
 /* Get File pointers for i/p and o/p files */
 Status open_files(EncodeInfo *encInfo);
 
+/* Unmap and close i/p and o/p files */
+Status close_files(EncodeInfo *encInfo);
+
+/* Reserve the job arena and carve the work buffers (once the secret is sized) */
+Status alloc_encode_buffers(EncodeInfo *encInfo);
+
+/* Pack the secret with the selected codec */
+Status compress_secret_file(EncodeInfo *encInfo);
+
 /* check capacity */
 Status check_capacity(EncodeInfo *encInfo);
 
 /* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image);
+size_t get_image_size_for_bmp(const BmpInfo *bmp);
+
+/* Get file size (FRAMED_SIZE when the file cannot be sized) */
+size_t get_file_size(FILE *fptr);
 
-/* Get file size */
-uint get_file_size(FILE *fptr);
+/* Get secret file extension from its name */
+Status get_secret_file_extn(EncodeInfo *encInfo);
+
+/* Extension of a secret file name into extn (MAX_FILE_SUFFIX bytes) */
+void secret_name_extn(const char *name, char *extn);
 
 /* Copy bmp image header */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image);
+Status copy_bmp_header(EncodeInfo *encInfo);
+
+/* Encode a block of bytes and write */
+Status encode_data(const uchar *data, uint len, EncodeInfo *encInfo);
 
 /* Encode a character and write */
 Status encode_8(char *en_char, EncodeInfo *encInfo);
@@ -66,6 +169,15 @@ Status encode_8(char *en_char, EncodeInfo *encInfo);
 /* Encode an integer and write */
 Status encode_32(int *en_int, EncodeInfo *encInfo);
 
+/* Encode a 64-bit size and write */
+Status encode_64(unsigned long long value, EncodeInfo *encInfo);
+
+/* Finish a carrier byte left part-filled by encode_data */
+Status encode_flush(EncodeInfo *encInfo);
+
+/* Store extended header (only when a non-default feature is used) */
+Status encode_stego_header(EncodeInfo *encInfo);
+
 /* Store Magic String */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
 
@@ -73,12 +185,18 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
 Status encode_secret_file_extn(EncodeInfo *encInfo);
 
 /* Encode secret file size */
-Status encode_secret_file_size(long file_size, EncodeInfo *encInfo);
+Status encode_secret_file_size(size_t file_size, EncodeInfo *encInfo);
+
+/* Encode the CRC32C of the extended header fields (version 2 only) */
+Status encode_header_crc(EncodeInfo *encInfo);
 
 /* Encode secret file data*/
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
+/* Copy the carrier bytes after the payload (mapping or stdio) */
+Status copy_remaining_carrier(EncodeInfo *encInfo);
+
 /* Copy remaining image bytes from src to stego image after encoding */
-Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
+Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest, uchar *block, size_t size, StegoStats *stats);
 
 #endif
@@ -0,0 +1,855 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flate.h"
+#include "types.h"
+
+#define FLATE_MIN_MATCH 3
+#define FLATE_MAX_MATCH 258
+#define FLATE_HASH_BITS 15
+#define FLATE_CHAIN 32            // Earlier positions tried per match search
+#define FLATE_NICE 128            // Match length that ends the search at once
+#define FLATE_BLOCK_SYMBOLS 16384 // Literals and matches per block
+#define FLATE_STORED_MAX 65535    // Largest stored block
+#define FLATE_MAX_BITS 15         // Longest literal/length and distance code
+#define FLATE_MAX_CLEN_BITS 7     // Longest code length code
+#define ADLER_BASE 65521
+#define ADLER_NMAX 5552           // Bytes summed before the sums must be reduced
+
+static const unsigned short len_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                            31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uchar len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short dist_base[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                             193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uchar dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uchar clen_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/* Function Definitions */
+
+uint adler32(uint adler, const uchar *buf, size_t n)
+{
+    uint a = adler & 0xFFFF, b = adler >> 16;
+    while (n > 0)
+    {
+        size_t run = n < ADLER_NMAX ? n : ADLER_NMAX;
+        n -= run;
+        while (run--)
+        {
+            a += *buf++;
+            b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return (b << 16) | a;
+}
+
+static uint reverse_bits(uint code, uint len)
+{
+    // Huffman codes go into the stream most significant bit first
+    uint rev = 0;
+    while (len--)
+    {
+        rev = (rev << 1) | (code & 1);
+        code >>= 1;
+    }
+    return rev;
+}
+
+/* Inflate */
+
+typedef struct _Huffman
+{
+    unsigned short fast[1 << FLATE_FAST_BITS]; // symbol << 4 | length of codes up to FLATE_FAST_BITS (0: longer)
+    unsigned short count[FLATE_MAX_BITS + 1];  // Codes of each length
+    unsigned short symbol[288];                // Symbols in canonical order
+} Huffman;
+
+typedef struct _Inflate
+{
+    const uchar *src;
+    size_t n, pos;
+    unsigned long long bitbuf; // Bits not used yet, next bit lowest
+    uint bitcnt;
+    uchar *dst;
+    size_t cap, len;
+    int short_input; // Stream ended early
+    int full;        // dst is full
+} Inflate;
+
+static Status build_huffman(Huffman *h, const uchar *lengths, uint n)
+{
+    // Canonical codes from lengths; incomplete codes are allowed, oversubscribed ones are not
+    unsigned short offs[FLATE_MAX_BITS + 2];
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+    for (uint s = 0; s < n; s++)
+        h->count[lengths[s]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (uint len = 1; len <= FLATE_MAX_BITS; len++)
+    {
+        left = (left << 1) - h->count[len];
+        if (left < 0)
+            return e_failure;
+    }
+
+    offs[1] = 0;
+    for (uint len = 1; len <= FLATE_MAX_BITS; len++)
+        offs[len + 1] = offs[len] + h->count[len];
+    for (uint s = 0; s < n; s++)
+        if (lengths[s] != 0)
+            h->symbol[offs[lengths[s]]++] = s;
+
+    // Short codes resolve with one lookup of the next FLATE_FAST_BITS bits
+    uint code = 0, k = 0;
+    for (uint len = 1; len <= FLATE_MAX_BITS; len++)
+    {
+        for (uint i = 0; i < h->count[len]; i++, code++, k++)
+        {
+            if (len > FLATE_FAST_BITS)
+                continue;
+            for (uint j = reverse_bits(code, len); j < (1u << FLATE_FAST_BITS); j += 1u << len)
+                h->fast[j] = (h->symbol[k] << 4) | len;
+        }
+        code <<= 1;
+    }
+    return e_success;
+}
+
+static void refill(Inflate *s)
+{
+    while (s->bitcnt <= 56 && s->pos < s->n)
+    {
+        s->bitbuf |= (unsigned long long)s->src[s->pos++] << s->bitcnt;
+        s->bitcnt += 8;
+    }
+}
+
+static Status get_bits(Inflate *s, uint need, uint *value)
+{
+    if (s->bitcnt < need)
+    {
+        refill(s);
+        if (s->bitcnt < need)
+        {
+            s->short_input = 1;
+            return e_failure;
+        }
+    }
+    *value = need == 0 ? 0 : (uint)(s->bitbuf & ((1ull << need) - 1));
+    s->bitbuf >>= need;
+    s->bitcnt -= need;
+    return e_success;
+}
+
+static Status decode_symbol(Inflate *s, const Huffman *h, uint *symbol)
+{
+    if (s->bitcnt < FLATE_MAX_BITS)
+        refill(s);
+
+    uint entry = h->fast[s->bitbuf & ((1u << FLATE_FAST_BITS) - 1)];
+    if (entry != 0 && (entry & 15) <= s->bitcnt)
+    {
+        s->bitbuf >>= entry & 15;
+        s->bitcnt -= entry & 15;
+        *symbol = entry >> 4;
+        return e_success;
+    }
+
+    // Longer code: walk the canonical code one bit at a time
+    int code = 0, first = 0, index = 0;
+    for (uint len = 1; len <= FLATE_MAX_BITS; len++)
+    {
+        if (s->bitcnt == 0)
+        {
+            s->short_input = 1;
+            return e_failure;
+        }
+        code |= s->bitbuf & 1;
+        s->bitbuf >>= 1;
+        s->bitcnt--;
+        int count = h->count[len];
+        if (code - count < first)
+        {
+            *symbol = h->symbol[index + (code - first)];
+            return e_success;
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return e_failure; // No such code
+}
+
+static Status inflate_stored(Inflate *s)
+{
+    // Drop to the byte boundary, then hand the unused whole bytes back to the input
+    uint skip = s->bitcnt & 7;
+    s->bitbuf >>= skip;
+    s->bitcnt -= skip;
+    uint len, nlen;
+    if (get_bits(s, 16, &len) != e_success || get_bits(s, 16, &nlen) != e_success)
+        return e_failure;
+    if (len != (~nlen & 0xFFFF))
+        return e_failure;
+    s->pos -= s->bitcnt / 8;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+
+    size_t n = len;
+    if (n > s->n - s->pos)
+    {
+        n = s->n - s->pos;
+        s->short_input = 1;
+    }
+    if (n > s->cap - s->len)
+    {
+        n = s->cap - s->len;
+        s->full = 1;
+    }
+    memcpy(s->dst + s->len, s->src + s->pos, n);
+    s->pos += n;
+    s->len += n;
+    return s->short_input || s->full ? e_failure : e_success;
+}
+
+static Status inflate_codes(Inflate *s, const Huffman *lit, const Huffman *dist)
+{
+    for (;;)
+    {
+        uint symbol;
+        if (decode_symbol(s, lit, &symbol) != e_success)
+            return e_failure;
+
+        if (symbol < 256)
+        {
+            if (s->len == s->cap)
+            {
+                s->full = 1;
+                return e_failure;
+            }
+            s->dst[s->len++] = symbol;
+            continue;
+        }
+        if (symbol == 256)
+            return e_success;
+
+        symbol -= 257;
+        uint extra, dsym, dextra;
+        if (symbol >= 29 || get_bits(s, len_extra[symbol], &extra) != e_success)
+            return e_failure;
+        size_t len = len_base[symbol] + extra;
+        if (decode_symbol(s, dist, &dsym) != e_success || dsym >= 30 || get_bits(s, dist_extra[dsym], &dextra) != e_success)
+            return e_failure;
+        size_t distance = dist_base[dsym] + dextra;
+        if (distance > s->len)
+            return e_failure;
+
+        if (len > s->cap - s->len)
+        {
+            len = s->cap - s->len;
+            s->full = 1;
+        }
+
+        // Byte by byte: the match may overlap the bytes it produces
+        uchar *op = s->dst + s->len;
+        const uchar *ref = op - distance;
+        s->len += len;
+        while (len--)
+            *op++ = *ref++;
+        if (s->full)
+            return e_failure;
+    }
+}
+
+static void fixed_lengths(uchar *lit, uchar *dist)
+{
+    memset(lit, 8, 144);
+    memset(lit + 144, 9, 112);
+    memset(lit + 256, 7, 24);
+    memset(lit + 280, 8, 8);
+    memset(dist, 5, 30);
+}
+
+static Status inflate_dynamic(Inflate *s, Huffman *lit, Huffman *dist)
+{
+    uint hlit, hdist, hclen;
+    uchar lengths[320];
+    if (get_bits(s, 5, &hlit) != e_success || get_bits(s, 5, &hdist) != e_success || get_bits(s, 4, &hclen) != e_success)
+        return e_failure;
+    hlit += 257;
+    hdist += 1;
+    hclen += 4;
+    if (hlit > 286 || hdist > 30)
+        return e_failure;
+
+    // Code length code, then the run-length coded lengths of both codes
+    memset(lengths, 0, 19);
+    for (uint i = 0; i < hclen; i++)
+    {
+        uint len;
+        if (get_bits(s, 3, &len) != e_success)
+            return e_failure;
+        lengths[clen_order[i]] = len;
+    }
+    if (build_huffman(lit, lengths, 19) != e_success)
+        return e_failure;
+
+    for (uint i = 0; i < hlit + hdist;)
+    {
+        uint symbol, repeat, value = 0;
+        if (decode_symbol(s, lit, &symbol) != e_success)
+            return e_failure;
+        if (symbol < 16)
+        {
+            lengths[i++] = symbol;
+            continue;
+        }
+
+        if (symbol == 16)
+        {
+            if (i == 0 || get_bits(s, 2, &repeat) != e_success)
+                return e_failure;
+            value = lengths[i - 1];
+            repeat += 3;
+        }
+        else if (symbol == 17)
+        {
+            if (get_bits(s, 3, &repeat) != e_success)
+                return e_failure;
+            repeat += 3;
+        }
+        else
+        {
+            if (get_bits(s, 7, &repeat) != e_success)
+                return e_failure;
+            repeat += 11;
+        }
+        if (i + repeat > hlit + hdist)
+            return e_failure;
+        while (repeat--)
+            lengths[i++] = value;
+    }
+
+    if (lengths[256] == 0 || build_huffman(lit, lengths, hlit) != e_success ||
+        build_huffman(dist, lengths + hlit, hdist) != e_success)
+        return e_failure;
+    return e_success;
+}
+
+Status flate_decompress(const uchar *src, size_t n, uchar *dst, size_t cap, size_t *out_len, int partial)
+{
+    Inflate s;
+    memset(&s, 0, sizeof(s));
+    s.src = src;
+    s.n = n;
+    s.dst = dst;
+    s.cap = cap;
+    *out_len = 0;
+
+    // zlib header: deflate with a window of at most 32 KB, no preset dictionary
+    if (n < 2 || (src[0] & 0x0F) != 8 || (src[0] >> 4) > 7 || ((src[0] << 8) | src[1]) % 31 != 0 || (src[1] & 0x20))
+        return e_failure;
+    s.pos = 2;
+
+    Huffman *tables = malloc(2 * sizeof(Huffman));
+    if (tables == NULL)
+        return e_failure;
+
+    Status status = e_success;
+    uint final = 0, type;
+    while (status == e_success && !final)
+    {
+        if (get_bits(&s, 1, &final) != e_success || get_bits(&s, 2, &type) != e_success)
+        {
+            status = e_failure;
+        }
+        else if (type == 0)
+        {
+            status = inflate_stored(&s);
+        }
+        else if (type == 1)
+        {
+            uchar lit[288], dist[30];
+            fixed_lengths(lit, dist);
+            build_huffman(&tables[0], lit, 288);
+            build_huffman(&tables[1], dist, 30);
+            status = inflate_codes(&s, &tables[0], &tables[1]);
+        }
+        else if (type == 2)
+        {
+            status = inflate_dynamic(&s, &tables[0], &tables[1]);
+            if (status == e_success)
+                status = inflate_codes(&s, &tables[0], &tables[1]);
+        }
+        else
+        {
+            status = e_failure;
+        }
+    }
+    free(tables);
+    *out_len = s.len;
+
+    if (status != e_success)
+        return partial && (s.short_input || s.full) ? e_success : e_failure;
+    if (partial)
+        return e_success;
+
+    // Adler-32 of the output follows at the next byte boundary
+    uint skip = s.bitcnt & 7, hi, lo;
+    s.bitbuf >>= skip;
+    s.bitcnt -= skip;
+    if (get_bits(&s, 16, &hi) != e_success || get_bits(&s, 16, &lo) != e_success)
+        return e_failure;
+    uint stored = ((hi & 0xFF) << 24) | ((hi >> 8) << 16) | ((lo & 0xFF) << 8) | (lo >> 8);
+    return stored == adler32(1, dst, s.len) ? e_success : e_failure;
+}
+
+/* Deflate */
+
+typedef struct _Deflate
+{
+    uchar *out;
+    size_t pos;
+    unsigned long long bitbuf;
+    uint bitcnt;
+
+    size_t head[1 << FLATE_HASH_BITS]; // Last position + 1 with each hash (0: none)
+    size_t prev[FLATE_WINDOW];         // Earlier position + 1 with the same hash, by position % FLATE_WINDOW
+
+    unsigned short lits[FLATE_BLOCK_SYMBOLS];  // Literal byte or match length
+    unsigned short dists[FLATE_BLOCK_SYMBOLS]; // Match distance (0: literal)
+    uint nsyms;
+
+    uchar len_code[FLATE_MAX_MATCH + 1]; // Length symbol - 257 of each match length
+    uchar dist_code[512];                // Distance symbol of distance - 1 (< 256) or 256 + ((distance - 1) >> 7)
+} Deflate;
+
+typedef struct _Code
+{
+    uint freq[286];
+    uchar len[286];
+    unsigned short code[286]; // Bit-reversed, ready to write
+} Code;
+
+static void put_bits(Deflate *d, uint value, uint nbits)
+{
+    d->bitbuf |= (unsigned long long)value << d->bitcnt;
+    d->bitcnt += nbits;
+    while (d->bitcnt >= 8)
+    {
+        d->out[d->pos++] = d->bitbuf;
+        d->bitbuf >>= 8;
+        d->bitcnt -= 8;
+    }
+}
+
+static void align_bits(Deflate *d)
+{
+    if (d->bitcnt > 0)
+        put_bits(d, 0, 8 - d->bitcnt);
+}
+
+static uint hash3(const uchar *p)
+{
+    uint v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761u) >> (32 - FLATE_HASH_BITS);
+}
+
+static uint dist_symbol(const Deflate *d, uint distance)
+{
+    return distance <= 256 ? d->dist_code[distance - 1] : d->dist_code[256 + ((distance - 1) >> 7)];
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void build_lengths(Code *c, uint n, uint limit)
+{
+    // Huffman code lengths for n symbols, at most limit bits; always at least two codes so every decoder accepts them
+    unsigned long long leaves[286];
+    uint weight[2 * 286], parent[2 * 286], depth[2 * 286];
+    uint freq[286];
+    memcpy(freq, c->freq, n * sizeof(uint));
+
+    uint used = 0;
+    for (uint s = 0; s < n; s++)
+        used += freq[s] != 0;
+    for (uint s = 0; s < n && used < 2; s++)
+    {
+        if (freq[s] == 0)
+        {
+            freq[s] = 1;
+            used++;
+        }
+    }
+
+    for (;;)
+    {
+        uint m = 0;
+        for (uint s = 0; s < n; s++)
+            if (freq[s] != 0)
+                leaves[m++] = ((unsigned long long)freq[s] << 9) | s;
+        qsort(leaves, m, sizeof(leaves[0]), compare_u64);
+
+        // Two queues: leaves by weight, then merged nodes in the (non-decreasing) order they are made
+        uint next_leaf = 0, next_node = m, nodes = m;
+        for (uint i = 0; i < m; i++)
+            weight[i] = leaves[i] >> 9;
+        while (nodes < 2 * m - 1)
+        {
+            uint pick[2];
+            for (int k = 0; k < 2; k++)
+            {
+                if (next_leaf < m && (next_node == nodes || weight[next_leaf] <= weight[next_node]))
+                    pick[k] = next_leaf++;
+                else
+                    pick[k] = next_node++;
+            }
+            weight[nodes] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = nodes;
+            nodes++;
+        }
+
+        uint max = 0;
+        depth[nodes - 1] = 0;
+        for (int i = (int)nodes - 2; i >= 0; i--)
+        {
+            depth[i] = depth[parent[i]] + 1;
+            if (depth[i] > max)
+                max = depth[i];
+        }
+
+        if (max <= limit)
+        {
+            memset(c->len, 0, n);
+            for (uint i = 0; i < m; i++)
+                c->len[leaves[i] & 511] = depth[i];
+            break;
+        }
+
+        // Too deep: flatten the weights and build again
+        for (uint s = 0; s < n; s++)
+            if (freq[s] != 0)
+                freq[s] = (freq[s] + 1) / 2;
+    }
+
+    // Canonical codes, bit-reversed for writing
+    uint count[FLATE_MAX_BITS + 1] = {0}, next[FLATE_MAX_BITS + 1];
+    for (uint s = 0; s < n; s++)
+        count[c->len[s]]++;
+    count[0] = 0;
+    uint code = 0;
+    for (uint len = 1; len <= FLATE_MAX_BITS; len++)
+    {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (uint s = 0; s < n; s++)
+        if (c->len[s] != 0)
+            c->code[s] = reverse_bits(next[c->len[s]]++, c->len[s]);
+}
+
+static void fixed_code(Code *lit, Code *dist)
+{
+    uchar lit_len[288], dist_len[30];
+    fixed_lengths(lit_len, dist_len);
+    memcpy(lit->len, lit_len, 286);
+    memcpy(dist->len, dist_len, 30);
+
+    uint code = 0;
+    for (uint len = 7; len <= 9; len++)
+    {
+        for (uint s = 0; s < 286; s++)
+            if (lit->len[s] == len)
+                lit->code[s] = reverse_bits(code++, len);
+        code <<= 1;
+    }
+    for (uint s = 0; s < 30; s++)
+        dist->code[s] = reverse_bits(s, 5);
+}
+
+static size_t code_bits(const Code *lit, const Code *dist)
+{
+    // Bits the block's symbols take with these codes (literal/length and distance extra bits included)
+    size_t bits = 0;
+    for (uint s = 0; s < 286; s++)
+        bits += (size_t)lit->freq[s] * (lit->len[s] + (s > 256 ? len_extra[s - 257] : 0));
+    for (uint s = 0; s < 30; s++)
+        bits += (size_t)dist->freq[s] * (dist->len[s] + dist_extra[s]);
+    return bits;
+}
+
+static uint run_lengths(const uchar *lengths, uint n, unsigned short *runs)
+{
+    // Code length alphabet: a length, 16 (repeat last 3-6), 17 (3-10 zeros), 18 (11-138 zeros); extra bits above bit 5
+    uint count = 0;
+    for (uint i = 0; i < n;)
+    {
+        uint len = lengths[i], run = 1;
+        while (i + run < n && lengths[i + run] == len)
+            run++;
+        i += run;
+
+        if (len == 0)
+        {
+            while (run >= 11)
+            {
+                uint take = run < 138 ? run : 138;
+                runs[count++] = 18 | ((take - 11) << 5);
+                run -= take;
+            }
+            if (run >= 3)
+            {
+                runs[count++] = 17 | ((run - 3) << 5);
+                run = 0;
+            }
+        }
+        else
+        {
+            runs[count++] = len;
+            run--;
+            while (run >= 3)
+            {
+                uint take = run < 6 ? run : 6;
+                runs[count++] = 16 | ((take - 3) << 5);
+                run -= take;
+            }
+        }
+        while (run--)
+            runs[count++] = len;
+    }
+    return count;
+}
+
+static void write_symbols(Deflate *d, const Code *lit, const Code *dist)
+{
+    for (uint i = 0; i < d->nsyms; i++)
+    {
+        uint value = d->lits[i], distance = d->dists[i];
+        if (distance == 0)
+        {
+            put_bits(d, lit->code[value], lit->len[value]);
+            continue;
+        }
+
+        uint ls = d->len_code[value];
+        put_bits(d, lit->code[257 + ls], lit->len[257 + ls]);
+        put_bits(d, value - len_base[ls], len_extra[ls]);
+        uint ds = dist_symbol(d, distance);
+        put_bits(d, dist->code[ds], dist->len[ds]);
+        put_bits(d, distance - dist_base[ds], dist_extra[ds]);
+    }
+    put_bits(d, lit->code[256], lit->len[256]);
+}
+
+static void write_stored(Deflate *d, const uchar *src, size_t n, int final)
+{
+    // Stored blocks of at most FLATE_STORED_MAX bytes (one empty block for no bytes)
+    do
+    {
+        size_t take = n < FLATE_STORED_MAX ? n : FLATE_STORED_MAX;
+        put_bits(d, final && take == n, 3);
+        align_bits(d);
+        put_bits(d, take & 0xFFFF, 16);
+        put_bits(d, ~take & 0xFFFF, 16);
+        memcpy(d->out + d->pos, src, take);
+        d->pos += take;
+        src += take;
+        n -= take;
+    } while (n > 0);
+}
+
+static void flush_block(Deflate *d, const uchar *src, size_t n, int final)
+{
+    // Symbols of the block, then whichever of dynamic, fixed or stored codes is smallest
+    Code lit, dist, clen;
+    memset(lit.freq, 0, sizeof(lit.freq));
+    memset(dist.freq, 0, sizeof(dist.freq));
+    memset(clen.freq, 0, sizeof(clen.freq));
+    for (uint i = 0; i < d->nsyms; i++)
+    {
+        if (d->dists[i] == 0)
+        {
+            lit.freq[d->lits[i]]++;
+        }
+        else
+        {
+            lit.freq[257 + d->len_code[d->lits[i]]]++;
+            dist.freq[dist_symbol(d, d->dists[i])]++;
+        }
+    }
+    lit.freq[256] = 1;
+
+    build_lengths(&lit, 286, FLATE_MAX_BITS);
+    build_lengths(&dist, 30, FLATE_MAX_BITS);
+
+    uint hlit = 286, hdist = 30;
+    while (hlit > 257 && lit.len[hlit - 1] == 0)
+        hlit--;
+    while (hdist > 1 && dist.len[hdist - 1] == 0)
+        hdist--;
+
+    uchar lengths[286 + 30];
+    unsigned short runs[286 + 30];
+    memcpy(lengths, lit.len, hlit);
+    memcpy(lengths + hlit, dist.len, hdist);
+    uint nruns = run_lengths(lengths, hlit + hdist, runs);
+    for (uint i = 0; i < nruns; i++)
+        clen.freq[runs[i] & 31]++;
+    build_lengths(&clen, 19, FLATE_MAX_CLEN_BITS);
+
+    uint hclen = 19;
+    while (hclen > 4 && clen.len[clen_order[hclen - 1]] == 0)
+        hclen--;
+
+    size_t dynamic = 3 + 14 + 3 * hclen + code_bits(&lit, &dist);
+    for (uint s = 0; s < 19; s++)
+        dynamic += (size_t)clen.freq[s] * (clen.len[s] + (s == 16 ? 2 : s == 17 ? 3 : s == 18 ? 7 : 0));
+
+    Code fixed_lit, fixed_dist;
+    memcpy(fixed_lit.freq, lit.freq, sizeof(lit.freq));
+    memcpy(fixed_dist.freq, dist.freq, sizeof(dist.freq));
+    fixed_code(&fixed_lit, &fixed_dist);
+    size_t fixed = 3 + code_bits(&fixed_lit, &fixed_dist);
+
+    size_t stored = (n + 5 * (n / FLATE_STORED_MAX + 1)) * 8 + 7;
+
+    if (stored <= dynamic && stored <= fixed)
+    {
+        write_stored(d, src, n, final);
+    }
+    else if (fixed <= dynamic)
+    {
+        put_bits(d, final | (1 << 1), 3);
+        write_symbols(d, &fixed_lit, &fixed_dist);
+    }
+    else
+    {
+        put_bits(d, final | (2 << 1), 3);
+        put_bits(d, hlit - 257, 5);
+        put_bits(d, hdist - 1, 5);
+        put_bits(d, hclen - 4, 4);
+        for (uint i = 0; i < hclen; i++)
+            put_bits(d, clen.len[clen_order[i]], 3);
+        for (uint i = 0; i < nruns; i++)
+        {
+            uint s = runs[i] & 31, extra = runs[i] >> 5;
+            put_bits(d, clen.code[s], clen.len[s]);
+            if (s >= 16)
+                put_bits(d, extra, s == 16 ? 2 : s == 17 ? 3 : 7);
+        }
+        write_symbols(d, &lit, &dist);
+    }
+    d->nsyms = 0;
+}
+
+static void init_tables(Deflate *d)
+{
+    for (uint s = 0; s < 29; s++)
+    {
+        uint span = 1u << len_extra[s];
+        for (uint i = 0; i < span && len_base[s] + i <= FLATE_MAX_MATCH; i++)
+            d->len_code[len_base[s] + i] = s;
+    }
+    d->len_code[FLATE_MAX_MATCH] = 28; // 258 has a symbol of its own (227 + 31 would also reach it)
+
+    for (uint s = 0; s < 30; s++)
+    {
+        uint span = 1u << dist_extra[s];
+        for (uint i = 0; i < span; i++)
+        {
+            uint distance = dist_base[s] + i;
+            d->dist_code[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)] = s;
+        }
+    }
+}
+
+size_t flate_compress(const uchar *src, size_t n, uchar *dst)
+{
+    Deflate *d = calloc(1, sizeof(Deflate));
+    if (d == NULL)
+        return 0;
+    d->out = dst;
+    init_tables(d);
+
+    // zlib header: deflate, 32 KB window, default level
+    d->out[d->pos++] = 0x78;
+    d->out[d->pos++] = 0x9C;
+
+    // Greedy parse: the longest match among the last FLATE_CHAIN positions with the same 3-byte hash
+    size_t pos = 0, block_start = 0;
+    while (pos < n)
+    {
+        size_t best_len = 0, best_dist = 0;
+        if (pos + FLATE_MIN_MATCH <= n)
+        {
+            size_t limit = n - pos < FLATE_MAX_MATCH ? n - pos : FLATE_MAX_MATCH;
+            uint h = hash3(src + pos);
+            size_t cand = d->head[h];
+            for (int chain = FLATE_CHAIN; cand != 0 && chain > 0; chain--)
+            {
+                size_t ref = cand - 1;
+                if (pos - ref > FLATE_WINDOW)
+                    break;
+                if (src[ref + best_len] == src[pos + best_len] || best_len == 0)
+                {
+                    size_t len = 0;
+                    while (len < limit && src[ref + len] == src[pos + len])
+                        len++;
+                    if (len > best_len)
+                    {
+                        best_len = len;
+                        best_dist = pos - ref;
+                        if (len >= FLATE_NICE || len == limit)
+                            break;
+                    }
+                }
+                cand = d->prev[ref % FLATE_WINDOW];
+            }
+            d->prev[pos % FLATE_WINDOW] = d->head[h];
+            d->head[h] = pos + 1;
+        }
+
+        if (best_len >= FLATE_MIN_MATCH)
+        {
+            d->lits[d->nsyms] = best_len;
+            d->dists[d->nsyms++] = best_dist;
+            for (size_t i = 1; i < best_len && pos + i + FLATE_MIN_MATCH <= n; i++)
+            {
+                uint h = hash3(src + pos + i);
+                d->prev[(pos + i) % FLATE_WINDOW] = d->head[h];
+                d->head[h] = pos + i + 1;
+            }
+            pos += best_len;
+        }
+        else
+        {
+            d->lits[d->nsyms] = src[pos];
+            d->dists[d->nsyms++] = 0;
+            pos++;
+        }
+
+        if (d->nsyms == FLATE_BLOCK_SYMBOLS)
+        {
+            flush_block(d, src + block_start, pos - block_start, 0);
+            block_start = pos;
+        }
+    }
+    flush_block(d, src + block_start, pos - block_start, 1);
+    align_bits(d);
+
+    uint adler = adler32(1, src, n);
+    d->out[d->pos++] = adler >> 24;
+    d->out[d->pos++] = adler >> 16;
+    d->out[d->pos++] = adler >> 8;
+    d->out[d->pos++] = adler;
+
+    size_t len = d->pos;
+    free(d);
+    return len;
+}
@@ -0,0 +1,38 @@
+#ifndef FLATE_H
+#define FLATE_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * In-tree zlib stream codec (RFC 1950/1951) for PNG carriers, so no
+ * outside library is needed.
+ *
+ * Inflate handles stored, fixed and dynamic Huffman blocks, decoding
+ * codes up to FLATE_FAST_BITS long with one table lookup. Deflate is
+ * greedy LZ77 over hash chains; every block gets its own dynamic
+ * Huffman codes and is stored instead when that is smaller, so the
+ * output never grows past FLATE_BOUND.
+ */
+
+#define FLATE_WINDOW 32768 // Largest match distance
+#define FLATE_FAST_BITS 10 // Code lengths resolved by a single table lookup
+
+/* Worst case zlib stream size of n bytes: stored blocks, header and Adler-32 */
+#define FLATE_BOUND(n) ((n) + ((n) / 8192 + 2) * 6 + 16)
+
+/* Adler-32 of n bytes, continuing from adler (1 to start) */
+uint adler32(uint adler, const uchar *buf, size_t n);
+
+/* Compress n bytes into a zlib stream in dst (FLATE_BOUND(n) bytes); returns the stream size */
+size_t flate_compress(const uchar *src, size_t n, uchar *dst);
+
+/*
+ * Decompress the zlib stream of n bytes into dst (cap bytes); *out_len
+ * gets the bytes produced. With partial set, running out of input or of
+ * room is not an error: the bytes produced so far are kept (header
+ * peeks of the start of an image).
+ */
+Status flate_decompress(const uchar *src, size_t n, uchar *dst, size_t cap, size_t *out_len, int partial);
+
+#endif
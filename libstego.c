@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <string.h>
+#include "libstego.h"
+#include "aead.h"
+#include "bmp.h"
+#include "carrier.h"
+#include "decode.h"
+#include "encode.h"
+#include "lz.h"
+#include "types.h"
+
+/* Function Definitions */
+
+void stego_default_params(StegoParams *params)
+{
+    params->depth = 1;
+    params->codec = STEGO_CODEC_NONE;
+    params->checksum = 1;
+    params->threads = 1;
+    params->scatter = 0;
+    params->key = NULL;
+    params->aead_key = NULL;
+    params->shard = NULL;
+    params->stats = NULL;
+}
+
+size_t stego_scratch_size(size_t payload_len, const StegoParams *params)
+{
+    // Packed copy of the payload and the packer's table (with a codec), then the chunk being sealed (with a key)
+    size_t packed = params->codec == STEGO_CODEC_NONE ? 0 : ARENA_BYTES(LZ_PACK_BOUND(payload_len)) + ARENA_BYTES(LZ_TABLE_BYTES);
+    size_t sealed = params->aead_key != NULL ? ARENA_BYTES(AEAD_CHUNK) : 0;
+    return packed + sealed > 0 ? packed + sealed + ARENA_ALIGN : 0; // Plus the bytes lost to aligning them
+}
+
+size_t stego_work_size(void)
+{
+    // Payload chunk, packed block and opened chunk, plus the bytes lost to aligning them
+    return DECODE_LIB_ARENA_BYTES + ARENA_ALIGN;
+}
+
+static Status copy_name(char *dest, size_t size, const char *src)
+{
+    // Names must fit the fixed-size Info fields
+    if (src == NULL || strlen(src) >= size)
+        return e_failure;
+    strcpy(dest, src);
+    return e_success;
+}
+
+const char *stego_carrier_error(const uchar *carrier, size_t carrier_len)
+{
+    BmpInfo layout;
+    const char *error = check_carrier_header(carrier, carrier_len, &layout);
+    if (error != NULL)
+        return error;
+
+    // An encoded image cannot be stored into a buffer sized like the carrier
+    if (carrier_encoded(&layout))
+        return "Encoded carriers (PNG) need the file calls (stego_encode_file).";
+    if (layout.image_end > carrier_len)
+        return "Truncated image.";
+    return NULL;
+}
+
+Status stego_embed(const uchar *carrier, size_t carrier_len, const uchar *payload, size_t payload_len,
+                   const char *magic, const char *extn, const StegoParams *params,
+                   uchar *stego, size_t stego_len, uchar *scratch, size_t scratch_len)
+{
+    EncodeInfo encInfo;
+    memset(&encInfo, 0, sizeof(encInfo));
+
+    if (copy_name(encInfo.usr_migc_str, sizeof(encInfo.usr_migc_str), magic) != e_success ||
+        copy_name(encInfo.extn_secret_file, sizeof(encInfo.extn_secret_file), extn) != e_success ||
+        stego_len < carrier_len || payload_len >= FRAMED_SIZE)
+        return e_failure;
+
+    // Rejected carriers fail quietly; stego_carrier_error says why
+    if (probe_carrier_header(carrier, carrier_len, &encInfo.bmp) != e_success || carrier_encoded(&encInfo.bmp) ||
+        encInfo.bmp.image_end > carrier_len)
+        return e_failure;
+
+    // Carrier and stego buffers take the place of the file mappings
+    encInfo.size_usr_migc_str = strlen(magic);
+    encInfo.size_extn_secret_file = strlen(extn);
+    encInfo.src_map = carrier;
+    encInfo.stego_map = stego;
+    encInfo.map_size = carrier_len;
+    encInfo.image_capacity = get_image_size_for_bmp(&encInfo.bmp);
+    encInfo.size_secret_file = payload_len;
+    encInfo.secret_mem = payload;
+    encInfo.depth = params->depth;
+    encInfo.codec = params->codec;
+    encInfo.checksum = params->checksum;
+    encInfo.threads = params->threads;
+    encInfo.scatter = params->scatter;
+    encInfo.key = params->key;
+    encInfo.aead_key = params->aead_key;
+    encInfo.shard = params->shard;
+    encInfo.stats = params->stats;
+    encInfo.quiet = 1; // Library calls report through their status only
+
+    if ((encInfo.codec != STEGO_CODEC_NONE || encInfo.aead_key != NULL) &&
+        (scratch == NULL || scratch_len < stego_scratch_size(payload_len, params)))
+        return e_failure;
+
+    // The scratch buffers are carved from the caller's block
+    StegoArena arena;
+    arena_init(&arena, scratch, scratch_len);
+    uchar *packed_copy = encInfo.codec != STEGO_CODEC_NONE ? arena_alloc(&arena, LZ_PACK_BOUND(payload_len)) : NULL;
+    uint *table = encInfo.codec != STEGO_CODEC_NONE ? arena_alloc(&arena, LZ_TABLE_BYTES) : NULL;
+    if (encInfo.aead_key != NULL)
+        encInfo.aead.buf = arena_alloc(&arena, AEAD_CHUNK);
+
+    // Pack into the caller's scratch space; keep the payload raw if that does not help
+    if (encInfo.codec != STEGO_CODEC_NONE)
+    {
+        size_t packed = lz_pack(payload, payload_len, packed_copy, table);
+        if (packed < payload_len)
+        {
+            encInfo.secret_mem = packed_copy;
+            encInfo.size_raw_secret = payload_len;
+            encInfo.size_secret_file = packed;
+        }
+        else
+        {
+            encInfo.codec = STEGO_CODEC_NONE;
+        }
+    }
+
+    if (check_capacity(&encInfo) != e_success)
+        return e_failure;
+
+    return do_encoding(&encInfo);
+}
+
+static Status init_decode(DecodeInfo *decInfo, const uchar *stego, size_t stego_len, const char *magic, const StegoParams *params)
+{
+    memset(decInfo, 0, sizeof(DecodeInfo));
+    if (copy_name(decInfo->usr_migc_str, sizeof(decInfo->usr_migc_str), magic) != e_success)
+        return e_failure;
+
+    // The stego buffer takes the place of the input mapping
+    decInfo->size_usr_migc_str = strlen(magic);
+    decInfo->inp_map = stego;
+    decInfo->map_size = stego_len;
+    decInfo->threads = params ? params->threads : 1;
+    decInfo->key = params ? params->key : NULL;
+    decInfo->aead_key = params ? params->aead_key : NULL;
+    decInfo->stats = params ? params->stats : NULL;
+    return e_success;
+}
+
+static void fill_info(const DecodeInfo *decInfo, StegoPayloadInfo *info)
+{
+    int framed = decInfo->size_out_file == FRAMED_OUT_SIZE;
+    info->size = framed ? STEGO_SIZE_UNKNOWN : (size_t)decInfo->size_raw_out_file;
+    info->stored_size = framed ? STEGO_SIZE_UNKNOWN : (size_t)decInfo->size_out_file;
+    info->depth = decInfo->depth;
+    info->codec = decInfo->codec;
+    info->checksum = decInfo->checksum;
+    info->scatter = decInfo->scatter;
+    info->sealed = decInfo->sealed;
+    info->shard = decInfo->shard;
+    snprintf(info->extn, sizeof(info->extn), "%s", decInfo->extn_out_file);
+}
+
+Status stego_peek(const uchar *stego, size_t stego_len, const char *magic, StegoPayloadInfo *info)
+{
+    DecodeInfo decInfo;
+
+    if (init_decode(&decInfo, stego, stego_len, magic, NULL) != e_success)
+        return e_failure;
+
+    // Only the header is read, so the start of the image is enough; nothing is printed
+    decInfo.header_only = 1;
+    decInfo.quiet = 1;
+    Status status = decode_stego_header(&decInfo);
+    release_stego_pixels(&decInfo);
+    if (status != e_success)
+        return e_failure;
+
+    fill_info(&decInfo, info);
+    return e_success;
+}
+
+Status stego_extract(const uchar *stego, size_t stego_len, const char *magic, const StegoParams *params,
+                     uchar *out, size_t out_cap, size_t *out_len, StegoPayloadInfo *info, uchar *work, size_t work_len)
+{
+    DecodeInfo decInfo;
+
+    if (work == NULL || work_len < stego_work_size() || init_decode(&decInfo, stego, stego_len, magic, params) != e_success)
+        return e_failure;
+
+    // No output file: the secret is collected in out; the work buffers are carved from the caller's block
+    decInfo.quiet = 1; // Library calls report through their status only
+    arena_init(&decInfo.arena, work, work_len);
+    decInfo.out_mem = out;
+    decInfo.out_cap = out ? out_cap : 0;
+    Status status = alloc_decode_buffers(&decInfo);
+    if (status == e_success)
+        status = decode_secret(&decInfo);
+    release_stego_pixels(&decInfo);
+    if (status != e_success)
+        return e_failure;
+
+    *out_len = decInfo.out_len;
+    if (info != NULL)
+        fill_info(&decInfo, info);
+    return e_success;
+}
+
+Status stego_encode_file(const char *carrier, const char *secret, const char *output, const char *magic,
+                         const StegoParams *params)
+{
+    EncodeInfo encInfo;
+    memset(&encInfo, 0, sizeof(encInfo));
+
+    // Paths are used where they are; only the magic string has a size limit
+    if (copy_name(encInfo.usr_migc_str, sizeof(encInfo.usr_migc_str), magic) != e_success)
+        return e_failure;
+    encInfo.src_image_fname = carrier;
+    encInfo.secret_fname = secret;
+    encInfo.stego_image_fname = output;
+
+    encInfo.depth = params->depth;
+    encInfo.codec = params->codec;
+    encInfo.checksum = params->checksum;
+    encInfo.threads = params->threads;
+    encInfo.scatter = params->scatter;
+    encInfo.key = params->key;
+    encInfo.aead_key = params->aead_key;
+    encInfo.stats = params->stats;
+    Status status = run_encode(&encInfo); // Open, check capacity and encode
+    arena_free(&encInfo.arena);
+    return status;
+}
+
+Status stego_decode_file(const char *image, const char *out_name, const char *magic, const StegoParams *params)
+{
+    DecodeInfo decInfo;
+    memset(&decInfo, 0, sizeof(decInfo));
+
+    if (copy_name(decInfo.usr_migc_str, sizeof(decInfo.usr_migc_str), magic) != e_success)
+        return e_failure;
+    decInfo.inp_image_fname = image;
+    decInfo.out_fname = out_name;
+
+    decInfo.threads = params->threads;
+    decInfo.key = params->key;
+    decInfo.aead_key = params->aead_key;
+    decInfo.stats = params->stats;
+    Status status = run_decode(&decInfo); // Open and decode
+    arena_free(&decInfo.arena);
+    return status;
+}
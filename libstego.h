@@ -0,0 +1,93 @@
+#ifndef LIBSTEGO_H
+#define LIBSTEGO_H
+
+#include <stddef.h>
+#include "stats.h"
+#include "stego_header.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * libstego: encode and decode on caller-owned memory.
+ *
+ * The buffer calls never allocate (except to decode the pixels of a
+ * PNG stego image) and keep no state between calls, so any number of
+ * threads can run them at once on separate buffers. They print
+ * nothing; stego_carrier_error says why a carrier is turned away.
+ * Scratch space (only needed with a codec or a key) and the work
+ * buffers of an extraction are passed in by the caller; see
+ * stego_scratch_size and stego_work_size. Nothing large goes on the
+ * stack, so the calls are safe on small thread stacks. With params->threads > 1 large
+ * payloads are split across short-lived threads.
+ *
+ * The file calls wrap the same engine for the command line: regular
+ * files are mapped, pipes and "-" are streamed.
+ */
+
+#define STEGO_MAX_MAGIC 9        // Longest magic string
+#define STEGO_MAX_EXTN 7         // Longest extension, dot included
+#define STEGO_SIZE_UNKNOWN ((size_t)-1) // Framed payload: size known only after extraction
+
+typedef struct _StegoParams
+{
+    uint depth;        // LSBs per channel, 1-4 or STEGO_DEPTH_AUTO
+    uint codec;        // STEGO_CODEC_NONE or STEGO_CODEC_LZ
+    int checksum;      // Store header and payload CRC32C (0: original layout when possible)
+    int threads;       // Threads for large payloads (<= 1: calling thread only)
+    int scatter;       // Store the payload in keyed blocks (encode only; see scatter.h)
+    const char *key;   // Scatter passphrase for embed and extract (NULL: the magic string)
+    const uchar *aead_key; // 32-byte key sealing the payload on embed and opening it on extract (NULL: none)
+    const StegoShard *shard; // Embed: record the payload as this shard of a split one (NULL: whole payload; see shard.h)
+    StegoStats *stats; // Stage counters (NULL: not recorded)
+} StegoParams;
+
+typedef struct _StegoPayloadInfo
+{
+    size_t size;                   // Payload bytes after decompression (STEGO_SIZE_UNKNOWN if framed)
+    size_t stored_size;            // Payload bytes as embedded
+    char extn[STEGO_MAX_EXTN + 1]; // Extension of the hidden file (e.g. ".txt")
+    uint depth;                    // LSBs per channel used for the payload
+    uint codec;                    // STEGO_CODEC_* applied to the payload
+    int checksum;                  // Header verified by CRC32C, payload checked on extraction
+    int scatter;                   // Payload stored in keyed blocks
+    int sealed;                    // Payload encrypted and authenticated (needs params->aead_key to extract)
+    StegoShard shard;              // Slice of a split payload (shard.count 0: whole payload)
+} StegoPayloadInfo;
+
+/* Defaults: depth 1, no codec, checksums, one thread, sequential layout, no encryption, no stats */
+void stego_default_params(StegoParams *params);
+
+/* Scratch bytes stego_embed needs for a payload of payload_len bytes */
+size_t stego_scratch_size(size_t payload_len, const StegoParams *params);
+
+/* Work bytes stego_extract needs (the same for every image) */
+size_t stego_work_size(void);
+
+/* Why stego_embed rejects carrier, NULL if it takes it (nothing is printed) */
+const char *stego_carrier_error(const uchar *carrier, size_t carrier_len);
+
+/*
+ * Hide payload in a copy of carrier. stego must hold carrier_len
+ * bytes and receives the whole stego image (it may not overlap
+ * carrier). extn is stored as the file extension (may be "").
+ * The carrier must be a raw format (BMP, PPM/PGM, TGA): a PNG stego
+ * image has no fixed size, so PNG carriers need stego_encode_file.
+ */
+Status stego_embed(const uchar *carrier, size_t carrier_len, const uchar *payload, size_t payload_len,
+                   const char *magic, const char *extn, const StegoParams *params,
+                   uchar *stego, size_t stego_len, uchar *scratch, size_t scratch_len);
+
+/* Read the header fields of a stego image without extracting the payload (stego may hold just its first few KB) */
+Status stego_peek(const uchar *stego, size_t stego_len, const char *magic, StegoPayloadInfo *info);
+
+/* Extract the payload into out (out_cap bytes), storing its length in *out_len; work holds stego_work_size() bytes */
+Status stego_extract(const uchar *stego, size_t stego_len, const char *magic, const StegoParams *params,
+                     uchar *out, size_t out_cap, size_t *out_len, StegoPayloadInfo *info, uchar *work, size_t work_len);
+
+/* Encode the secret file into carrier, writing output ("-" for stdin/stdout) */
+Status stego_encode_file(const char *carrier, const char *secret, const char *output, const char *magic,
+                         const StegoParams *params);
+
+/* Decode image into out_name plus the stored extension ("-" for stdin/stdout) */
+Status stego_decode_file(const char *image, const char *out_name, const char *magic, const StegoParams *params);
+
+#endif
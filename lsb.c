@@ -0,0 +1,466 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "lsb.h"
+#include "types.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LSB_X86 1
+#include <immintrin.h>
+#endif
+
+typedef void (*lsb_embed_fn)(uchar *dst, const uchar *src, const uchar *payload, size_t n);
+typedef void (*lsb_extract_fn)(uchar *out, const uchar *src, size_t n);
+
+/* Per-byte bit selectors: carrier byte j of a group takes payload bit (7 - j) */
+static const uchar bit_select[64] = {
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+
+/* Shuffle index that repeats each payload byte of a 128-bit lane eight times */
+static const uchar spread_index[64] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3,
+    4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5,
+    6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7};
+
+/* Shuffle index that reverses the byte order of every 8-byte group */
+static const uchar group_reverse[64] = {
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+/* Bit-reversed value of every byte, built at compile time */
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+static const uchar bit_reverse[256] = {R6(0), R6(2), R6(1), R6(3)};
+
+/*
+ * Table kernels, the portable path for every depth. Carrier bytes are
+ * handled 8 at a time as one 64-bit word (carrier byte j in bits
+ * 8j..8j+7), and at depth d those 8 fields hold exactly d payload
+ * bytes. spread_table[SPREAD_ROW(d) + p][b] is payload byte b at
+ * position p of such a group, already split into its lanes, so an
+ * embed is d lookups, one AND and one OR per word.
+ */
+#define FIELD_MASK(d) (0x0101010101010101ULL * ((1u << (d)) - 1))
+#define SPREAD_ROW(d) ((d) * ((d) - 1) / 2)
+
+#define GROUP(d, p, b) ((unsigned long long)(b) << (8 * ((d) - 1 - (p))))
+#define LANE(d, g, j) ((((g) >> ((d) * (7 - (j)))) & ((1u << (d)) - 1)) << (8 * (j)))
+#define SPREAD(d, p, b)                                                                           \
+    (LANE(d, GROUP(d, p, b), 0) | LANE(d, GROUP(d, p, b), 1) | LANE(d, GROUP(d, p, b), 2) |       \
+     LANE(d, GROUP(d, p, b), 3) | LANE(d, GROUP(d, p, b), 4) | LANE(d, GROUP(d, p, b), 5) |       \
+     LANE(d, GROUP(d, p, b), 6) | LANE(d, GROUP(d, p, b), 7))
+#define S4(d, p, b) SPREAD(d, p, b), SPREAD(d, p, b + 1), SPREAD(d, p, b + 2), SPREAD(d, p, b + 3)
+#define S16(d, p, b) S4(d, p, b), S4(d, p, b + 4), S4(d, p, b + 8), S4(d, p, b + 12)
+#define S64(d, p, b) S16(d, p, b), S16(d, p, b + 16), S16(d, p, b + 32), S16(d, p, b + 48)
+#define S256(d, p) {S64(d, p, 0), S64(d, p, 64), S64(d, p, 128), S64(d, p, 192)}
+
+/* Spread tables for depths 1-4, built at compile time (20 KB) */
+static const unsigned long long spread_table[SPREAD_ROW(5)][256] = {
+    S256(1, 0),
+    S256(2, 0), S256(2, 1),
+    S256(3, 0), S256(3, 1), S256(3, 2),
+    S256(4, 0), S256(4, 1), S256(4, 2), S256(4, 3)};
+
+/* Function Definitions */
+
+static unsigned long long load_lanes(const uchar *p)
+{
+    unsigned long long w;
+    memcpy(&w, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static void store_lanes(uchar *p, unsigned long long w)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    memcpy(p, &w, 8);
+}
+
+static inline void embed_groups(uchar *dst, const uchar *src, const uchar *payload, size_t groups, uint depth)
+{
+    const unsigned long long(*spread)[256] = spread_table + SPREAD_ROW(depth);
+    const unsigned long long keep = ~FIELD_MASK(depth);
+
+    // depth payload bytes -> 8 carrier bytes per iteration
+    for (size_t i = 0; i < groups; i++, payload += depth)
+    {
+        unsigned long long bits = spread[0][payload[0]];
+        for (uint p = 1; p < depth; p++)
+            bits |= spread[p][payload[p]];
+        store_lanes(dst + 8 * i, (load_lanes(src + 8 * i) & keep) | bits);
+    }
+}
+
+static inline void extract_groups(uchar *out, const uchar *src, size_t groups, uint depth)
+{
+    const unsigned long long fields = FIELD_MASK(depth);
+
+    // 8 carrier bytes -> depth payload bytes per iteration
+    for (size_t i = 0; i < groups; i++, out += depth)
+    {
+        unsigned long long w = load_lanes(src + 8 * i) & fields;
+
+        // Gather the fields, lowest carrier byte highest: lane pairs, then quads, then the word
+        w = ((w & 0x00FF00FF00FF00FFULL) << depth) | ((w >> 8) & 0x00FF00FF00FF00FFULL);
+        w = ((w & 0x0000FFFF0000FFFFULL) << (2 * depth)) | ((w >> 16) & 0x0000FFFF0000FFFFULL);
+        w = ((w & 0xFFFFFFFFULL) << (4 * depth)) | (w >> 32);
+
+        for (uint p = 0; p < depth; p++)
+            out[p] = w >> (8 * (depth - 1 - p));
+    }
+}
+
+static void embed_table(uchar *dst, const uchar *src, const uchar *payload, size_t n)
+{
+    embed_groups(dst, src, payload, n, 1);
+}
+
+static void extract_table(uchar *out, const uchar *src, size_t n)
+{
+    // One multiply moves the LSB of carrier byte j to bit 56 + (7 - j)
+    for (size_t i = 0; i < n; i++)
+        out[i] = ((load_lanes(src + 8 * i) & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56;
+}
+
+#ifdef LSB_X86
+
+__attribute__((target("sse2"))) static void embed_sse2(uchar *dst, const uchar *src, const uchar *payload, size_t n)
+{
+    const __m128i sel = _mm_loadu_si128((const __m128i *)bit_select);
+    const __m128i keep = _mm_set1_epi8((char)0xFE);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+
+    // 2 payload bytes -> 16 carrier bytes per iteration
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i p = _mm_cvtsi32_si128(payload[i] | (payload[i + 1] << 8));
+        p = _mm_unpacklo_epi8(p, p);  // b0 b0 b1 b1
+        p = _mm_unpacklo_epi16(p, p); // b0 x4, b1 x4
+        p = _mm_unpacklo_epi32(p, p); // b0 x8, b1 x8
+        __m128i bits = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(p, sel), sel), one);
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 8 * i));
+        _mm_storeu_si128((__m128i *)(dst + 8 * i), _mm_or_si128(_mm_and_si128(c, keep), bits));
+    }
+
+    embed_table(dst + 8 * i, src + 8 * i, payload + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void embed_avx2(uchar *dst, const uchar *src, const uchar *payload, size_t n)
+{
+    const __m256i sel = _mm256_loadu_si256((const __m256i *)bit_select);
+    const __m256i idx = _mm256_loadu_si256((const __m256i *)spread_index);
+    const __m256i keep = _mm256_set1_epi8((char)0xFE);
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+
+    // 4 payload bytes -> 32 carrier bytes per iteration
+    for (; i + 4 <= n; i += 4)
+    {
+        int word;
+        memcpy(&word, payload + i, 4);
+        __m256i p = _mm256_shuffle_epi8(_mm256_set1_epi32(word), idx);
+        __m256i bits = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(p, sel), sel), one);
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + 8 * i));
+        _mm256_storeu_si256((__m256i *)(dst + 8 * i), _mm256_or_si256(_mm256_and_si256(c, keep), bits));
+    }
+
+    embed_sse2(dst + 8 * i, src + 8 * i, payload + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void embed_avx512(uchar *dst, const uchar *src, const uchar *payload, size_t n)
+{
+    const __m512i sel = _mm512_loadu_si512((const void *)bit_select);
+    const __m512i idx = _mm512_loadu_si512((const void *)spread_index);
+    const __m512i keep = _mm512_set1_epi8((char)0xFE);
+    const __m512i one = _mm512_set1_epi8(1);
+    size_t i = 0;
+
+    // 8 payload bytes -> 64 carrier bytes per iteration
+    for (; i + 8 <= n; i += 8)
+    {
+        long long quad;
+        memcpy(&quad, payload + i, 8);
+        __m512i p = _mm512_shuffle_epi8(_mm512_set1_epi64(quad), idx);
+        __mmask64 set = _mm512_test_epi8_mask(p, sel);
+        __m512i c = _mm512_and_si512(_mm512_loadu_si512((const void *)(src + 8 * i)), keep);
+        _mm512_storeu_si512((void *)(dst + 8 * i), _mm512_mask_blend_epi8(set, c, _mm512_or_si512(c, one)));
+    }
+
+    embed_avx2(dst + 8 * i, src + 8 * i, payload + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void extract_sse2(uchar *out, const uchar *src, size_t n)
+{
+    size_t i = 0;
+
+    // 16 carrier bytes -> 2 payload bytes: move each LSB into the sign bit and gather
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i c = _mm_slli_epi16(_mm_loadu_si128((const __m128i *)(src + 8 * i)), 7);
+        int mask = _mm_movemask_epi8(c);
+        out[i] = bit_reverse[mask & 0xFF];
+        out[i + 1] = bit_reverse[(mask >> 8) & 0xFF];
+    }
+
+    extract_table(out + i, src + 8 * i, n - i);
+}
+
+__attribute__((target("bmi2"))) static void extract_bmi2(uchar *out, const uchar *src, size_t n)
+{
+    size_t i = 0;
+
+    // 8 carrier bytes -> 1 payload byte: byte-swap so the first carrier byte becomes the MSB
+    for (; i < n; i++)
+    {
+        unsigned long long quad;
+        memcpy(&quad, src + 8 * i, 8);
+        out[i] = (uchar)_pext_u64(__builtin_bswap64(quad), 0x0101010101010101ULL);
+    }
+}
+
+__attribute__((target("avx2"))) static void extract_avx2(uchar *out, const uchar *src, size_t n)
+{
+    const __m256i idx = _mm256_loadu_si256((const __m256i *)group_reverse);
+    size_t i = 0;
+
+    // 32 carrier bytes -> 4 payload bytes
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i c = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + 8 * i)), idx);
+        int mask = _mm256_movemask_epi8(_mm256_slli_epi16(c, 7));
+        memcpy(out + i, &mask, 4);
+    }
+
+    extract_sse2(out + i, src + 8 * i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void extract_avx512(uchar *out, const uchar *src, size_t n)
+{
+    const __m512i idx = _mm512_loadu_si512((const void *)group_reverse);
+    const __m512i one = _mm512_set1_epi8(1);
+    size_t i = 0;
+
+    // 64 carrier bytes -> 8 payload bytes
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i c = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(src + 8 * i)), idx);
+        __mmask64 mask = _mm512_test_epi8_mask(c, one);
+        memcpy(out + i, &mask, 8);
+    }
+
+    extract_avx2(out + i, src + 8 * i, n - i);
+}
+
+#endif
+
+static lsb_extract_fn extract_impl;
+static lsb_embed_fn embed_impl;
+static const char *embed_name;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT; // Workers may race on the first call
+
+static void select_kernels(void)
+{
+    extract_impl = extract_table;
+    embed_impl = embed_table;
+    embed_name = "table";
+
+#ifdef LSB_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        extract_impl = extract_avx512;
+        embed_impl = embed_avx512;
+        embed_name = "avx512bw";
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        extract_impl = extract_avx2;
+        embed_impl = embed_avx2;
+        embed_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        extract_impl = __builtin_cpu_supports("bmi2") ? extract_bmi2 : extract_sse2;
+        embed_impl = embed_sse2;
+        embed_name = "sse2";
+    }
+#endif
+}
+
+void lsb_embed(uchar *dst, const uchar *src, const uchar *payload, size_t n)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    embed_impl(dst, src, payload, n);
+}
+
+void lsb_extract(uchar *out, const uchar *src, size_t n)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    extract_impl(out, src, n);
+}
+
+void lsb_embed_bits(uchar *dst, const uchar *src, const uchar *payload, size_t first_bit, size_t nbits)
+{
+    size_t i = 0;
+
+    // Leading bits up to the next payload byte boundary
+    for (; i < nbits && (first_bit + i) % 8 != 0; i++)
+    {
+        size_t b = first_bit + i;
+        dst[i] = (src[i] & ~1) | ((payload[b / 8] >> (7 - b % 8)) & 1);
+    }
+
+    // Whole payload bytes through the block kernel
+    size_t whole = (nbits - i) / 8;
+    if (whole > 0)
+    {
+        lsb_embed(dst + i, src + i, payload + (first_bit + i) / 8, whole);
+        i += 8 * whole;
+    }
+
+    // Trailing bits of a partial byte
+    for (; i < nbits; i++)
+    {
+        size_t b = first_bit + i;
+        dst[i] = (src[i] & ~1) | ((payload[b / 8] >> (7 - b % 8)) & 1);
+    }
+}
+
+void lsb_extract_bits(uchar *out, const uchar *src, size_t first_bit, size_t nbits)
+{
+    size_t i = 0;
+
+    for (; i < nbits && (first_bit + i) % 8 != 0; i++)
+    {
+        size_t b = first_bit + i;
+        uchar mask = 0x80 >> (b % 8);
+        out[b / 8] = (out[b / 8] & ~mask) | ((src[i] & 1) ? mask : 0);
+    }
+
+    size_t whole = (nbits - i) / 8;
+    if (whole > 0)
+    {
+        lsb_extract(out + (first_bit + i) / 8, src + i, whole);
+        i += 8 * whole;
+    }
+
+    for (; i < nbits; i++)
+    {
+        size_t b = first_bit + i;
+        uchar mask = 0x80 >> (b % 8);
+        out[b / 8] = (out[b / 8] & ~mask) | ((src[i] & 1) ? mask : 0);
+    }
+}
+
+void lsb_embed_k(uchar *dst, const uchar *src, const uchar *payload, size_t first_bit, size_t nbits, uint depth)
+{
+    if (depth == 1)
+    {
+        lsb_embed_bits(dst, src, payload, first_bit, nbits);
+        return;
+    }
+
+    uchar field_mask = (1 << depth) - 1;
+    size_t bit = first_bit, end = first_bit + nbits;
+    size_t j = 0;
+
+    // From a byte boundary, whole groups of depth payload bytes go through the tables
+    if (bit % 8 == 0)
+    {
+        size_t groups = (end - bit) / (8 * depth);
+        switch (depth)
+        {
+        case 2:
+            embed_groups(dst, src, payload + bit / 8, groups, 2);
+            break;
+        case 3:
+            embed_groups(dst, src, payload + bit / 8, groups, 3);
+            break;
+        default:
+            embed_groups(dst, src, payload + bit / 8, groups, 4);
+            break;
+        }
+        j = 8 * groups;
+        bit += 8 * depth * groups;
+    }
+
+    // Unaligned start or a last partial group: one field at a time
+    for (; bit < end; j++)
+    {
+        uint n = (end - bit < depth) ? end - bit : depth;
+        uint field = 0;
+        for (uint t = 0; t < n; t++, bit++)
+            field = (field << 1) | ((payload[bit / 8] >> (7 - bit % 8)) & 1);
+
+        uchar mask = field_mask & ~((1 << (depth - n)) - 1);
+        dst[j] = (src[j] & ~mask) | (field << (depth - n));
+    }
+}
+
+void lsb_extract_k(uchar *out, const uchar *src, size_t first_bit, size_t nbits, uint depth)
+{
+    if (depth == 1)
+    {
+        lsb_extract_bits(out, src, first_bit, nbits);
+        return;
+    }
+
+    size_t bit = first_bit, end = first_bit + nbits;
+    size_t j = 0;
+
+    if (bit % 8 == 0)
+    {
+        size_t groups = (end - bit) / (8 * depth);
+        switch (depth)
+        {
+        case 2:
+            extract_groups(out + bit / 8, src, groups, 2);
+            break;
+        case 3:
+            extract_groups(out + bit / 8, src, groups, 3);
+            break;
+        default:
+            extract_groups(out + bit / 8, src, groups, 4);
+            break;
+        }
+        j = 8 * groups;
+        bit += 8 * depth * groups;
+    }
+
+    for (; bit < end; j++)
+    {
+        uint n = (end - bit < depth) ? end - bit : depth;
+        for (uint t = 0; t < n; t++, bit++)
+        {
+            uchar mask = 0x80 >> (bit % 8);
+            uchar value = (src[j] >> (depth - 1 - t)) & 1;
+            out[bit / 8] = (out[bit / 8] & ~mask) | (value ? mask : 0);
+        }
+    }
+}
+
+const char *lsb_kernel_name(void)
+{
+    pthread_once(&kernels_once, select_kernels);
+
+    return embed_name;
+}
@@ -0,0 +1,44 @@
+#ifndef LSB_H
+#define LSB_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Block LSB kernels shared by the encoder and decoder.
+ * Payload bits are stored MSB first, one bit per carrier byte,
+ * so payload byte i lives in carrier bytes [8*i, 8*i + 8).
+ * The best kernels for the running CPU (AVX-512, AVX2, BMI2,
+ * SSE2 or the portable lookup-table kernels) are picked on the
+ * first call.
+ */
+
+/* Embed n payload bytes into the LSBs of 8*n carrier bytes (dst may equal src) */
+void lsb_embed(uchar *dst, const uchar *src, const uchar *payload, size_t n);
+
+/* Extract n payload bytes from the LSBs of 8*n carrier bytes */
+void lsb_extract(uchar *out, const uchar *src, size_t n);
+
+/* Embed payload bits [first_bit, first_bit + nbits) into nbits carrier bytes */
+void lsb_embed_bits(uchar *dst, const uchar *src, const uchar *payload, size_t first_bit, size_t nbits);
+
+/* Extract nbits carrier LSBs into payload bits [first_bit, first_bit + nbits) of out */
+void lsb_extract_bits(uchar *out, const uchar *src, size_t first_bit, size_t nbits);
+
+/*
+ * Multi-bit embedding: carrier byte j holds payload bits
+ * [first_bit + j*depth, first_bit + (j+1)*depth) in its `depth` LSBs,
+ * first bit highest. A final carrier byte with fewer than depth bits
+ * left only has its top bits of the field replaced.
+ */
+
+/* Embed nbits payload bits into ceil(nbits / depth) carrier bytes */
+void lsb_embed_k(uchar *dst, const uchar *src, const uchar *payload, size_t first_bit, size_t nbits, uint depth);
+
+/* Extract nbits payload bits from ceil(nbits / depth) carrier bytes */
+void lsb_extract_k(uchar *out, const uchar *src, size_t first_bit, size_t nbits, uint depth);
+
+/* Name of the embed kernel selected for this CPU */
+const char *lsb_kernel_name(void);
+
+#endif
@@ -0,0 +1,228 @@
+#include <string.h>
+#include "lz.h"
+#include "types.h"
+
+/*
+ * Packed format: a list of sequences, each
+ *
+ *   token | [literal length bytes] | literals | offset(16, LE) | [match length bytes]
+ *
+ * The token holds the literal count (high nibble) and the match
+ * length minus LZ_MIN_MATCH (low nibble); 15 means more length bytes
+ * follow, each added in until one is below 255. The last sequence
+ * stops after its literals.
+ */
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+
+/* Function Definitions */
+
+static uint hash4(const uchar *p)
+{
+    uint v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint)p[3] << 24);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uchar *put_length(uchar *op, const uchar *end, size_t len)
+{
+    // Length bytes: runs of 255 and a final byte below 255
+    for (; len >= 255; len -= 255)
+    {
+        if (op >= end)
+            return NULL;
+        *op++ = 255;
+    }
+    if (op >= end)
+        return NULL;
+    *op++ = len;
+    return op;
+}
+
+static uchar *put_sequence(uchar *op, const uchar *end, const uchar *lit, size_t nlit, size_t offset, size_t mlen)
+{
+    if (op >= end)
+        return NULL;
+
+    uchar *token = op++;
+    *token = (nlit < 15 ? nlit : 15) << 4;
+    if (nlit >= 15 && (op = put_length(op, end, nlit - 15)) == NULL)
+        return NULL;
+
+    if ((size_t)(end - op) < nlit)
+        return NULL;
+    memcpy(op, lit, nlit);
+    op += nlit;
+
+    if (mlen == 0)
+        return op; // Last sequence: literals only
+
+    if (end - op < 2)
+        return NULL;
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    mlen -= LZ_MIN_MATCH;
+    *token |= mlen < 15 ? mlen : 15;
+    if (mlen >= 15 && (op = put_length(op, end, mlen - 15)) == NULL)
+        return NULL;
+    return op;
+}
+
+size_t lz_compress(const uchar *src, size_t n, uchar *dst, size_t cap, uint *table)
+{
+    // table: last position + 1 of each 4-byte hash
+    uchar *op = dst;
+    const uchar *end = dst + cap;
+    size_t anchor = 0, pos = 0;
+
+    memset(table, 0, LZ_TABLE_BYTES);
+
+    // Greedy parse: take the most recent earlier 4-byte match, extended as far as it goes
+    while (pos + LZ_MIN_MATCH <= n)
+    {
+        uint h = hash4(src + pos);
+        size_t cand = table[h];
+        table[h] = pos + 1;
+
+        if (cand == 0 || pos - (cand - 1) > LZ_MAX_OFFSET || memcmp(src + cand - 1, src + pos, LZ_MIN_MATCH) != 0)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t ref = cand - 1;
+        size_t len = LZ_MIN_MATCH;
+        while (pos + len < n && src[ref + len] == src[pos + len])
+            len++;
+
+        op = put_sequence(op, end, src + anchor, pos - anchor, pos - ref, len);
+        if (op == NULL)
+            return 0;
+        pos += len;
+        anchor = pos;
+    }
+
+    op = put_sequence(op, end, src + anchor, n - anchor, 0, 0);
+    return op ? (size_t)(op - dst) : 0;
+}
+
+static Status get_length(const uchar **ip, const uchar *end, size_t *len)
+{
+    uchar b;
+    do
+    {
+        if (*ip >= end)
+            return e_failure;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return e_success;
+}
+
+Status lz_decompress(const uchar *src, size_t n, uchar *dst, size_t raw_len)
+{
+    const uchar *ip = src, *iend = src + n;
+    uchar *op = dst, *oend = dst + raw_len;
+
+    // Every length and offset is checked against both buffers
+    for (;;)
+    {
+        if (ip >= iend)
+            return e_failure;
+        uint token = *ip++;
+
+        size_t nlit = token >> 4;
+        if (nlit == 15 && get_length(&ip, iend, &nlit) != e_success)
+            return e_failure;
+        if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op))
+            return e_failure;
+        memcpy(op, ip, nlit);
+        ip += nlit;
+        op += nlit;
+
+        if (ip == iend)
+            break; // Last sequence
+
+        if (iend - ip < 2)
+            return e_failure;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && get_length(&ip, iend, &mlen) != e_success)
+            return e_failure;
+        mlen += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - dst) || mlen > (size_t)(oend - op))
+            return e_failure;
+
+        // Byte by byte: the match may overlap the bytes it produces
+        const uchar *ref = op - offset;
+        while (mlen--)
+            *op++ = *ref++;
+    }
+
+    return op == oend ? e_success : e_failure;
+}
+
+static void put_32(uchar *p, uint value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static uint get_32(const uchar *p)
+{
+    return ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+}
+
+size_t lz_pack_block(const uchar *src, size_t n, uchar *dst, uint *table)
+{
+    // Keep the block raw unless compression saves at least a byte
+    size_t packed = n > 0 ? lz_compress(src, n, dst + LZ_BLOCK_HEADER, n - 1, table) : 0;
+    if (packed == 0)
+    {
+        memcpy(dst + LZ_BLOCK_HEADER, src, n);
+        packed = n;
+    }
+
+    put_32(dst, n);
+    put_32(dst + 4, packed);
+    return LZ_BLOCK_HEADER + packed;
+}
+
+size_t lz_pack(const uchar *src, size_t n, uchar *dst, uint *table)
+{
+    size_t packed = 0;
+    for (size_t done = 0; done < n;)
+    {
+        size_t len = n - done < LZ_BLOCK_SIZE ? n - done : LZ_BLOCK_SIZE;
+        packed += lz_pack_block(src + done, len, dst + packed, table);
+        done += len;
+    }
+    return packed;
+}
+
+Status lz_block_sizes(const uchar *header, size_t *raw_len, size_t *packed_len)
+{
+    *raw_len = get_32(header);
+    *packed_len = get_32(header + 4);
+
+    if (*raw_len == 0 || *raw_len > LZ_BLOCK_SIZE || *packed_len > *raw_len)
+        return e_failure;
+    return e_success;
+}
+
+Status lz_unpack_block(const uchar *packed, size_t packed_len, uchar *dst, size_t raw_len)
+{
+    // Stored block
+    if (packed_len == raw_len)
+    {
+        memcpy(dst, packed, raw_len);
+        return e_success;
+    }
+
+    return lz_decompress(packed, packed_len, dst, raw_len);
+}
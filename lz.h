@@ -0,0 +1,50 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Small in-tree LZ77 codec used to shrink the secret before it is
+ * embedded. The secret is cut into blocks of at most LZ_BLOCK_SIZE
+ * bytes and every block is stored on its own:
+ *
+ *   raw len(32) | packed len(32) | packed bytes
+ *
+ * A block that does not shrink is stored as is (packed len == raw
+ * len), so a packed block is never longer than LZ_BLOCK_BOUND(raw).
+ * Blocks are independent, which lets the decoder inflate them one
+ * at a time while streaming the output.
+ */
+
+#define LZ_BLOCK_SIZE (64 * 1024)                  // Raw bytes per block
+#define LZ_BLOCK_HEADER 8                          // raw len + packed len
+#define LZ_BLOCK_BOUND(n) (LZ_BLOCK_HEADER + (n)) // Worst case packed block
+#define LZ_HASH_BITS 13
+#define LZ_TABLE_BYTES ((1 << LZ_HASH_BITS) * sizeof(uint)) // Match table the caller lends to the packer
+
+/* Worst case size of n bytes packed as a list of blocks */
+#define LZ_PACK_BOUND(n) ((n) + ((n) + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE * LZ_BLOCK_HEADER)
+
+/* Largest unpacked size n packed bytes can hold: every block takes its header and at least one byte */
+#define LZ_UNPACK_BOUND(n) (((n) + LZ_BLOCK_HEADER) / (LZ_BLOCK_HEADER + 1) * LZ_BLOCK_SIZE)
+
+/* Compress n bytes into dst (at most cap bytes) using table (LZ_TABLE_BYTES); returns the packed size or 0 if it does not fit */
+size_t lz_compress(const uchar *src, size_t n, uchar *dst, size_t cap, uint *table);
+
+/* Decompress exactly raw_len bytes from n packed bytes */
+Status lz_decompress(const uchar *src, size_t n, uchar *dst, size_t raw_len);
+
+/* Pack n <= LZ_BLOCK_SIZE bytes as one block (header included); returns the block size */
+size_t lz_pack_block(const uchar *src, size_t n, uchar *dst, uint *table);
+
+/* Pack n bytes as consecutive blocks into dst (LZ_PACK_BOUND(n) bytes); returns the packed size */
+size_t lz_pack(const uchar *src, size_t n, uchar *dst, uint *table);
+
+/* Read and validate a block header */
+Status lz_block_sizes(const uchar *header, size_t *raw_len, size_t *packed_len);
+
+/* Inflate the packed bytes of a block (header already parsed) */
+Status lz_unpack_block(const uchar *packed, size_t packed_len, uchar *dst, size_t raw_len);
+
+#endif
@@ -30,8 +30,53 @@ Sample User Inputs:
   ./a.out -d stego.bmp output "#*"
     → Decodes the hidden file from stego.bmp using magic string "#*", and saves it as output.txt
 
+  ./a.out -e -j 8 big.bmp archive.bin big_out.bmp "#*"
+    → Same as above, splitting a large payload across 8 threads (default: one per CPU)
+
+  ./a.out -e -k auto input.bmp large.zip output.bmp "#*"
+    → Uses up to 4 LSBs per colour channel, as few as the secret needs (decode reads the depth from the image)
+
+  ./a.out -e -z input.bmp notes.json output.bmp "#*"
+    → Compresses notes.json before hiding it, so fewer pixel bytes are touched (decode inflates it automatically)
+
+  ./a.out -e --no-crc input.bmp secret.txt output.bmp "#*"
+    → Leaves out the header and payload checksums, giving the original image layout
+
+  ./a.out -e --key "open sesame" input.bmp secret.txt output.bmp "#*"
+    → Spreads the payload over the image in an order only the key reproduces (decode with the same --key;
+      --scatter alone keys the order with the magic string)
+
+  ./a.out -e --encrypt secret.key input.bmp secret.txt output.bmp "#*"
+    → Encrypts and authenticates the payload with the 32-byte key in secret.key (decode with the same --encrypt;
+      a wrong key or a tampered image is rejected without writing any of the secret)
+
+  ./a.out -e --stats json input.bmp secret.txt output.bmp "#*"
+    → Same as above, then prints time, bytes and I/O calls of every stage to stderr (or --stats prometheus)
+
+  ./a.out -e photo.png secret.txt stego.png "#*"
+    → Same with a PNG carrier (also .ppm/.pgm/.pnm and .tga); the stego image keeps the carrier's format
+
+  ./a.out -e --shards shards.txt archive.bin "#*"
+    → Splits archive.bin over every carrier listed in shards.txt ("carrier.bmp output.bmp" per line), all at once
+
+  ./a.out -d --shards stegos.txt archive "#*"
+    → Checks the shards listed in stegos.txt belong together and reassembles them into archive.bin
+
+  ./a.out -b jobs.txt 8
+    → Runs every encode/decode job listed in jobs.txt on 8 worker threads (default: one per CPU)
+      (file reads and writes go through io_uring where the kernel allows it; --no-uring turns that off)
+      (carriers used by several jobs are read once and kept in a 256 MB cache; --cache-mb N resizes it, 0 turns it off)
+
+  ./a.out -s photos/ "#*" 16
+    → Lists every image under photos/ that holds a payload for "#*", with its size and extension, using 16 threads
+      (photos/ may also be a file with one image path per line, or "-" to read such a list from stdin)
+
+  ./a.out -D /tmp/stego.sock 4
+    → Runs as a daemon serving embed/extract requests on a Unix socket with 4 warm workers until Ctrl+C
+      (stego_client drives it: ./stego_client /tmp/stego.sock embed input.bmp secret.txt output.bmp "#*")
+
 File Info:
-  - Only supports 24-bit BMP images for encoding/decoding.
+  - Supports uncompressed 24/32-bit BMP, binary PPM/PGM, uncompressed TGA and 8-bit non-interlaced PNG images.
   - Secret file must be a .txt file.
   - Output file for decoding should not include an extension; it is restored automatically.
 
@@ -39,9 +84,19 @@ File Info:
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "aead.h"
+#include "carrier.h"
 #include "encode.h"
 #include "decode.h"
+#include "batch.h"
+#include "libstego.h"
+#include "options.h"
+#include "pool.h"
+#include "scan.h"
+#include "server.h"
+#include "shard.h"
 #include "types.h"
 
 int main(int argc, char *argv[])
@@ -54,96 +109,163 @@ int main(int argc, char *argv[])
 
     OperationType user_operation = check_operation_type(argv); // Determine operation type
 
-    if (user_operation == e_encode) // Encode operation
+    StegoOptions opts;
+    if (parse_options(&argc, argv, &opts) != e_success) // Strip optional flags
+    {
+        printf("ERROR: %s function failed\n", "parse_options");
+        return 0;
+    }
+
+    // Stage counters are only collected when a report was asked for
+    StegoStats stats;
+    StegoStats *stats_ptr = NULL;
+    if (opts.stats != STATS_OFF)
     {
-        EncodeInfo encInfo;
+        stats_reset(&stats);
+        stats_ptr = &stats;
+    }
 
-        if (read_and_validate_encode_args(argc, argv) != e_success) // Validate encode args
+    StegoParams params;
+    stego_default_params(&params);
+    params.depth = opts.depth;
+    params.codec = opts.codec;
+    params.checksum = opts.checksum;
+    params.threads = opts.threads;
+    params.scatter = opts.scatter;
+    params.key = opts.key;
+    params.stats = stats_ptr;
+
+    // The payload key is read once, before any job opens its files
+    uchar aead_key[AEAD_KEY_BYTES];
+    if (opts.key_file != NULL)
+    {
+        if (aead_load_key(opts.key_file, aead_key) != e_success)
         {
-            printf("ERROR: %s function failed\n", "read_and_validate_encode_args");
+            printf("ERROR: %s function failed\n", "aead_load_key");
             return 0;
         }
+        params.aead_key = aead_key;
+    }
 
-        strcpy(encInfo.src_image_fname, argv[2]);
-        strcpy(encInfo.secret_fname, argv[3]);
-        if (argc == 6)
+    if (opts.shards != NULL) // Sharded encode or decode
+    {
+        Status status = e_failure;
+        if (user_operation == e_encode && argc == 4)
         {
-            strcpy(encInfo.stego_image_fname, argv[4]);
-            strcpy(encInfo.usr_migc_str, argv[5]);
+            status = do_shard_encode(opts.shards, argv[2], argv[3], &params, opts.threads); // Split over every carrier
         }
-        else // argc == 5
+        else if (user_operation == e_decode && (argc == 3 || argc == 4))
         {
-            strcpy(encInfo.stego_image_fname, "output_image.bmp");
-            strcpy(encInfo.usr_migc_str, argv[4]);
+            const char *out_name = (argc == 4) ? argv[2] : "output_text"; // Default output name
+            status = do_shard_decode(opts.shards, out_name, argv[argc - 1], &params, opts.threads); // Reassemble
         }
-
-        encInfo.size_usr_migc_str = strlen(encInfo.usr_migc_str);
-
-        if (open_files(&encInfo) == e_failure) // Open files for encoding
+        else
         {
-            printf("ERROR: %s function failed\n", "open_files");
+            printf("ERROR: %s function failed\n", "read_and_validate_shard_args");
             return 0;
         }
 
-        encInfo.image_capacity = get_image_size_for_bmp(encInfo.fptr_src_image); // Get image capacity
-        encInfo.size_secret_file = get_file_size(encInfo.fptr_secret);           // Get secret file size
-
-        Status capacity_status = check_capacity(&encInfo); // Check if image can hold secret
-
-        if (capacity_status == e_success)
+        if (status == e_success)
+            printf("SUCCESS: %s function completed ✅\n", user_operation == e_encode ? "do_shard_encode" : "do_shard_decode");
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, user_operation == e_encode ? "encode" : "decode", opts.stats, stderr);
+        return 0;
+    }
+    if (user_operation == e_encode) // Encode operation
+    {
+        if (read_and_validate_encode_args(argc, argv) != e_success) // Validate encode args
         {
-            if (do_encoding(&encInfo) != e_success) // Perform encoding
-                printf("ERROR: %s function failed\n", "do_encoding");
-            else
-                printf("SUCCESS: %s function completed ✅\n", "do_encoding");
+            printf("ERROR: %s function failed\n", "read_and_validate_encode_args");
+            return 0;
         }
-        else if (capacity_status == e_failure)
+
+        // Default output file: output_image in the carrier's format
+        char default_output[32];
+        const char *extn = strrchr(argv[2], '.');
+        snprintf(default_output, sizeof(default_output), "output_image%s", is_carrier_name(argv[2]) ? extn : ".bmp");
+        const char *output = (argc == 6) ? argv[4] : default_output;
+        const char *magic = argv[argc - 1];
+        if (strlen(magic) > STEGO_MAX_MAGIC)
         {
-            printf("ERROR: %s function failed\n", "capacity_status");
+            printf("ERROR: Magic string too long.\n");
             return 0;
         }
 
-        fclose(encInfo.fptr_src_image);
-        fclose(encInfo.fptr_secret);
-        fclose(encInfo.fptr_stego_image);
+        if (stego_encode_file(argv[2], argv[3], output, magic, &params) == e_success) // Open, check capacity and encode
+            printf("SUCCESS: %s function completed ✅\n", "do_encoding");
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, "encode", opts.stats, stderr);
     }
     if (user_operation == e_decode) // Decode operation
     {
-        DecodeInfo decInfo;
-
         if (read_and_validate_decode_args(argc, argv) != e_success) // Validate decode args
         {
             printf("ERROR: %s function failed\n", "read_and_validate_decode_args");
             return 0;
         }
 
-        strcpy(decInfo.inp_image_fname, argv[2]);
-        if (argc == 5)
+        const char *out_name = (argc == 5) ? argv[3] : "output_text"; // Default output name
+        const char *magic = argv[argc - 1];
+        if (strlen(magic) > STEGO_MAX_MAGIC)
         {
-            strcpy(decInfo.out_fname, argv[3]);
-            strcpy(decInfo.usr_migc_str, argv[4]);
+            printf("ERROR: Magic string too long.\n");
+            return 0;
         }
-        else // argc == 4
+
+        Status status = stego_decode_file(argv[2], out_name, magic, &params); // Open and decode
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, "decode", opts.stats, stderr);
+        if (status != e_success)
+            return 0;
+        else
+            printf("SUCCESS: %s function completed ✅\n", "do_decoding");
+    }
+    if (user_operation == e_batch) // Batch operation
+    {
+        int nthreads = (argc == 4) ? atoi(argv[3]) : pool_default_threads();
+
+        if (argc < 3 || argc > 4 || nthreads < 1)
         {
-            strcpy(decInfo.out_fname, "output_text");
-            strcpy(decInfo.usr_migc_str, argv[3]);
+            printf("ERROR: %s function failed\n", "read_and_validate_batch_args");
+            return 0;
         }
 
-        decInfo.size_usr_migc_str = strlen(decInfo.usr_migc_str);
+        if (do_batch(argv[2], nthreads, opts.uring, (size_t)opts.cache_mb << 20, stats_ptr) != e_success) // Run every manifest job
+            printf("ERROR: %s function failed\n", "do_batch");
+        else
+            printf("SUCCESS: %s function completed ✅\n", "do_batch");
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, "batch", opts.stats, stderr);
+    }
+    if (user_operation == e_scan) // Scan operation
+    {
+        int nthreads = (argc == 5) ? atoi(argv[4]) : pool_default_threads();
 
-        if (open_files_dec(&decInfo) == e_failure) // Open files for decoding
+        if (argc < 4 || argc > 5 || nthreads < 1)
         {
-            printf("ERROR: %s function failed\n", "open_files");
-            return 1;
+            printf("ERROR: %s function failed\n", "read_and_validate_scan_args");
+            return 0;
         }
 
-        if (do_decoding(&decInfo) != e_success) // Perform decoding
+        if (do_scan(argv[2], argv[3], nthreads, stats_ptr) != e_success) // Check every image of the source
+            printf("ERROR: %s function failed\n", "do_scan");
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, "scan", opts.stats, stderr);
+    }
+    if (user_operation == e_serve) // Daemon operation
+    {
+        int nthreads = (argc == 4) ? atoi(argv[3]) : pool_default_threads();
+
+        if (argc < 3 || argc > 4 || nthreads < 1)
+        {
+            printf("ERROR: %s function failed\n", "read_and_validate_serve_args");
             return 0;
-        else
-            printf("SUCCESS: %s function completed ✅\n", "do_decoding");
+        }
 
-        fclose(decInfo.fptr_inp_image);
-        fclose(decInfo.fptr_out);
+        if (do_serve(argv[2], nthreads, (size_t)opts.cache_mb << 20, stats_ptr) != e_success) // Serve until SIGINT/SIGTERM
+            printf("ERROR: %s function failed\n", "do_serve");
+        if (stats_ptr != NULL)
+            stats_print(stats_ptr, "serve", opts.stats, stderr);
     }
     if (user_operation == e_unsupported)
         printf("ERROR: Unsupported Operation.\n"); // Unsupported operation
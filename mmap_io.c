@@ -0,0 +1,87 @@
+#define _GNU_SOURCE // copy_file_range
+
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h> // FICLONE
+#endif
+#include "mmap_io.h"
+#include "types.h"
+
+/* Function Definitions */
+
+uchar *map_file_read(FILE *fptr, size_t *size)
+{
+    struct stat st;
+    int fd = fileno(fptr);
+
+    // Only regular, non-empty files can be mapped
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return NULL;
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL); // Carrier is walked front to back
+    *size = st.st_size;
+    return map;
+}
+
+uchar *map_file_write(FILE *fptr, size_t size)
+{
+    struct stat st;
+    int fd = fileno(fptr);
+
+    if (fd < 0 || size == 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return NULL;
+
+    // Grow the output to its final size before mapping it
+    if (ftruncate(fd, size) != 0)
+        return NULL;
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    return map;
+}
+
+Status clone_file(FILE *src, FILE *dst, size_t size)
+{
+    struct stat st;
+    int src_fd = fileno(src), dst_fd = fileno(dst);
+    if (src_fd < 0 || dst_fd < 0 || fstat(dst_fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return e_failure;
+
+#ifdef FICLONE
+    // Reflink (btrfs, XFS, bcachefs): the output shares the carrier's blocks until written
+    struct stat src_st;
+    if (fstat(src_fd, &src_st) == 0 && (size_t)src_st.st_size == size && ioctl(dst_fd, FICLONE, src_fd) == 0)
+        return e_success;
+#endif
+
+#ifdef __linux__
+    // In-kernel copy (may still share blocks on file systems that support it)
+    off_t src_off = 0, dst_off = 0;
+    while ((size_t)src_off < size)
+    {
+        ssize_t n = copy_file_range(src_fd, &src_off, dst_fd, &dst_off, size - src_off, 0);
+        if (n <= 0)
+            return e_failure; // Unsupported (EXDEV, ENOSYS, EINVAL) or carrier shrank
+    }
+    return e_success;
+#else
+    (void)size;
+    return e_failure;
+#endif
+}
+
+void unmap_file(const uchar *map, size_t size)
+{
+    if (map != NULL)
+        munmap((void *)map, size);
+}
@@ -0,0 +1,32 @@
+#ifndef MMAP_IO_H
+#define MMAP_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Memory mapped file backend used by the encoder and decoder.
+ * Only regular files can be mapped; pipes, terminals and empty
+ * files return NULL so the caller falls back to stdio.
+ *
+ * An encode whose carrier and output are both regular files first
+ * clones the carrier into the output (a reflink sharing its blocks,
+ * else an in-kernel copy_file_range). Only the pages the payload
+ * touches are then written through the mapping; the header and the
+ * pixels after the payload are never copied in user space.
+ */
+
+/* Map the whole file behind fptr read-only, storing its size */
+uchar *map_file_read(FILE *fptr, size_t *size);
+
+/* Resize the file behind fptr to size bytes and map it writable */
+uchar *map_file_write(FILE *fptr, size_t size);
+
+/* Make dst hold the first size bytes of src without copying them through user space (e_failure: copy them yourself) */
+Status clone_file(FILE *src, FILE *dst, size_t size);
+
+/* Release a mapping returned by map_file_read/map_file_write */
+void unmap_file(const uchar *map, size_t size);
+
+#endif
@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L // st_mtim (carrier_cache.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "options.h"
+#include "carrier_cache.h"
+#include "pool.h"
+#include "stego_header.h"
+#include "types.h"
+
+/* Function Definitions */
+
+static Status parse_int(const char *flag, const char *value, int min, int max, int *out)
+{
+    char *end;
+    long n;
+
+    if (value == NULL)
+    {
+        printf("ERROR: %s needs a value.\n", flag);
+        return e_failure;
+    }
+
+    n = strtol(value, &end, 10);
+    if (*end != '\0' || n < min || n > max)
+    {
+        printf("ERROR: Invalid value for %s: %s\n", flag, value);
+        return e_failure;
+    }
+
+    *out = (int)n;
+    return e_success;
+}
+
+Status parse_options(int *argc, char *argv[], StegoOptions *opts)
+{
+    opts->threads = pool_default_threads();
+    opts->depth = 1;
+    opts->codec = STEGO_CODEC_NONE;
+    opts->checksum = 1;
+    opts->scatter = 0;
+    opts->key = NULL;
+    opts->key_file = NULL;
+    opts->shards = NULL;
+    opts->uring = 1;
+    opts->cache_mb = CARRIER_CACHE_MB;
+    opts->stats = STATS_OFF;
+
+    int out = 2; // argv[0] and the operation flag are kept as is
+    for (int i = 2; i < *argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0)
+        {
+            if (parse_int(argv[i], argv[i + 1], 1, 1024, &opts->threads) != e_success)
+                return e_failure;
+            i++;
+        }
+        else if (strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "--depth") == 0)
+        {
+            if (argv[i + 1] != NULL && strcmp(argv[i + 1], "auto") == 0)
+                opts->depth = STEGO_DEPTH_AUTO;
+            else if (parse_int(argv[i], argv[i + 1], 1, STEGO_MAX_DEPTH, &opts->depth) != e_success)
+                return e_failure;
+            i++;
+        }
+        else if (strcmp(argv[i], "-z") == 0 || strcmp(argv[i], "--compress") == 0)
+        {
+            opts->codec = STEGO_CODEC_LZ;
+        }
+        else if (strcmp(argv[i], "--no-crc") == 0)
+        {
+            opts->checksum = 0;
+        }
+        else if (strcmp(argv[i], "--scatter") == 0)
+        {
+            opts->scatter = 1;
+        }
+        else if (strcmp(argv[i], "--key") == 0)
+        {
+            if (argv[i + 1] == NULL || argv[i + 1][0] == '\0')
+            {
+                printf("ERROR: --key needs a passphrase.\n");
+                return e_failure;
+            }
+            opts->key = argv[++i];
+            opts->scatter = 1;
+        }
+        else if (strcmp(argv[i], "--encrypt") == 0)
+        {
+            if (argv[i + 1] == NULL || argv[i + 1][0] == '\0')
+            {
+                printf("ERROR: --encrypt needs a key file.\n");
+                return e_failure;
+            }
+            opts->key_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--shards") == 0)
+        {
+            if (argv[i + 1] == NULL || argv[i + 1][0] == '\0')
+            {
+                printf("ERROR: --shards needs a list file.\n");
+                return e_failure;
+            }
+            opts->shards = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-uring") == 0)
+        {
+            opts->uring = 0;
+        }
+        else if (strcmp(argv[i], "--cache-mb") == 0)
+        {
+            if (parse_int(argv[i], argv[i + 1], 0, 1 << 20, &opts->cache_mb) != e_success)
+                return e_failure;
+            i++;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            if (argv[i + 1] != NULL && strcmp(argv[i + 1], "json") == 0)
+                opts->stats = STATS_JSON;
+            else if (argv[i + 1] != NULL && strcmp(argv[i + 1], "prometheus") == 0)
+                opts->stats = STATS_PROMETHEUS;
+            else
+            {
+                printf("ERROR: --stats needs json or prometheus.\n");
+                return e_failure;
+            }
+            i++;
+        }
+        else
+        {
+            argv[out++] = argv[i]; // Positional argument
+        }
+    }
+
+    *argc = out;
+    argv[out] = NULL;
+    return e_success;
+}
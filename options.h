@@ -0,0 +1,43 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "stats.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Optional flags accepted anywhere after the operation flag.
+ * They are removed from argv so the positional argument checks
+ * (read_and_validate_*_args) see the usual argument counts.
+ *
+ *   -j N, --threads N   Worker threads for one large image
+ *   -k N, --depth N     Payload bits per colour channel, 1-4 or "auto"
+ *   -z, --compress      Compress the secret before embedding
+ *   --no-crc            Leave out the header and payload checksums
+ *   --scatter           Spread the payload over the image in keyed order
+ *   --key PASS          Scatter key (implies --scatter on encode; default: the magic string)
+ *   --encrypt FILE      Encrypt and authenticate the payload with the key in FILE (aead.h)
+ *   --shards LIST       Encode/decode: split the secret over the images in LIST (shard.h)
+ *   --no-uring          Batch mode: blocking I/O even where io_uring works
+ *   --cache-mb N        Batch and daemon modes: carrier cache budget (0: off)
+ *   --stats FORMAT      Print stage counters to stderr ("json" or "prometheus")
+ */
+
+typedef struct _StegoOptions
+{
+    int threads; // Threads used to stripe one image (1 = serial)
+    int depth;   // LSBs per channel used by encode (STEGO_DEPTH_AUTO: smallest that fits)
+    int codec;   // STEGO_CODEC_* applied to the secret by encode
+    int checksum; // Header and payload CRC32C written by encode
+    int scatter;  // Payload stored in keyed blocks by encode
+    const char *key; // Scatter passphrase (NULL: the magic string)
+    const char *key_file; // Encryption key file (NULL: payload in clear)
+    const char *shards;   // Shard list (NULL: one carrier given on the command line)
+    int uring;    // Batch I/O through io_uring when the kernel allows it
+    int cache_mb; // Carrier cache budget of batch and daemon modes (0: no cache)
+    StatsFormat stats; // Stage counter report (STATS_OFF: hooks disabled)
+} StegoOptions;
+
+/* Fill opts with defaults, then consume recognised flags from argv */
+Status parse_options(int *argc, char *argv[], StegoOptions *opts);
+
+#endif
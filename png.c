@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "png.h"
+#include "carrier.h"
+#include "flate.h"
+#include "types.h"
+
+#define PNG_CHUNK_MAX 0x7FFFFFFFu // Largest chunk length allowed by the format
+
+static const uchar png_signature[PNG_SIGNATURE_SIZE] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+/* Function Definitions */
+
+static uint get_be32(const uchar *p)
+{
+    return ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | p[3];
+}
+
+static void put_be32(uchar *p, uint value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static void crc_table(uint *table)
+{
+    // CRC-32 (polynomial 0xEDB88320) used by PNG chunks
+    for (uint n = 0; n < 256; n++)
+    {
+        uint c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+}
+
+static uint chunk_crc(const uint *table, const uchar *type, const uchar *data, size_t len)
+{
+    uint crc = 0xFFFFFFFFu;
+    for (int i = 0; i < 4; i++)
+        crc = table[(crc ^ type[i]) & 0xFF] ^ (crc >> 8);
+    for (size_t i = 0; i < len; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint channels_of(uint colour_type)
+{
+    // Grey, RGB, grey + alpha, RGBA (palette images are not supported)
+    switch (colour_type)
+    {
+    case 0:
+        return 1;
+    case 2:
+        return 3;
+    case 4:
+        return 2;
+    case 6:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+const char *check_png_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    if (len < PNG_HEADER_SIZE)
+        return carrier_short;
+    if (memcmp(buf, png_signature, PNG_SIGNATURE_SIZE) != 0)
+        return "Not a PNG image.";
+
+    uint table[256];
+    crc_table(table);
+    const uchar *ihdr = buf + PNG_SIGNATURE_SIZE;
+    if (get_be32(ihdr) != 13 || memcmp(ihdr + 4, "IHDR", 4) != 0 || chunk_crc(table, ihdr + 4, ihdr + 8, 13) != get_be32(ihdr + 21))
+        return "Corrupt PNG header.";
+
+    uint width = get_be32(ihdr + 8);
+    uint height = get_be32(ihdr + 12);
+    uint channels = channels_of(ihdr[17]);
+    if (ihdr[16] != 8 || channels == 0 || ihdr[18] != 0 || ihdr[19] != 0 || ihdr[20] != 0)
+        return "Unsupported PNG format (only 8-bit grey or RGB, optional alpha, not interlaced).";
+    if (width == 0 || height == 0 || width > PNG_CHUNK_MAX / channels - 1 || height > PNG_CHUNK_MAX)
+        return "Corrupt PNG header.";
+
+    // Pixels live in a buffer of their own once loaded: no header, no padding
+    layout->data_offset = 0;
+    layout->width = width;
+    layout->height = height;
+    layout->top_down = 1;
+    layout->bpp = 8 * channels;
+    layout->row_bytes = width * channels;
+    layout->row_stride = layout->row_bytes;
+    layout->pixel_bytes = (size_t)layout->row_bytes * height;
+    layout->image_end = layout->pixel_bytes;
+    return NULL;
+}
+
+static const char *gather_idat(const uchar *file, size_t len, int partial, uchar **idat, size_t *idat_len)
+{
+    // The zlib stream may be split over any number of IDAT chunks: join their data
+    uint table[256];
+    crc_table(table);
+    size_t total = 0;
+    int pass_end = 0;
+    *idat = NULL;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        size_t pos = PNG_SIGNATURE_SIZE;
+        size_t got = 0;
+        pass_end = 0;
+        while (pos + 8 <= len)
+        {
+            size_t n = get_be32(file + pos);
+            const uchar *type = file + pos + 4;
+            const uchar *data = file + pos + 8;
+            if (n > PNG_CHUNK_MAX)
+                break;
+            if (n + 4 > len - pos - 8)
+            {
+                // Cut short: only a partial load may use what there is
+                if (partial && memcmp(type, "IDAT", 4) == 0)
+                {
+                    size_t avail = len - pos - 8;
+                    if (pass == 1)
+                        memcpy(*idat + got, data, avail);
+                    got += avail;
+                }
+                break;
+            }
+            if (pass == 0 && !partial && chunk_crc(table, type, data, n) != get_be32(data + n))
+                return "Corrupt PNG chunk.";
+
+            if (memcmp(type, "IDAT", 4) == 0)
+            {
+                if (pass == 1)
+                    memcpy(*idat + got, data, n);
+                got += n;
+            }
+            pos += n + 12;
+            if (memcmp(type, "IEND", 4) == 0)
+            {
+                pass_end = 1;
+                break;
+            }
+        }
+
+        if (pass == 0)
+        {
+            if (!pass_end && !partial)
+                return "Truncated PNG image.";
+            total = got;
+            if ((*idat = malloc(total > 0 ? total : 1)) == NULL)
+                return "Unable to allocate PNG image data.";
+        }
+    }
+    *idat_len = total;
+    return NULL;
+}
+
+static uint paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+static Status unfilter_row(uchar *row, const uchar *filtered, const uchar *prior, size_t n, uint bpp, uint filter)
+{
+    // row may overlap filtered as long as it starts before it (each byte is read before it is overwritten)
+    switch (filter)
+    {
+    case 0:
+        memmove(row, filtered, n);
+        break;
+    case 1:
+        for (size_t i = 0; i < n; i++)
+            row[i] = filtered[i] + (i >= bpp ? row[i - bpp] : 0);
+        break;
+    case 2:
+        for (size_t i = 0; i < n; i++)
+            row[i] = filtered[i] + (prior ? prior[i] : 0);
+        break;
+    case 3:
+        for (size_t i = 0; i < n; i++)
+            row[i] = filtered[i] + (((i >= bpp ? row[i - bpp] : 0) + (prior ? prior[i] : 0)) >> 1);
+        break;
+    case 4:
+        for (size_t i = 0; i < n; i++)
+            row[i] = filtered[i] + paeth(i >= bpp ? row[i - bpp] : 0, prior ? prior[i] : 0,
+                                         i >= bpp && prior ? prior[i - bpp] : 0);
+        break;
+    default:
+        return e_failure;
+    }
+    return e_success;
+}
+
+const char *load_png(const uchar *file, size_t len, const BmpInfo *layout, int partial, uchar **pixels, size_t *pixels_len)
+{
+    uchar *idat;
+    size_t idat_len;
+    const char *error = gather_idat(file, len, partial, &idat, &idat_len);
+    if (error != NULL)
+        return error;
+
+    // A partial load stops after the rows that hold CARRIER_PEEK_BYTES pixel bytes
+    size_t row_bytes = layout->row_bytes;
+    size_t rows = layout->height;
+    if (partial && rows > CARRIER_PEEK_BYTES / row_bytes + 1)
+        rows = CARRIER_PEEK_BYTES / row_bytes + 1;
+
+    size_t raw_len = rows * (row_bytes + 1), got;
+    uchar *raw = malloc(raw_len);
+    if (raw == NULL)
+    {
+        free(idat);
+        return "Unable to allocate PNG pixels.";
+    }
+
+    Status status = flate_decompress(idat, idat_len, raw, raw_len, &got, partial);
+    free(idat);
+    if (status != e_success || (!partial && got != raw_len))
+    {
+        free(raw);
+        return "Corrupt PNG image data.";
+    }
+
+    // Unfilter in place: row r moves down to r * row_bytes, dropping its filter byte
+    rows = got / (row_bytes + 1);
+    uint bpp = layout->bpp / 8;
+    for (size_t r = 0; r < rows; r++)
+    {
+        uchar *row = raw + r * row_bytes;
+        const uchar *filtered = raw + r * (row_bytes + 1);
+        if (unfilter_row(row, filtered + 1, r > 0 ? row - row_bytes : NULL, row_bytes, bpp, filtered[0]) != e_success)
+        {
+            free(raw);
+            return "Corrupt PNG image data.";
+        }
+    }
+
+    *pixels = raw;
+    *pixels_len = rows * row_bytes;
+    return NULL;
+}
+
+static size_t filter_row(uchar *out, const uchar *row, const uchar *prior, size_t n, uint bpp, uint filter)
+{
+    // Filter one row into out; returns the sum of the absolute (signed) filtered bytes
+    size_t cost = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint a = i >= bpp ? row[i - bpp] : 0;
+        uint b = prior ? prior[i] : 0;
+        uint c = i >= bpp && prior ? prior[i - bpp] : 0;
+        uint pred = filter == 1 ? a : filter == 2 ? b : filter == 3 ? (a + b) >> 1 : filter == 4 ? paeth(a, b, c) : 0;
+        uchar v = row[i] - pred;
+        out[i] = v;
+        cost += v < 128 ? v : 256 - v;
+    }
+    return cost;
+}
+
+static Status write_chunk(FILE *fptr, const uint *table, const char *type, const uchar *data, size_t len)
+{
+    uchar head[8], tail[4];
+    put_be32(head, len);
+    memcpy(head + 4, type, 4);
+    put_be32(tail, chunk_crc(table, head + 4, data, len));
+    if (fwrite(head, 1, 8, fptr) != 8 || fwrite(data, 1, len, fptr) != len || fwrite(tail, 1, 4, fptr) != 4)
+        return e_failure;
+    return e_success;
+}
+
+Status store_png(const uchar *file, size_t len, const BmpInfo *layout, const uchar *pixels, FILE *fptr)
+{
+    // Filter every row with whichever PNG filter leaves the smallest values, then deflate them all
+    size_t row_bytes = layout->row_bytes;
+    size_t raw_len = (size_t)layout->height * (row_bytes + 1);
+    uint bpp = layout->bpp / 8;
+    uchar *raw = malloc(raw_len);
+    uchar *packed = malloc(FLATE_BOUND(raw_len));
+    uchar *trial = malloc(row_bytes);
+    if (raw == NULL || packed == NULL || trial == NULL)
+    {
+        printf("ERROR: Unable to allocate PNG image data.\n");
+        free(raw);
+        free(packed);
+        free(trial);
+        return e_failure;
+    }
+
+    for (size_t r = 0; r < layout->height; r++)
+    {
+        const uchar *row = pixels + r * row_bytes;
+        const uchar *prior = r > 0 ? row - row_bytes : NULL;
+        uchar *out = raw + r * (row_bytes + 1);
+        size_t best = filter_row(out + 1, row, prior, row_bytes, bpp, 0);
+        out[0] = 0;
+        for (uint filter = 1; filter <= 4; filter++)
+        {
+            size_t cost = filter_row(trial, row, prior, row_bytes, bpp, filter);
+            if (cost < best)
+            {
+                best = cost;
+                out[0] = filter;
+                memcpy(out + 1, trial, row_bytes);
+            }
+        }
+    }
+    free(trial);
+
+    size_t packed_len = flate_compress(raw, raw_len, packed);
+    free(raw);
+    if (packed_len == 0)
+    {
+        printf("ERROR: Unable to compress PNG image data.\n");
+        free(packed);
+        return e_failure;
+    }
+
+    // Original chunks in order; the new image data goes where the first IDAT was
+    uint table[256];
+    crc_table(table);
+    Status status = fwrite(png_signature, 1, PNG_SIGNATURE_SIZE, fptr) == PNG_SIGNATURE_SIZE ? e_success : e_failure;
+    int written = 0;
+    size_t pos = PNG_SIGNATURE_SIZE;
+    while (status == e_success && pos + 12 <= len)
+    {
+        size_t n = get_be32(file + pos);
+        const uchar *type = file + pos + 4;
+        if (n > len - pos - 12)
+            break;
+        if (memcmp(type, "IDAT", 4) != 0)
+        {
+            if (fwrite(file + pos, 1, n + 12, fptr) != n + 12)
+                status = e_failure;
+        }
+        else if (!written)
+        {
+            for (size_t done = 0; status == e_success && done < packed_len; done += PNG_IDAT_MAX)
+            {
+                size_t take = packed_len - done < PNG_IDAT_MAX ? packed_len - done : PNG_IDAT_MAX;
+                status = write_chunk(fptr, table, "IDAT", packed + done, take);
+            }
+            written = 1;
+        }
+        pos += n + 12;
+        if (memcmp(type, "IEND", 4) == 0)
+            break;
+    }
+    free(packed);
+
+    if (status != e_success)
+        printf("ERROR: Unable to write PNG image.\n");
+    return status;
+}
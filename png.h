@@ -0,0 +1,34 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "bmp.h"
+#include "types.h"
+
+/*
+ * PNG carriers: 8-bit greyscale, grey + alpha, RGB and RGBA images,
+ * not interlaced. The IDAT stream is inflated and unfiltered into a
+ * pixel buffer (rows of width * channels bytes, top row first), which
+ * the engines use like a mapped raw image.
+ *
+ * Storing filters each row with the PNG filter that gives the smallest
+ * sum of absolute differences, deflates the rows (flate.c) and writes
+ * the original file with its IDAT chunks replaced by the new ones, at
+ * the place of the first. Every other chunk is copied as it is.
+ */
+
+#define PNG_SIGNATURE_SIZE 8
+#define PNG_HEADER_SIZE 33          // Signature and IHDR chunk
+#define PNG_IDAT_MAX (1024 * 1024) // Data bytes per IDAT chunk written
+
+/* Read the signature and IHDR in buf into layout; returns why they are rejected, carrier_short if more bytes are needed, NULL if usable */
+const char *check_png_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+/* Inflate and unfilter the pixels of a PNG file (partial: the first rows of a file that may be cut short); returns why it fails, NULL on success */
+const char *load_png(const uchar *file, size_t len, const BmpInfo *layout, int partial, uchar **pixels, size_t *pixels_len);
+
+/* Write the PNG file again with its image data replaced by pixels */
+Status store_png(const uchar *file, size_t len, const BmpInfo *layout, const uchar *pixels, FILE *fptr);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stddef.h>
+#include "pnm.h"
+#include "carrier.h"
+#include "types.h"
+
+/* Function Definitions */
+
+static int is_space(uchar c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static const char *read_field(const uchar *buf, size_t len, size_t *pos, uint *value)
+{
+    // Skip whitespace and comments, then read a decimal number that is followed by whitespace
+    size_t i = *pos;
+    for (;;)
+    {
+        if (i >= len)
+            return carrier_short;
+        if (buf[i] == '#')
+        {
+            while (i < len && buf[i] != '\n' && buf[i] != '\r')
+                i++;
+        }
+        else if (is_space(buf[i]))
+        {
+            i++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (buf[i] < '0' || buf[i] > '9')
+        return "Corrupt PPM/PGM header.";
+    unsigned long long n = 0;
+    for (; i < len && buf[i] >= '0' && buf[i] <= '9'; i++)
+    {
+        n = n * 10 + (buf[i] - '0');
+        if (n > 0x7FFFFFFF)
+            return "Corrupt PPM/PGM header.";
+    }
+    if (i >= len)
+        return carrier_short; // More digits may follow
+    if (!is_space(buf[i]))
+        return "Corrupt PPM/PGM header.";
+
+    *value = n;
+    *pos = i;
+    return NULL;
+}
+
+const char *check_pnm_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    if (len < 2)
+        return carrier_short;
+    if (buf[0] != 'P' || (buf[1] != '5' && buf[1] != '6'))
+        return "Not a PPM/PGM image.";
+
+    uint channels = buf[1] == '6' ? 3 : 1;
+    uint maxval;
+    size_t pos = 2;
+    const char *error;
+    if ((error = read_field(buf, len, &pos, &layout->width)) != NULL ||
+        (error = read_field(buf, len, &pos, &layout->height)) != NULL ||
+        (error = read_field(buf, len, &pos, &maxval)) != NULL)
+        return error;
+
+    if (maxval != PNM_MAXVAL)
+        return "Unsupported PPM/PGM format (only binary P5/P6 with maxval 255).";
+    if (layout->width == 0 || layout->height == 0 || layout->width > 0x7FFFFFFF / channels)
+        return "Corrupt PPM/PGM header.";
+
+    // Exactly one whitespace byte separates maxval from the raster
+    layout->data_offset = pos + 1;
+    layout->bpp = 8 * channels;
+    layout->row_bytes = layout->width * channels;
+    layout->row_stride = layout->row_bytes;
+    layout->top_down = 1;
+    layout->pixel_bytes = (size_t)layout->row_bytes * layout->height;
+    layout->image_end = layout->data_offset + layout->pixel_bytes;
+    return NULL;
+}
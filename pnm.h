@@ -0,0 +1,23 @@
+#ifndef PNM_H
+#define PNM_H
+
+#include <stddef.h>
+#include "bmp.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Binary PPM (P6, RGB) and PGM (P5, grey) carriers. The header is
+ * text: magic, width, height and maxval separated by whitespace or
+ * '#' comments, then one whitespace byte before the raster. Rows are
+ * width * channels bytes with no padding.
+ *
+ * Only maxval 255 is accepted: with a smaller maxval, setting low bits
+ * could produce samples above it.
+ */
+
+#define PNM_MAXVAL 255
+
+/* Read a P5/P6 header in buf into layout; returns why it is rejected, carrier_short if more bytes are needed, NULL if usable */
+const char *check_pnm_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+#endif
@@ -0,0 +1,266 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+#include "types.h"
+
+typedef struct
+{
+    pool_task_fn fn;
+    void *arg;
+} PoolTask;
+
+/* Growable ring of tasks; owner pops the tail, thieves take the head */
+typedef struct
+{
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    size_t cap;
+    size_t head;
+    size_t count;
+} TaskDeque;
+
+typedef struct
+{
+    ThreadPool *pool;
+    int index;
+} WorkerArg;
+
+struct _ThreadPool
+{
+    int nthreads;
+    pthread_t *threads;
+    WorkerArg *args;
+    TaskDeque *deques;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond; // Signalled when tasks are queued or on stop
+    pthread_cond_t done_cond; // Signalled when pending drops to zero
+    size_t queued;            // Tasks sitting in deques
+    size_t pending;           // Tasks submitted but not finished
+    size_t next;              // Round-robin submit cursor
+    int stop;
+};
+
+/* Function Definitions */
+
+static Status deque_push(TaskDeque *dq, PoolTask task)
+{
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count == dq->cap)
+    {
+        // Grow and unwrap the ring
+        size_t cap = dq->cap ? 2 * dq->cap : 64;
+        PoolTask *tasks = malloc(cap * sizeof(PoolTask));
+        if (tasks == NULL)
+        {
+            pthread_mutex_unlock(&dq->lock);
+            return e_failure;
+        }
+        for (size_t i = 0; i < dq->count; i++)
+            tasks[i] = dq->tasks[(dq->head + i) % dq->cap];
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->cap = cap;
+        dq->head = 0;
+    }
+    dq->tasks[(dq->head + dq->count) % dq->cap] = task;
+    dq->count++;
+    pthread_mutex_unlock(&dq->lock);
+    return e_success;
+}
+
+static int deque_pop_tail(TaskDeque *dq, PoolTask *task)
+{
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0)
+    {
+        dq->count--;
+        *task = dq->tasks[(dq->head + dq->count) % dq->cap];
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static int deque_steal_head(TaskDeque *dq, PoolTask *task)
+{
+    int found = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0)
+    {
+        *task = dq->tasks[dq->head];
+        dq->head = (dq->head + 1) % dq->cap;
+        dq->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static int take_task(ThreadPool *pool, int self, PoolTask *task)
+{
+    // Own deque first, then steal from the others
+    int found = deque_pop_tail(&pool->deques[self], task);
+    for (int i = 1; !found && i < pool->nthreads; i++)
+        found = deque_steal_head(&pool->deques[(self + i) % pool->nthreads], task);
+
+    if (found)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+static void *worker_main(void *p)
+{
+    WorkerArg *warg = p;
+    ThreadPool *pool = warg->pool;
+    PoolTask task;
+
+    for (;;)
+    {
+        if (take_task(pool, warg->index, &task))
+        {
+            task.fn(task.arg, warg->index);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+                pthread_cond_broadcast(&pool->done_cond);
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // Nothing to run or steal: sleep until more work or shutdown
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stop)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        int done = pool->stop && pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done)
+            break;
+    }
+
+    return NULL;
+}
+
+ThreadPool *pool_create(int nthreads)
+{
+    if (nthreads < 1)
+        nthreads = 1;
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->nthreads = nthreads;
+    pool->threads = calloc(nthreads, sizeof(pthread_t));
+    pool->args = calloc(nthreads, sizeof(WorkerArg));
+    pool->deques = calloc(nthreads, sizeof(TaskDeque));
+    if (pool->threads == NULL || pool->args == NULL || pool->deques == NULL)
+    {
+        free(pool->threads);
+        free(pool->args);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    for (int i = 0; i < nthreads; i++)
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+    for (int i = 0; i < nthreads; i++)
+    {
+        pool->args[i].pool = pool;
+        pool->args[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0)
+        {
+            // Run with the workers that did start
+            pool->nthreads = i;
+            break;
+        }
+    }
+
+    if (pool->nthreads == 0)
+    {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+Status pool_submit(ThreadPool *pool, pool_task_fn fn, void *arg)
+{
+    PoolTask task = {fn, arg};
+
+    // Count the task before it becomes visible so take_task never underflows
+    pthread_mutex_lock(&pool->lock);
+    int target = pool->next++ % pool->nthreads;
+    pool->pending++;
+    pool->queued++;
+    pthread_mutex_unlock(&pool->lock);
+
+    Status status = deque_push(&pool->deques[target], task);
+
+    pthread_mutex_lock(&pool->lock);
+    if (status != e_success)
+    {
+        pool->queued--;
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->done_cond);
+    }
+    else
+    {
+        pthread_cond_signal(&pool->work_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return status;
+}
+
+void pool_wait(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(ThreadPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    for (int i = 0; i < pool->nthreads; i++)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->threads);
+    free(pool->args);
+    free(pool->deques);
+    free(pool);
+}
+
+int pool_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
@@ -0,0 +1,32 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * Fixed-size worker pool with per-worker task deques.
+ * Each worker runs its own tasks newest first and steals
+ * the oldest task from another worker when it runs dry.
+ */
+
+/* Task entry point; worker is the index of the running thread */
+typedef void (*pool_task_fn)(void *arg, int worker);
+
+typedef struct _ThreadPool ThreadPool;
+
+/* Start a pool of nthreads workers (at least 1) */
+ThreadPool *pool_create(int nthreads);
+
+/* Queue a task on the next worker's deque */
+Status pool_submit(ThreadPool *pool, pool_task_fn fn, void *arg);
+
+/* Block until every submitted task has finished */
+void pool_wait(ThreadPool *pool);
+
+/* Stop the workers and free the pool */
+void pool_destroy(ThreadPool *pool);
+
+/* Number of online CPUs (at least 1) */
+int pool_default_threads(void);
+
+#endif
@@ -0,0 +1,342 @@
+#define _GNU_SOURCE // DT_DIR, posix_fadvise
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scan.h"
+#include "bmp.h"
+#include "carrier.h"
+#include "decode.h"
+#include "pool.h"
+#include "stego_header.h"
+#include "types.h"
+
+typedef struct _ScanCtx ScanCtx;
+
+typedef struct
+{
+    ScanCtx *ctx;
+    int count;
+    char *paths[SCAN_CHUNK];
+} ScanChunk;
+
+/* State owned by one worker thread and reused for all of its images */
+typedef struct
+{
+    uchar *buf;        // SCAN_READ bytes, SCAN_ALIGN aligned
+    DecodeInfo decInfo;
+    StegoStats stats;  // Counters of this worker's images (merged at the end)
+    unsigned long images;
+    unsigned long found;
+    unsigned long unreadable;
+} ScanWorker;
+
+struct _ScanCtx
+{
+    ScanWorker *workers;
+    const char *magic;
+    int record_stats; // Fill each worker's stats
+    ThreadPool *pool;
+    ScanChunk *chunk; // Chunk being filled by the walker
+};
+
+/* Function Definitions */
+
+static int open_ahead(const char *path)
+{
+    // Open the next image and let the kernel start reading its first block
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0)
+        posix_fadvise(fd, 0, SCAN_READ, POSIX_FADV_WILLNEED);
+    return fd;
+}
+
+static ssize_t read_start(int fd, uchar *buf, size_t size)
+{
+    // Short reads only happen at end of file
+    size_t got = 0;
+    while (got < size)
+    {
+        ssize_t n = pread(fd, buf + got, size - got, got);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        got += n;
+    }
+    return got;
+}
+
+static void print_found(const char *path, const DecodeInfo *decInfo)
+{
+    char size[24], stored[24], shard[32] = "";
+    if (decInfo->size_out_file == FRAMED_OUT_SIZE)
+    {
+        strcpy(size, "framed");
+        strcpy(stored, "framed");
+    }
+    else
+    {
+        sprintf(size, "%ld", decInfo->size_raw_out_file);
+        sprintf(stored, "%ld", decInfo->size_out_file);
+    }
+
+    if (decInfo->shard.count > 0)
+        sprintf(shard, " shard=%u/%u", decInfo->shard.index + 1, decInfo->shard.count);
+
+    // One printf per line keeps lines from different workers whole
+    printf("FOUND %s size=%s stored=%s extn=%s depth=%u codec=%s crc=%s%s\n", path, size, stored,
+           decInfo->extn_out_file, decInfo->depth, decInfo->codec == STEGO_CODEC_LZ ? "lz" : "none",
+           decInfo->checksum ? "yes" : "no", shard);
+}
+
+static Status scan_image(ScanWorker *state, const char *magic, int fd, StegoStats *stats)
+{
+    DecodeInfo *decInfo = &state->decInfo;
+    uchar *buf = state->buf;
+    uchar *big = NULL;
+
+    STATS_BEGIN(stats, STAGE_OPEN);
+    ssize_t got = read_start(fd, buf, SCAN_READ);
+    STATS_IO(stats, got > 0 ? got : 0, 0, 1);
+
+    // Pixels far behind a large gap: read up to the first pixel plus the header window
+    BmpInfo bmp;
+    if (got == SCAN_READ && probe_carrier_header(buf, got, &bmp) == e_success && bmp.data_offset > SCAN_READ / 2 &&
+        bmp.data_offset <= SCAN_MAX_HEADER && (big = malloc(bmp.data_offset + SCAN_READ / 2)) != NULL)
+    {
+        got = read_start(fd, big, bmp.data_offset + SCAN_READ / 2);
+        STATS_IO(stats, got > 0 ? got : 0, 0, 1);
+        buf = big;
+    }
+    STATS_END(stats);
+
+    if (got <= 0)
+    {
+        state->unreadable++;
+        free(big);
+        return e_failure;
+    }
+
+    // Decode the header fields from the bytes read; nothing is printed for rejected images
+    memset(decInfo, 0, sizeof(DecodeInfo));
+    strcpy(decInfo->usr_migc_str, magic);
+    decInfo->size_usr_migc_str = strlen(magic);
+    decInfo->inp_map = buf;
+    decInfo->map_size = got;
+    decInfo->threads = 1;
+    decInfo->stats = stats;
+    decInfo->header_only = 1;
+    decInfo->quiet = 1;
+
+    Status status = decode_stego_header(decInfo);
+    release_stego_pixels(decInfo);
+    free(big);
+    return status;
+}
+
+static void run_scan_chunk(void *arg, int worker)
+{
+    ScanChunk *chunk = arg;
+    ScanCtx *ctx = chunk->ctx;
+    ScanWorker *state = &ctx->workers[worker];
+    StegoStats *stats = ctx->record_stats ? &state->stats : NULL;
+
+    int fd = open_ahead(chunk->paths[0]);
+    for (int i = 0; i < chunk->count; i++)
+    {
+        // Read-ahead for the next image overlaps the check of this one
+        int next = (i + 1 < chunk->count) ? open_ahead(chunk->paths[i + 1]) : -1;
+
+        state->images++;
+        if (fd < 0)
+            state->unreadable++;
+        else if (scan_image(state, ctx->magic, fd, stats) == e_success)
+        {
+            state->found++;
+            print_found(chunk->paths[i], &state->decInfo);
+        }
+
+        if (fd >= 0)
+            close(fd);
+        fd = next;
+        free(chunk->paths[i]);
+    }
+
+    free(chunk);
+}
+
+static Status flush_chunk(ScanCtx *ctx)
+{
+    ScanChunk *chunk = ctx->chunk;
+    ctx->chunk = NULL;
+    if (chunk == NULL || chunk->count == 0)
+    {
+        free(chunk);
+        return e_success;
+    }
+
+    if (pool_submit(ctx->pool, run_scan_chunk, chunk) != e_success)
+    {
+        for (int i = 0; i < chunk->count; i++)
+            free(chunk->paths[i]);
+        free(chunk);
+        return e_failure;
+    }
+    return e_success;
+}
+
+static Status add_path(ScanCtx *ctx, const char *path)
+{
+    if (ctx->chunk == NULL && (ctx->chunk = calloc(1, sizeof(ScanChunk))) == NULL)
+        return e_failure;
+
+    char *copy = strdup(path);
+    if (copy == NULL)
+        return e_failure;
+
+    ctx->chunk->ctx = ctx;
+    ctx->chunk->paths[ctx->chunk->count++] = copy;
+    if (ctx->chunk->count == SCAN_CHUNK)
+        return flush_chunk(ctx);
+    return e_success;
+}
+
+static Status walk_dir(ScanCtx *ctx, const char *dir)
+{
+    DIR *dp = opendir(dir);
+    if (dp == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open directory %s\n", dir);
+        return e_success; // Skip it, keep scanning the rest
+    }
+
+    Status status = e_success;
+    char path[4096];
+    struct dirent *ent;
+    while (status == e_success && (ent = readdir(dp)) != NULL)
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path))
+            continue; // Path too long
+
+        // d_type saves a stat per entry where the file system fills it in
+        int is_dir = ent->d_type == DT_DIR;
+        int is_file = ent->d_type == DT_REG;
+        struct stat st;
+        if (ent->d_type == DT_UNKNOWN && lstat(path, &st) == 0)
+        {
+            is_dir = S_ISDIR(st.st_mode);
+            is_file = S_ISREG(st.st_mode);
+        }
+
+        if (is_dir)
+            status = walk_dir(ctx, path);
+        else if (is_file && is_carrier_name(ent->d_name))
+            status = add_path(ctx, path);
+    }
+
+    closedir(dp);
+    return status;
+}
+
+static Status read_list(ScanCtx *ctx, FILE *fptr)
+{
+    // One path per line; blank lines are skipped
+    char line[4096];
+    while (fgets(line, sizeof(line), fptr) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && add_path(ctx, line) != e_success)
+            return e_failure;
+    }
+    return e_success;
+}
+
+static Status collect_paths(ScanCtx *ctx, const char *source)
+{
+    struct stat st;
+    if (strcmp(source, "-") == 0)
+        return read_list(ctx, stdin);
+
+    if (stat(source, &st) != 0)
+    {
+        perror("stat");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", source);
+        return e_failure;
+    }
+    if (S_ISDIR(st.st_mode))
+        return walk_dir(ctx, source);
+
+    FILE *fptr = fopen(source, "r");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", source);
+        return e_failure;
+    }
+    Status status = read_list(ctx, fptr);
+    fclose(fptr);
+    return status;
+}
+
+Status do_scan(const char *source, const char *magic, int nthreads, StegoStats *stats)
+{
+    ScanCtx ctx = {0};
+    ctx.magic = magic;
+    ctx.record_stats = stats != NULL;
+
+    if (strlen(magic) >= sizeof(ctx.workers->decInfo.usr_migc_str))
+    {
+        printf("ERROR: Magic string too long.\n");
+        return e_failure;
+    }
+
+    ctx.workers = calloc(nthreads, sizeof(ScanWorker));
+    if (ctx.workers == NULL)
+        return e_failure;
+
+    Status status = e_success;
+    for (int i = 0; i < nthreads && status == e_success; i++)
+    {
+        if (posix_memalign((void **)&ctx.workers[i].buf, SCAN_ALIGN, SCAN_READ) != 0)
+            status = e_failure;
+    }
+
+    // Workers start on the first chunks while the walk goes on
+    if (status == e_success && (ctx.pool = pool_create(nthreads)) == NULL)
+        status = e_failure;
+    if (status == e_success)
+        status = collect_paths(&ctx, source);
+    if (status == e_success)
+        status = flush_chunk(&ctx);
+    else
+        flush_chunk(&ctx); // Scan what was queued before the error
+
+    if (ctx.pool != NULL)
+    {
+        pool_wait(ctx.pool);
+        pool_destroy(ctx.pool);
+    }
+
+    // Workers count without locks; add them up once all images are done
+    unsigned long images = 0, found = 0, unreadable = 0;
+    for (int i = 0; i < nthreads; i++)
+    {
+        images += ctx.workers[i].images;
+        found += ctx.workers[i].found;
+        unreadable += ctx.workers[i].unreadable;
+        if (stats != NULL)
+            stats_merge(stats, &ctx.workers[i].stats);
+        free(ctx.workers[i].buf);
+    }
+    free(ctx.workers);
+
+    printf("Scan: %lu images, %lu with a payload, %lu unreadable\n", images, found, unreadable);
+    return status;
+}
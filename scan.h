@@ -0,0 +1,34 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "stats.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Scan mode: find the images that carry a payload for a magic
+ * string without extracting anything. Only the start of each image
+ * is read (one aligned SCAN_READ-byte read) and only the header
+ * fields are decoded; no output file is created.
+ *
+ * The source is a directory (walked recursively for image files of
+ * every carrier format: *.bmp, *.ppm, *.pgm, *.pnm, *.tga, *.png),
+ * a text file with one image path per line, or "-" for such a list
+ * on stdin. Paths go to the thread pool SCAN_CHUNK at a time; while
+ * a worker checks one image the kernel is already reading the next
+ * one of its chunk. A PNG is inflated only as far as the header
+ * fields reach, from the bytes of the first read.
+ *
+ * Every image with a payload is reported on one line:
+ *   FOUND <path> size=<bytes|framed> stored=<bytes|framed> extn=<.ext> depth=<n> codec=<none|lz> crc=<yes|no>
+ * followed by shard=<index>/<count> for one shard of a split payload.
+ */
+
+#define SCAN_READ (64 * 1024) // Bytes read from the start of each image
+#define SCAN_ALIGN 4096       // Alignment of the read buffers
+#define SCAN_CHUNK 64         // Paths per pool task
+#define SCAN_MAX_HEADER (16 * 1024 * 1024) // Largest bfOffBits followed when the first read is too short
+
+/* Scan every image of source on nthreads workers, adding stage counters to stats (if not NULL) */
+Status do_scan(const char *source, const char *magic, int nthreads, StegoStats *stats);
+
+#endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "scatter.h"
+#include "bmp.h"
+#include "types.h"
+
+/* Function Definitions */
+
+static unsigned long long mix64(unsigned long long x)
+{
+    // splitmix64 finaliser: every input bit reaches every output bit
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static size_t permute(const ScatterMap *map, size_t index)
+{
+    // Feistel rounds over 2 * half_bits; values past nblocks walk the cycle until they fall inside
+    unsigned long long mask = (1ULL << map->half_bits) - 1;
+    unsigned long long x = index;
+    do
+    {
+        unsigned long long left = x >> map->half_bits, right = x & mask;
+        for (int r = 0; r < SCATTER_ROUNDS; r++)
+        {
+            unsigned long long next = left ^ (mix64(right ^ map->keys[r]) & mask);
+            left = right;
+            right = next;
+        }
+        x = (left << map->half_bits) | right;
+    } while (x >= map->nblocks);
+    return x;
+}
+
+static size_t block_offset(const ScatterMap *map, size_t slot)
+{
+    size_t row = map->first_row + slot / map->blocks_per_row;
+    size_t col = slot % map->blocks_per_row;
+    return map->bmp.data_offset + row * map->bmp.row_stride + col * SCATTER_BLOCK;
+}
+
+size_t scatter_blocks(const BmpInfo *bmp, size_t header_pixels)
+{
+    // Slots start on the first row the header leaves untouched
+    size_t first_row = (header_pixels + bmp->row_bytes - 1) / bmp->row_bytes;
+    if (bmp->row_bytes < SCATTER_BLOCK || first_row >= bmp->height)
+        return 0;
+    return (bmp->height - first_row) * (bmp->row_bytes / SCATTER_BLOCK);
+}
+
+void scatter_init(ScatterMap *map, const BmpInfo *bmp, size_t header_pixels, const char *key)
+{
+    memset(map, 0, sizeof(ScatterMap));
+    map->bmp = *bmp;
+    map->first_row = (header_pixels + bmp->row_bytes - 1) / bmp->row_bytes;
+    map->blocks_per_row = bmp->row_bytes / SCATTER_BLOCK;
+    map->nblocks = scatter_blocks(bmp, header_pixels);
+
+    // Smallest even bit width that covers every slot: cycle walking then averages under 4 rounds trips
+    while (map->nblocks > 1 && (map->nblocks - 1) >> (2 * map->half_bits) != 0)
+        map->half_bits++;
+
+    // FNV-1a of the passphrase seeds the round keys
+    unsigned long long seed = 0xCBF29CE484222325ULL;
+    for (const char *p = key; *p != '\0'; p++)
+        seed = (seed ^ (uchar)*p) * 0x100000001B3ULL;
+    for (int r = 0; r < SCATTER_ROUNDS; r++)
+        map->keys[r] = mix64(seed + (r + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+void scatter_view(const ScatterMap *map, BmpInfo *view)
+{
+    *view = map->bmp;
+    // One view row per carrier row keeps every field in range however large the image
+    view->data_offset = 0;
+    view->height = map->nblocks / map->blocks_per_row;
+    view->row_bytes = view->row_stride = map->blocks_per_row * SCATTER_BLOCK;
+    view->pixel_bytes = view->image_end = map->nblocks * SCATTER_BLOCK;
+}
+
+size_t scatter_offset(const ScatterMap *map, size_t pos)
+{
+    return block_offset(map, permute(map, pos / SCATTER_BLOCK)) + pos % SCATTER_BLOCK;
+}
+
+void scatter_offsets(const ScatterMap *map, size_t first, size_t count, size_t *offsets)
+{
+    for (size_t i = 0; i < count; i++)
+        offsets[i] = block_offset(map, permute(map, first + i));
+}
@@ -0,0 +1,56 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <stddef.h>
+#include "bmp.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Keyed payload scattering. Instead of filling the pixel bytes right
+ * after the header, a scattered payload (STEGO_FLAG_SCATTER) is cut
+ * into SCATTER_BLOCK carrier bytes and block i goes to slot perm(i)
+ * of the rows after the header. perm is a keyed Feistel permutation
+ * (cycle-walked down to the number of slots), so any block index maps
+ * to its slot in a few multiplies without building a table.
+ *
+ * Blocks never cross a row: each row holds row_bytes / SCATTER_BLOCK
+ * slots, and its remaining pixel bytes stay untouched. The engines see
+ * the slots back to back (scatter_view) and translate positions with
+ * scatter_offset, computing SCATTER_BATCH slot offsets at a time so a
+ * long span is embedded as one LSB kernel call per block, with the
+ * whole batch prefetched before the first call.
+ *
+ * The key is a passphrase (the magic string by default). This hides
+ * where the payload is from sequential scans; it is not encryption.
+ */
+
+#define SCATTER_BLOCK 256 // Carrier bytes kept together (four cache lines per random access)
+#define SCATTER_BATCH 256 // Slot offsets computed per step
+#define SCATTER_ROUNDS 4  // Feistel rounds
+
+typedef struct _ScatterMap
+{
+    BmpInfo bmp;           // Layout of the real image
+    size_t first_row;      // First row (file order) after the header
+    size_t blocks_per_row; // Slots in each row
+    size_t nblocks;        // Slots in the keyed order
+    uint half_bits;        // Feistel half width (2 * half_bits >= bits of nblocks - 1)
+    unsigned long long keys[SCATTER_ROUNDS];
+} ScatterMap;
+
+/* Slots left after header_pixels pixel bytes of the header */
+size_t scatter_blocks(const BmpInfo *bmp, size_t header_pixels);
+
+/* Key the order of the slots after header_pixels with passphrase key */
+void scatter_init(ScatterMap *map, const BmpInfo *bmp, size_t header_pixels, const char *key);
+
+/* Layout the engines use while scattering: every slot back to back, one row per carrier row, no padding */
+void scatter_view(const ScatterMap *map, BmpInfo *view);
+
+/* File offset of byte pos of the scattered stream */
+size_t scatter_offset(const ScatterMap *map, size_t pos);
+
+/* File offsets of count consecutive blocks of the scattered stream, starting at block first */
+void scatter_offsets(const ScatterMap *map, size_t first, size_t count, size_t *offsets);
+
+#endif
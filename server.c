@@ -0,0 +1,663 @@
+#define _GNU_SOURCE // accept4
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "arena.h"
+#include "carrier_cache.h"
+#include "libstego.h"
+#include "pool.h"
+#include "stego_header.h"
+#include "types.h"
+
+#define SERVE_TIMEOUT_SEC 5 // A request must arrive in full within this time
+#define SERVE_EVENTS 64     // epoll events handled per wake-up
+
+typedef struct _ServeCtx ServeCtx;
+
+typedef struct
+{
+    ServeCtx *ctx;
+    int fd;
+    int slot; // Index in ctx->conns
+} ServeConn;
+
+typedef struct
+{
+    uint op;
+    uint depth;
+    uint codec;
+    uint checksum;
+    uint scatter;
+    uint fds; // SERVE_FD_* bits
+    char magic[STEGO_MAX_MAGIC + 1];
+    char extn[STEGO_MAX_EXTN + 1];
+    unsigned long long image_len;   // Inline bytes
+    unsigned long long payload_len; // Inline bytes
+} ServeRequest;
+
+/* One input of a request: inline bytes in the worker's arena, a cached carrier or a mapped descriptor */
+typedef struct
+{
+    const uchar *data;
+    size_t len;
+    void *map;                  // Mapping to undo (NULL: inline, cached or empty)
+    const CarrierEntry *cached; // Cache entry data points into
+} ServeInput;
+
+/* State owned by one worker thread and reused for all of its requests */
+typedef struct
+{
+    StegoArena in;    // Inline image and payload
+    StegoArena out;   // Reply data and codec scratch
+    StegoStats stats; // Counters of this worker's requests (merged at the end)
+    unsigned long requests;
+    unsigned long failed;
+} ServeWorker;
+
+struct _ServeCtx
+{
+    ServeWorker *workers;
+    ThreadPool *pool;
+    int epfd;
+    int record_stats; // Fill each worker's stats
+    CarrierCache *cache;  // Images passed as descriptors (NULL: disabled)
+    pthread_mutex_t lock; // Guards conns
+    ServeConn *conns[SERVE_MAX_CONN];
+};
+
+static volatile sig_atomic_t serve_stop; // Set by SIGINT/SIGTERM
+
+/* Function Definitions */
+
+static void on_stop_signal(int sig)
+{
+    (void)sig;
+    serve_stop = 1;
+}
+
+static unsigned long long get_be(const uchar *p, int n)
+{
+    unsigned long long v = 0;
+    for (int i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_be(uchar *p, int n, unsigned long long v)
+{
+    for (int i = n - 1; i >= 0; i--, v >>= 8)
+        p[i] = v & 0xFF;
+}
+
+static int recv_header(int fd, uchar *hdr, int *fds, int *nfds)
+{
+    // Descriptors ride on the first bytes of the header; returns 1 (header read), 0 (EOF) or -1
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    size_t got = 0;
+    *nfds = 0;
+
+    while (got < SERVE_REQUEST_BYTES)
+    {
+        struct iovec iov = {hdr + got, SERVE_REQUEST_BYTES - got};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return (n == 0 && got == 0) ? 0 : -1;
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+                continue;
+            int count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (int i = 0; i < count; i++)
+            {
+                int received;
+                memcpy(&received, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+                if (*nfds < 2)
+                    fds[(*nfds)++] = received;
+                else
+                    close(received); // More than a request can use
+            }
+        }
+        if (msg.msg_flags & MSG_CTRUNC)
+            return -1;
+        got += n;
+    }
+    return 1;
+}
+
+static Status recv_all(int fd, uchar *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        buf += n;
+        len -= n;
+    }
+    return e_success;
+}
+
+static Status send_all(int fd, struct iovec *iov, int iovcnt)
+{
+    // One sendmsg per round; a short send resumes inside the iovec
+    while (iovcnt > 0)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return e_failure;
+
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (uchar *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return e_success;
+}
+
+static Status send_reply(int fd, uint status, const StegoPayloadInfo *info, const void *data, size_t len)
+{
+    uchar hdr[SERVE_REPLY_BYTES];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "STGR", 4);
+    hdr[4] = status;
+    if (info != NULL)
+    {
+        hdr[5] = info->depth;
+        hdr[6] = info->codec;
+        hdr[7] = info->checksum != 0;
+        memcpy(hdr + 8, info->extn, strnlen(info->extn, 8));
+        put_be(hdr + 24, 8, info->size);
+    }
+    put_be(hdr + 16, 8, len);
+
+    struct iovec iov[2] = {{hdr, sizeof(hdr)}, {(void *)data, len}};
+    return send_all(fd, iov, len > 0 ? 2 : 1);
+}
+
+static Status send_error(int fd, uint status, const char *message)
+{
+    return send_reply(fd, status, NULL, message, strlen(message));
+}
+
+static const char *parse_request(const uchar *hdr, ServeRequest *req)
+{
+    // Returns why the header is rejected, or NULL
+    if (memcmp(hdr, "STGQ", 4) != 0 || hdr[4] != SERVE_VERSION)
+        return "unknown protocol or version";
+
+    memset(req, 0, sizeof(ServeRequest));
+    req->op = hdr[5];
+    req->depth = hdr[6];
+    req->codec = hdr[7];
+    req->checksum = hdr[8];
+    req->fds = hdr[9];
+    req->scatter = hdr[10];
+    req->image_len = get_be(hdr + 32, 8);
+    req->payload_len = get_be(hdr + 40, 8);
+
+    if (req->op != SERVE_EMBED && req->op != SERVE_EXTRACT && req->op != SERVE_PEEK)
+        return "unknown operation";
+    if (req->fds & ~(SERVE_FD_IMAGE | SERVE_FD_PAYLOAD) || (req->op != SERVE_EMBED && (req->fds & SERVE_FD_PAYLOAD)))
+        return "invalid descriptor flags";
+    if (((req->fds & SERVE_FD_IMAGE) && req->image_len != 0) || ((req->fds & SERVE_FD_PAYLOAD) && req->payload_len != 0))
+        return "inline length given for a descriptor";
+    if ((req->op != SERVE_EMBED && req->payload_len != 0) || req->image_len > SERVE_MAX_INLINE ||
+        req->payload_len > SERVE_MAX_INLINE)
+        return "invalid lengths";
+
+    // Strings must end inside their fields and fit the library limits
+    size_t magic_len = strnlen((const char *)hdr + 12, 12);
+    size_t extn_len = strnlen((const char *)hdr + 24, 8);
+    if (magic_len == 0 || magic_len > STEGO_MAX_MAGIC || extn_len > STEGO_MAX_EXTN)
+        return "invalid magic string or extension";
+    memcpy(req->magic, hdr + 12, magic_len);
+    memcpy(req->extn, hdr + 24, extn_len);
+    return NULL;
+}
+
+static const char *map_input(int fd, ServeInput *input)
+{
+    // Only regular files can be mapped (and sized)
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return "descriptor is not a regular file";
+
+    input->len = st.st_size;
+    input->data = (const uchar *)"";
+    if (input->len == 0)
+        return NULL;
+
+    void *map = mmap(NULL, input->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return "unable to map descriptor";
+    input->map = map;
+    input->data = map;
+    return NULL;
+}
+
+static const char *open_image(ServeCtx *ctx, int fd, ServeInput *input)
+{
+    // A cover seen before comes from the cache; others are mapped as usual
+    if (ctx->cache != NULL)
+        input->cached = carrier_cache_load(ctx->cache, fd);
+    if (input->cached == NULL)
+        return map_input(fd, input);
+
+    input->data = input->cached->data;
+    input->len = input->cached->len;
+    return NULL;
+}
+
+static void release_input(ServeCtx *ctx, ServeInput *input)
+{
+    if (input->cached != NULL)
+        carrier_cache_release(ctx->cache, input->cached);
+    if (input->map != NULL)
+        munmap(input->map, input->len);
+    input->cached = NULL;
+    input->map = NULL;
+}
+
+static Status run_request(ServeWorker *state, const ServeRequest *req, const ServeInput *image,
+                          const ServeInput *payload, StegoStats *stats, int fd)
+{
+    // Returns e_failure only when the reply cannot be sent
+    StegoParams params;
+    stego_default_params(&params);
+    params.stats = stats;
+    StegoPayloadInfo info;
+
+    if (req->op == SERVE_EMBED)
+    {
+        params.depth = req->depth;
+        params.codec = req->codec;
+        params.checksum = req->checksum;
+        params.scatter = req->scatter;
+
+        // A cached carrier's capacity is known: turn away a raw payload that cannot fit before copying anything
+        uint max_depth = req->depth == STEGO_DEPTH_AUTO ? STEGO_MAX_DEPTH : req->depth;
+        if (image->cached != NULL && req->codec == STEGO_CODEC_NONE &&
+            payload->len > image->cached->capacity * max_depth / 8)
+        {
+            state->failed++;
+            return send_error(fd, SERVE_EFAIL, "payload does not fit in the carrier");
+        }
+
+        size_t scratch_len = stego_scratch_size(payload->len, &params);
+        uchar *stego = NULL, *scratch = NULL;
+        if (arena_reserve(&state->out, ARENA_BYTES(image->len) + ARENA_BYTES(scratch_len)) == e_success)
+        {
+            stego = arena_alloc(&state->out, image->len);
+            scratch = scratch_len > 0 ? arena_alloc(&state->out, scratch_len) : NULL;
+        }
+        if (stego == NULL || stego_embed(image->data, image->len, payload->data, payload->len, req->magic, req->extn,
+                                         &params, stego, image->len, scratch, scratch_len) != e_success)
+        {
+            // Tell the client why its carrier was turned away
+            const char *error = stego_carrier_error(image->data, image->len);
+            state->failed++;
+            return send_error(fd, SERVE_EFAIL, error != NULL ? error : "embed failed");
+        }
+        return send_reply(fd, SERVE_OK, NULL, stego, image->len);
+    }
+
+    if (stego_peek(image->data, image->len, req->magic, &info) != e_success)
+    {
+        state->failed++;
+        return send_error(fd, SERVE_EFAIL, "no payload for this magic string");
+    }
+    if (req->op == SERVE_PEEK)
+        return send_reply(fd, SERVE_OK, &info, NULL, 0);
+
+    // A framed payload is never larger than the image that holds it
+    size_t cap = info.size == STEGO_SIZE_UNKNOWN ? image->len : info.size;
+    size_t out_len = 0;
+    uchar *out = NULL, *work = NULL;
+    if (arena_reserve(&state->out, ARENA_BYTES(cap) + ARENA_BYTES(stego_work_size())) == e_success)
+    {
+        out = cap > 0 ? arena_alloc(&state->out, cap) : NULL;
+        work = arena_alloc(&state->out, stego_work_size());
+    }
+    if ((out == NULL && cap > 0) || stego_extract(image->data, image->len, req->magic, &params, out, cap, &out_len,
+                                                  &info, work, stego_work_size()) != e_success)
+    {
+        state->failed++;
+        return send_error(fd, SERVE_EFAIL, "extract failed");
+    }
+    return send_reply(fd, SERVE_OK, &info, out, out_len);
+}
+
+static Status serve_request(ServeCtx *ctx, ServeWorker *state, int fd)
+{
+    // Serve one request; e_failure closes the connection
+    uchar hdr[SERVE_REQUEST_BYTES];
+    int fds[2], nfds;
+    int got = recv_header(fd, hdr, fds, &nfds);
+    if (got <= 0)
+    {
+        for (int i = 0; i < nfds; i++)
+            close(fds[i]);
+        return e_failure; // Client closed, timed out or broke the stream
+    }
+
+    state->requests++;
+    ServeRequest req;
+    ServeInput image = {0}, payload = {0};
+    const char *error = parse_request(hdr, &req);
+
+    // Descriptors arrive in order: image, then payload
+    int want = ((req.fds & SERVE_FD_IMAGE) != 0) + ((req.fds & SERVE_FD_PAYLOAD) != 0);
+    if (error == NULL && nfds != want)
+        error = "descriptor count does not match the request";
+    int next_fd = 0;
+    if (error == NULL && (req.fds & SERVE_FD_IMAGE))
+        error = open_image(ctx, fds[next_fd++], &image);
+    if (error == NULL && (req.fds & SERVE_FD_PAYLOAD))
+        error = map_input(fds[next_fd++], &payload);
+    for (int i = 0; i < nfds; i++)
+        close(fds[i]); // Mappings stay valid without the descriptors
+
+    // Inline parts follow the header: image, then payload
+    Status status = e_success;
+    if (error == NULL && (req.image_len > 0 || req.payload_len > 0))
+    {
+        if (arena_reserve(&state->in, ARENA_BYTES(req.image_len) + ARENA_BYTES(req.payload_len)) != e_success)
+        {
+            error = "out of memory";
+        }
+        else
+        {
+            uchar *in_image = req.image_len > 0 ? arena_alloc(&state->in, req.image_len) : NULL;
+            uchar *in_payload = req.payload_len > 0 ? arena_alloc(&state->in, req.payload_len) : NULL;
+            if ((in_image != NULL && recv_all(fd, in_image, req.image_len) != e_success) ||
+                (in_payload != NULL && recv_all(fd, in_payload, req.payload_len) != e_success))
+                status = e_failure;
+            if (in_image != NULL)
+            {
+                image.data = in_image;
+                image.len = req.image_len;
+            }
+            if (in_payload != NULL)
+            {
+                payload.data = in_payload;
+                payload.len = req.payload_len;
+            }
+        }
+    }
+    if (error == NULL && payload.data == NULL)
+        payload.data = (const uchar *)""; // Empty inline payload
+
+    if (status == e_success && error != NULL)
+    {
+        // The stream position is unknown after a bad header: reply, then close
+        state->failed++;
+        send_error(fd, SERVE_EBADREQ, error);
+        status = e_failure;
+    }
+    else if (status == e_success)
+    {
+        status = run_request(state, &req, &image, &payload, ctx->record_stats ? &state->stats : NULL, fd);
+    }
+
+    release_input(ctx, &image);
+    release_input(ctx, &payload);
+    return status;
+}
+
+static void close_conn(ServeConn *conn)
+{
+    ServeCtx *ctx = conn->ctx;
+    epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->conns[conn->slot] = NULL;
+    pthread_mutex_unlock(&ctx->lock);
+
+    close(conn->fd);
+    free(conn);
+}
+
+static void serve_task(void *arg, int worker)
+{
+    ServeConn *conn = arg;
+    ServeCtx *ctx = conn->ctx;
+
+    if (serve_request(ctx, &ctx->workers[worker], conn->fd) == e_success)
+    {
+        // Wait for the next request (fires at once if it is already here)
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = conn};
+        if (epoll_ctl(ctx->epfd, EPOLL_CTL_MOD, conn->fd, &ev) == 0)
+            return;
+    }
+    close_conn(conn);
+}
+
+static void accept_conn(ServeCtx *ctx, int listen_fd)
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    // A client that stalls mid-request releases its worker after the timeout
+    struct timeval timeout = {SERVE_TIMEOUT_SEC, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    ServeConn *conn = malloc(sizeof(ServeConn));
+    int slot = -1;
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; conn != NULL && i < SERVE_MAX_CONN && slot < 0; i++)
+    {
+        if (ctx->conns[i] == NULL)
+        {
+            slot = i;
+            ctx->conns[i] = conn;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (slot < 0)
+    {
+        fprintf(stderr, "ERROR: Too many connections\n");
+        free(conn);
+        close(fd);
+        return;
+    }
+
+    conn->ctx = ctx;
+    conn->fd = fd;
+    conn->slot = slot;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = conn};
+    if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        close_conn(conn);
+}
+
+static int open_listener(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        printf("ERROR: Socket path too long.\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    // A socket left by an earlier daemon is replaced; any other file is not
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    // Only the owner may connect: the socket is created with mode 0600
+    mode_t old_mask = umask(0077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        perror("bind");
+        fprintf(stderr, "ERROR: Unable to listen on %s\n", socket_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+Status do_serve(const char *socket_path, int nthreads, size_t cache_bytes, StegoStats *stats)
+{
+    ServeCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.record_stats = stats != NULL;
+    ctx.epfd = -1;
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    // Stop signals are blocked everywhere (workers inherit it) and only delivered inside epoll_pwait
+    sigset_t stop_set, wait_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, &wait_set);
+    sigdelset(&wait_set, SIGINT);
+    sigdelset(&wait_set, SIGTERM);
+
+    struct sigaction sa, old_int, old_term;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal; // No SA_RESTART: epoll_pwait returns EINTR
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+    serve_stop = 0;
+
+    Status status = e_failure;
+    int listen_fd = open_listener(socket_path);
+    if (listen_fd >= 0)
+    {
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+        ctx.epfd = epoll_create1(EPOLL_CLOEXEC);
+        ctx.workers = calloc(nthreads, sizeof(ServeWorker));
+        ctx.cache = cache_bytes > 0 ? carrier_cache_create(cache_bytes) : NULL;
+        if (ctx.epfd >= 0 && ctx.workers != NULL && epoll_ctl(ctx.epfd, EPOLL_CTL_ADD, listen_fd, &ev) == 0)
+            ctx.pool = pool_create(nthreads);
+    }
+
+    if (ctx.pool != NULL)
+    {
+        status = e_success;
+        printf("INFO: Serving on %s with %d workers\n", socket_path, nthreads);
+        fflush(stdout);
+
+        struct epoll_event events[SERVE_EVENTS];
+        while (!serve_stop)
+        {
+            int n = epoll_pwait(ctx.epfd, events, SERVE_EVENTS, -1, &wait_set);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                perror("epoll_wait");
+                status = e_failure;
+                break;
+            }
+
+            for (int i = 0; i < n; i++)
+            {
+                ServeConn *conn = events[i].data.ptr;
+                if (conn == NULL)
+                    accept_conn(&ctx, listen_fd);
+                else if (pool_submit(ctx.pool, serve_task, conn) != e_success)
+                    close_conn(conn);
+            }
+        }
+
+        // Let requests in flight finish, then drop the idle connections
+        pool_wait(ctx.pool);
+        pool_destroy(ctx.pool);
+        for (int i = 0; i < SERVE_MAX_CONN; i++)
+        {
+            if (ctx.conns[i] != NULL)
+                close_conn(ctx.conns[i]);
+        }
+    }
+
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    if (ctx.epfd >= 0)
+        close(ctx.epfd);
+
+    // Workers count without locks; add them up once all requests are done
+    unsigned long requests = 0, failed = 0;
+    for (int i = 0; ctx.workers != NULL && i < nthreads; i++)
+    {
+        requests += ctx.workers[i].requests;
+        failed += ctx.workers[i].failed;
+        if (stats != NULL)
+            stats_merge(stats, &ctx.workers[i].stats);
+        arena_free(&ctx.workers[i].in);
+        arena_free(&ctx.workers[i].out);
+    }
+    free(ctx.workers);
+    pthread_mutex_destroy(&ctx.lock);
+
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    pthread_sigmask(SIG_UNBLOCK, &stop_set, NULL);
+
+    if (ctx.pool != NULL)
+        printf("Served: %lu requests, %lu failed\n", requests, failed);
+    if (stats != NULL && ctx.cache != NULL)
+        carrier_cache_stats(ctx.cache, stats);
+    carrier_cache_destroy(ctx.cache);
+    return status;
+}
@@ -0,0 +1,80 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stddef.h>
+#include "stats.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Daemon mode: a long-running process that serves embed and extract
+ * requests on a Unix domain socket, so callers skip process start-up
+ * and hit warm workers and caches.
+ *
+ * A connection carries any number of requests, one after the other.
+ * The main thread waits on all connections with epoll and hands a
+ * readable one to the thread pool, which serves exactly one request
+ * and re-arms it; an idle connection ties up no worker. Each worker
+ * keeps its request and reply buffers (two job arenas) between
+ * requests. Images passed as descriptors go through the carrier cache
+ * (carrier_cache.h), so a cover used again is neither read nor mapped.
+ *
+ * Request: SERVE_REQUEST_BYTES header, then the inline image and
+ * payload bytes (each left out when passed as a file descriptor).
+ * Descriptors travel as SCM_RIGHTS data on the header: the image's
+ * first, then the payload's. All integers are big-endian.
+ *
+ *   off  size  field
+ *     0     4  "STGQ"
+ *     4     1  protocol version (SERVE_VERSION)
+ *     5     1  op: SERVE_EMBED, SERVE_EXTRACT or SERVE_PEEK
+ *     6     1  depth (1-4, STEGO_DEPTH_AUTO)         embed only
+ *     7     1  codec (STEGO_CODEC_*)                 embed only
+ *     8     1  checksums (0/1)                       embed only
+ *     9     1  SERVE_FD_* bits: which parts are descriptors
+ *    10     1  scatter (0/1), keyed by the magic       embed only
+ *    11     1  reserved (0)
+ *    12    12  magic string, NUL padded
+ *    24     8  extension to store, NUL padded        embed only
+ *    32     8  image bytes inline (0 with SERVE_FD_IMAGE)
+ *    40     8  payload bytes inline (0 with SERVE_FD_PAYLOAD)
+ *    48    16  reserved (0)
+ *
+ * Reply: SERVE_REPLY_BYTES header, then len bytes: the stego image
+ * (embed), the payload (extract), nothing (peek), or an error
+ * message when status is not SERVE_OK.
+ *
+ *   off  size  field
+ *     0     4  "STGR"
+ *     4     1  status (SERVE_OK, SERVE_EBADREQ, SERVE_EFAIL)
+ *     5     1  depth of the payload                  extract, peek
+ *     6     1  codec of the payload                  extract, peek
+ *     7     1  checksums present (0/1)               extract, peek
+ *     8     8  extension, NUL padded                 extract, peek
+ *    16     8  len
+ *    24     8  payload size (STEGO_SIZE_UNKNOWN if framed)  peek
+ */
+
+#define SERVE_VERSION 1
+#define SERVE_REQUEST_BYTES 64
+#define SERVE_REPLY_BYTES 32
+#define SERVE_MAX_INLINE (1ULL << 30) // Largest inline image or payload
+#define SERVE_MAX_CONN 1024           // Connections open at once
+
+/* Operations */
+#define SERVE_EMBED 1
+#define SERVE_EXTRACT 2
+#define SERVE_PEEK 3
+
+/* Parts passed as file descriptors */
+#define SERVE_FD_IMAGE 1
+#define SERVE_FD_PAYLOAD 2
+
+/* Reply status */
+#define SERVE_OK 0
+#define SERVE_EBADREQ 1 // Malformed request (the connection is closed after the reply)
+#define SERVE_EFAIL 2   // Request understood but the embed or extract failed
+
+/* Serve requests on socket_path with nthreads workers and cache_bytes of carrier cache until SIGINT or SIGTERM, adding stage counters to stats (if not NULL) */
+Status do_serve(const char *socket_path, int nthreads, size_t cache_bytes, StegoStats *stats);
+
+#endif
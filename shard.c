@@ -0,0 +1,480 @@
+#define _POSIX_C_SOURCE 200809L // strdup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include "shard.h"
+#include "bmp.h"
+#include "arena.h"
+#include "carrier.h"
+#include "encode.h"
+#include "libstego.h"
+#include "mmap_io.h"
+#include "pool.h"
+#include "scatter.h"
+#include "types.h"
+
+typedef struct _ShardCtx ShardCtx;
+
+/* One line of the list: a carrier and its output (encode) or a stego image (decode) */
+typedef struct
+{
+    ShardCtx *ctx;
+    int line;           // List line number
+    char *text;         // Copy of the list line the paths point into
+    char *paths[2];     // carrier/output or image
+    FILE *fptr;         // Carrier or stego image
+    const uchar *map;   // Its mapping
+    size_t map_size;
+    StegoShard shard;   // Index, count, payload id and offset of the slice
+    size_t len;         // Unpacked bytes of the slice (encode: carrier bytes that take payload, until the split)
+    StegoPayloadInfo info; // Header of a stego image (decode)
+    StegoStats stats;   // Counters of this shard (merged at the end)
+    Status status;
+} ShardJob;
+
+struct _ShardCtx
+{
+    ShardJob *jobs;
+    int njobs;
+    const char *magic;
+    StegoParams params;
+    const uchar *secret;            // Mapped secret (encode)
+    char extn[MAX_FILE_SUFFIX];     // Extension stored with every shard (encode)
+    uchar *out;                     // Mapped output file (decode)
+    StegoArena *work;               // Scratch (encode) or work buffers (decode) of each worker, kept across its shards
+};
+
+/* Function Definitions */
+
+static Status read_list(const char *list, ShardCtx *ctx, int nfields)
+{
+    FILE *fptr = fopen(list, "r");
+    if (fptr == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", list);
+        return e_failure;
+    }
+
+    int line_no = 0, cap_jobs = 0;
+    char line[SHARD_MAX_LINE];
+    Status status = e_success;
+
+    while (status == e_success && fgets(line, sizeof(line), fptr) != NULL)
+    {
+        line_no++;
+        if (ctx->njobs == cap_jobs)
+        {
+            cap_jobs = cap_jobs ? 2 * cap_jobs : 16;
+            ShardJob *jobs = realloc(ctx->jobs, cap_jobs * sizeof(ShardJob));
+            if (jobs == NULL)
+            {
+                status = e_failure;
+                break;
+            }
+            ctx->jobs = jobs;
+        }
+
+        // Each job keeps its own copy of the line for its paths
+        ShardJob *job = &ctx->jobs[ctx->njobs];
+        memset(job, 0, sizeof(ShardJob));
+        job->text = strdup(line);
+        if (job->text == NULL)
+        {
+            status = e_failure;
+            break;
+        }
+
+        int n = 0;
+        for (char *tok = strtok(job->text, " \t\r\n"); tok != NULL && tok[0] != '#'; tok = strtok(NULL, " \t\r\n"))
+        {
+            if (n == nfields)
+            {
+                n++;
+                break;
+            }
+            job->paths[n++] = tok;
+        }
+
+        if (n == 0)
+        {
+            free(job->text); // Blank or comment line
+        }
+        else if (n != nfields || ctx->njobs == SHARD_MAX)
+        {
+            printf("ERROR: Invalid shard on list line %d\n", line_no);
+            free(job->text);
+            status = e_failure;
+        }
+        else
+        {
+            job->ctx = ctx;
+            job->line = line_no;
+            ctx->njobs++;
+        }
+    }
+
+    fclose(fptr);
+    if (status == e_success && ctx->njobs == 0)
+    {
+        printf("ERROR: No shards listed in %s\n", list);
+        status = e_failure;
+    }
+    return status;
+}
+
+static Status map_input(ShardJob *job)
+{
+    // Carriers and images are mapped, so every worker reads its own straight from the page cache
+    job->fptr = fopen(job->paths[0], "rb");
+    if (job->fptr == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", job->paths[0]);
+        return e_failure;
+    }
+    job->map = map_file_read(job->fptr, &job->map_size);
+    if (job->map == NULL)
+    {
+        printf("ERROR: Shard %s must be a regular, non-empty file.\n", job->paths[0]);
+        return e_failure;
+    }
+    return e_success;
+}
+
+static void free_jobs(ShardCtx *ctx)
+{
+    for (int i = 0; i < ctx->njobs; i++)
+    {
+        unmap_file(ctx->jobs[i].map, ctx->jobs[i].map_size);
+        if (ctx->jobs[i].fptr != NULL)
+            fclose(ctx->jobs[i].fptr);
+        free(ctx->jobs[i].text);
+    }
+    free(ctx->jobs);
+}
+
+static Status run_jobs(ShardCtx *ctx, pool_task_fn fn, int nthreads)
+{
+    // One task per shard; the pool never gets more workers than shards
+    int nworkers = nthreads < ctx->njobs ? nthreads : ctx->njobs;
+    if (nworkers < 1)
+        nworkers = 1;
+    ctx->work = calloc(nworkers, sizeof(StegoArena));
+    ThreadPool *pool = ctx->work != NULL ? pool_create(nworkers) : NULL;
+    if (pool == NULL)
+    {
+        free(ctx->work);
+        return e_failure;
+    }
+
+    for (int i = 0; i < ctx->njobs; i++)
+    {
+        ctx->jobs[i].status = e_failure;
+        if (pool_submit(pool, fn, &ctx->jobs[i]) != e_success)
+            printf("ERROR: Unable to queue shard on list line %d\n", ctx->jobs[i].line);
+    }
+    pool_wait(pool);
+    pool_destroy(pool);
+    for (int i = 0; i < nworkers; i++)
+        arena_free(&ctx->work[i]);
+    free(ctx->work);
+
+    // Workers count without locks; add them up once all shards are done
+    int passed = 0;
+    for (int i = 0; i < ctx->njobs; i++)
+    {
+        if (ctx->params.stats != NULL)
+            stats_merge(ctx->params.stats, &ctx->jobs[i].stats);
+        passed += ctx->jobs[i].status == e_success;
+    }
+    printf("Shards: %d of %d completed\n", passed, ctx->njobs);
+    return passed == ctx->njobs ? e_success : e_failure;
+}
+
+static StegoParams shard_params(ShardJob *job)
+{
+    // Parallelism comes from running shards side by side
+    StegoParams params = job->ctx->params;
+    params.threads = 1;
+    params.stats = job->ctx->params.stats != NULL ? &job->stats : NULL;
+    return params;
+}
+
+static void embed_shard(void *arg, int worker)
+{
+    ShardJob *job = arg;
+    ShardCtx *ctx = job->ctx;
+    StegoParams params = shard_params(job);
+    params.shard = &job->shard;
+
+    // The output is sized like the carrier and mapped, so the engine writes it in place
+    StegoArena *work = &ctx->work[worker];
+    size_t scratch_len = stego_scratch_size(job->len, &params);
+    uchar *scratch = NULL;
+    if (scratch_len > 0 && arena_reserve(work, ARENA_BYTES(scratch_len)) == e_success)
+        scratch = arena_alloc(work, scratch_len);
+    FILE *fptr_out = fopen(job->paths[1], "w+b");
+    uchar *stego = fptr_out != NULL ? map_file_write(fptr_out, job->map_size) : NULL;
+    const uchar *slice = job->len > 0 ? ctx->secret + job->shard.offset : NULL;
+
+    if (stego != NULL && (scratch_len == 0 || scratch != NULL))
+        job->status = stego_embed(job->map, job->map_size, slice, job->len, ctx->magic, ctx->extn, &params, stego,
+                                  job->map_size, scratch, scratch_len);
+
+    unmap_file(stego, job->map_size);
+    if (fptr_out != NULL)
+        fclose(fptr_out);
+    printf("SHARD %u/%u: %s %s -> %s (%zu bytes)\n", job->shard.index + 1, job->shard.count,
+           job->status == e_success ? "SUCCESS" : "ERROR", job->paths[0], job->paths[1], job->len);
+}
+
+static Status split_secret(ShardCtx *ctx, size_t size)
+{
+    // Each carrier takes a slice in proportion to the bytes that can carry it, so all of them fill up at the same rate
+    unsigned __int128 total = 0, before = 0;
+    for (int i = 0; i < ctx->njobs; i++)
+        total += ctx->jobs[i].len;
+    if (total == 0)
+    {
+        printf("ERROR: The carriers have no room for a payload.\n");
+        return e_failure;
+    }
+
+    for (int i = 0; i < ctx->njobs; i++)
+    {
+        ShardJob *job = &ctx->jobs[i];
+        size_t room = job->len;
+        job->shard.offset = (size_t)(size * before / total);
+        before += room;
+        job->len = (size_t)(size * before / total) - job->shard.offset;
+    }
+    return e_success;
+}
+
+Status do_shard_encode(const char *list, const char *secret, const char *magic, const StegoParams *params, int nthreads)
+{
+    ShardCtx ctx = {0};
+    ctx.magic = magic;
+    ctx.params = *params;
+    if (read_list(list, &ctx, 2) != e_success)
+    {
+        free_jobs(&ctx);
+        return e_failure;
+    }
+
+    // The whole secret is mapped once; each shard embeds its slice from there
+    FILE *fptr_secret = fopen(secret, "rb");
+    if (fptr_secret == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", secret);
+        free_jobs(&ctx);
+        return e_failure;
+    }
+    size_t size = get_file_size(fptr_secret);
+    size_t secret_size = 0;
+    Status status = e_success;
+    if (size == FRAMED_SIZE)
+    {
+        printf("ERROR: Sharding needs a regular secret file.\n");
+        status = e_failure;
+    }
+    else if (size > 0 && (ctx.secret = map_file_read(fptr_secret, &secret_size)) == NULL)
+    {
+        status = e_failure;
+    }
+
+    // Same extension as a single carrier would store
+    secret_name_extn(secret, ctx.extn);
+
+    // Every carrier must parse before the secret is split by their sizes
+    for (int i = 0; i < ctx.njobs && status == e_success; i++)
+    {
+        ShardJob *job = &ctx.jobs[i];
+        BmpInfo bmp;
+        if (map_input(job) != e_success || parse_carrier_header(job->map, job->map_size, &bmp) != e_success ||
+            (!carrier_encoded(&bmp) && bmp.image_end > job->map_size))
+        {
+            fprintf(stderr, "ERROR: Unable to read image header from %s\n", job->paths[0]);
+            status = e_failure;
+            break;
+        }
+        if (carrier_encoded(&bmp))
+        {
+            // Shards are embedded into outputs mapped at the carrier's size
+            fprintf(stderr, "ERROR: %s carriers cannot hold shards (%s)\n", carrier_ops(bmp.format)->name, job->paths[0]);
+            status = e_failure;
+            break;
+        }
+        // Scattered payloads only use whole slots (the few header rows are left out of the estimate)
+        job->len = params->scatter ? scatter_blocks(&bmp, 0) * SCATTER_BLOCK : get_image_size_for_bmp(&bmp);
+        job->shard.index = i;
+        job->shard.count = ctx.njobs;
+    }
+
+    unsigned long long payload_id = 0;
+    if (status == e_success && getrandom(&payload_id, sizeof(payload_id), 0) != sizeof(payload_id))
+        status = e_failure;
+
+    for (int i = 0; i < ctx.njobs && status == e_success; i++)
+        ctx.jobs[i].shard.payload_id = payload_id;
+    if (status == e_success && (status = split_secret(&ctx, size)) == e_success)
+    {
+        status = run_jobs(&ctx, embed_shard, nthreads);
+
+        // A partial set cannot be decoded: drop every output
+        for (int i = 0; i < ctx.njobs && status != e_success; i++)
+            remove(ctx.jobs[i].paths[1]);
+    }
+
+    unmap_file(ctx.secret, secret_size);
+    fclose(fptr_secret);
+    free_jobs(&ctx);
+    return status;
+}
+
+static void extract_shard(void *arg, int worker)
+{
+    ShardJob *job = arg;
+    ShardCtx *ctx = job->ctx;
+    StegoParams params = shard_params(job);
+
+    // Straight into the output mapping at the slice's offset
+    uchar *out = job->len > 0 ? ctx->out + job->shard.offset : NULL;
+    StegoArena *arena = &ctx->work[worker];
+    uchar *work = NULL;
+    if (arena_reserve(arena, ARENA_BYTES(stego_work_size())) == e_success)
+        work = arena_alloc(arena, stego_work_size());
+    size_t out_len = 0;
+    if (stego_extract(job->map, job->map_size, ctx->magic, &params, out, job->len, &out_len, NULL, work,
+                      stego_work_size()) == e_success &&
+        out_len == job->len)
+        job->status = e_success;
+
+    printf("SHARD %u/%u: %s %s (%zu bytes)\n", job->shard.index + 1, job->shard.count,
+           job->status == e_success ? "SUCCESS" : "ERROR", job->paths[0], job->len);
+}
+
+static Status check_shards(ShardCtx *ctx, size_t *total)
+{
+    // Every listed image must hold a different shard of the same payload, and the slices must tile it
+    ShardJob **order = calloc(ctx->njobs, sizeof(ShardJob *));
+    if (order == NULL)
+        return e_failure;
+
+    Status status = e_success;
+    for (int i = 0; i < ctx->njobs && status == e_success; i++)
+    {
+        ShardJob *job = &ctx->jobs[i];
+        if (job->shard.count != (uint)ctx->njobs || job->shard.payload_id != ctx->jobs[0].shard.payload_id ||
+            order[job->shard.index] != NULL)
+        {
+            printf("ERROR: %s is not one of the %d shards of the same payload.\n", job->paths[0], ctx->njobs);
+            status = e_failure;
+        }
+        else
+        {
+            order[job->shard.index] = job;
+        }
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < ctx->njobs && status == e_success; i++)
+    {
+        if (order[i]->shard.offset != offset || order[i]->len > (size_t)-1 - offset)
+        {
+            printf("ERROR: Shard %d does not continue the payload where shard %d ends.\n", i + 1, i);
+            status = e_failure;
+        }
+        offset += order[i]->len;
+    }
+
+    free(order);
+    *total = offset;
+    return status;
+}
+
+Status do_shard_decode(const char *list, const char *out_name, const char *magic, const StegoParams *params, int nthreads)
+{
+    ShardCtx ctx = {0};
+    ctx.magic = magic;
+    ctx.params = *params;
+    if (read_list(list, &ctx, 1) != e_success)
+    {
+        free_jobs(&ctx);
+        return e_failure;
+    }
+
+    // Headers first: the output size and every slice's place are known before any payload is read
+    Status status = e_success;
+    for (int i = 0; i < ctx.njobs && status == e_success; i++)
+    {
+        ShardJob *job = &ctx.jobs[i];
+        if (map_input(job) != e_success)
+        {
+            status = e_failure;
+        }
+        else if (stego_peek(job->map, job->map_size, magic, &job->info) != e_success || job->info.shard.count == 0 ||
+                 job->info.size == STEGO_SIZE_UNKNOWN)
+        {
+            printf("ERROR: No payload shard for the magic string in %s\n", job->paths[0]);
+            status = e_failure;
+        }
+        else
+        {
+            job->shard = job->info.shard;
+            job->len = job->info.size;
+        }
+    }
+
+    size_t total = 0;
+    if (status == e_success)
+        status = check_shards(&ctx, &total);
+    if (status != e_success)
+    {
+        free_jobs(&ctx);
+        return e_failure;
+    }
+
+    // Workers write their slices through one shared mapping of the output
+    FILE *fptr_out = fopen(out_name, "w+b");
+    if (fptr_out == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", out_name);
+        free_jobs(&ctx);
+        return e_failure;
+    }
+    if (total > 0 && (ctx.out = map_file_write(fptr_out, total)) == NULL)
+    {
+        printf("ERROR: Sharded output needs a regular file.\n");
+        status = e_failure;
+    }
+
+    if (status == e_success)
+        status = run_jobs(&ctx, extract_shard, nthreads);
+    unmap_file(ctx.out, total);
+    fclose(fptr_out);
+
+    if (status != e_success)
+    {
+        remove(out_name); // Drop the partial output
+    }
+    else
+    {
+        // Rename output file to include extension
+        char *new_name = malloc(strlen(out_name) + sizeof(ctx.jobs[0].info.extn));
+        if (new_name != NULL)
+        {
+            sprintf(new_name, "%s%s", out_name, ctx.jobs[0].info.extn);
+            rename(out_name, new_name);
+            free(new_name);
+        }
+    }
+
+    free_jobs(&ctx);
+    return status;
+}
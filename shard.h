@@ -0,0 +1,36 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "libstego.h"
+#include "types.h" // Contains user defined types
+
+/*
+ * Sharded mode: one secret too large for any single carrier is split
+ * over several. Every carrier gets one contiguous slice, sized in
+ * proportion to its pixel bytes, embedded as a complete payload of
+ * its own (depth, codec, checksums and encryption apply per slice).
+ * The extended header of each image records the payload id, the
+ * shard index and count, and the offset of the slice (STEGO_FLAG_SHARD).
+ *
+ * List format, one shard per line (blank lines and lines starting
+ * with '#' are skipped):
+ *   encode: <carrier.bmp> <output.bmp>
+ *   decode: <stego.bmp>             (any order)
+ *
+ * Carriers, images and the secret are mapped, and the shards are
+ * embedded or extracted side by side on the thread pool. Decoding
+ * reads every header first, checks that the shards belong together
+ * and cover the payload without gaps, then has each worker extract
+ * its slice straight into the mapped output file at its offset.
+ */
+
+#define SHARD_MAX 4096 // Shards of one payload
+#define SHARD_MAX_LINE 1024
+
+/* Split secret over the carrier/output pairs listed in list, on nthreads workers */
+Status do_shard_encode(const char *list, const char *secret, const char *magic, const StegoParams *params, int nthreads);
+
+/* Reassemble the payload of the images listed in list into out_name plus the stored extension */
+Status do_shard_decode(const char *list, const char *out_name, const char *magic, const StegoParams *params, int nthreads);
+
+#endif
@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+#include "types.h"
+
+static const char *stage_names[STAGE_COUNT] = {"open", "compress", "header", "magic", "fields", "payload", "tail", "close"};
+
+/* Function Definitions */
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void stats_reset(StegoStats *stats)
+{
+    memset(stats, 0, sizeof(StegoStats));
+}
+
+void stats_begin(StegoStats *stats, StatStage stage)
+{
+    stats->current = stage;
+    stats->start_ns = now_ns();
+}
+
+void stats_end(StegoStats *stats)
+{
+    StageStats *st = &stats->stage[stats->current];
+    st->ns += now_ns() - stats->start_ns;
+    st->runs++;
+}
+
+void stats_io(StegoStats *stats, size_t nread, size_t nwritten, uint calls)
+{
+    StageStats *st = &stats->stage[stats->current];
+    st->bytes_read += nread;
+    st->bytes_written += nwritten;
+    st->io_calls += calls;
+}
+
+void stats_merge(StegoStats *dst, const StegoStats *src)
+{
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        dst->stage[i].ns += src->stage[i].ns;
+        dst->stage[i].bytes_read += src->stage[i].bytes_read;
+        dst->stage[i].bytes_written += src->stage[i].bytes_written;
+        dst->stage[i].io_calls += src->stage[i].io_calls;
+        dst->stage[i].runs += src->stage[i].runs;
+    }
+    dst->cache_hits += src->cache_hits;
+    dst->cache_misses += src->cache_misses;
+}
+
+static void print_json(const StegoStats *stats, const char *op, FILE *fp)
+{
+    unsigned long long total = 0;
+    fprintf(fp, "{\"operation\":\"%s\",\"stages\":[", op);
+    for (int i = 0, first = 1; i < STAGE_COUNT; i++)
+    {
+        const StageStats *st = &stats->stage[i];
+        if (st->runs == 0)
+            continue; // Stage not used by this operation
+        fprintf(fp, "%s{\"stage\":\"%s\",\"ns\":%llu,\"bytes_read\":%llu,\"bytes_written\":%llu,\"io_calls\":%llu,\"runs\":%llu}",
+                first ? "" : ",", stage_names[i], st->ns, st->bytes_read, st->bytes_written, st->io_calls, st->runs);
+        total += st->ns;
+        first = 0;
+    }
+    fprintf(fp, "],\"total_ns\":%llu", total);
+    if (stats->cache_hits + stats->cache_misses > 0)
+        fprintf(fp, ",\"cache_hits\":%llu,\"cache_misses\":%llu", stats->cache_hits, stats->cache_misses);
+    fprintf(fp, "}\n");
+}
+
+static void print_metric(const StegoStats *stats, const char *op, const char *name, const char *help, int field, FILE *fp)
+{
+    fprintf(fp, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        const StageStats *st = &stats->stage[i];
+        if (st->runs == 0)
+            continue;
+        fprintf(fp, "%s{op=\"%s\",stage=\"%s\"} ", name, op, stage_names[i]);
+        switch (field)
+        {
+        case 0:
+            fprintf(fp, "%.9f\n", st->ns / 1e9);
+            break;
+        case 1:
+            fprintf(fp, "%llu\n", st->bytes_read);
+            break;
+        case 2:
+            fprintf(fp, "%llu\n", st->bytes_written);
+            break;
+        default:
+            fprintf(fp, "%llu\n", st->io_calls);
+            break;
+        }
+    }
+}
+
+void stats_print(const StegoStats *stats, const char *op, StatsFormat format, FILE *fp)
+{
+    if (format == STATS_JSON)
+    {
+        print_json(stats, op, fp);
+    }
+    else if (format == STATS_PROMETHEUS)
+    {
+        print_metric(stats, op, "stego_stage_seconds_total", "Wall time spent in each stage.", 0, fp);
+        print_metric(stats, op, "stego_stage_read_bytes_total", "Bytes read by each stage.", 1, fp);
+        print_metric(stats, op, "stego_stage_written_bytes_total", "Bytes written by each stage.", 2, fp);
+        print_metric(stats, op, "stego_stage_io_calls_total", "stdio read/write calls made by each stage.", 3, fp);
+        if (stats->cache_hits + stats->cache_misses > 0)
+        {
+            fprintf(fp, "# HELP stego_carrier_cache_lookups_total Carrier cache lookups.\n"
+                        "# TYPE stego_carrier_cache_lookups_total counter\n");
+            fprintf(fp, "stego_carrier_cache_lookups_total{op=\"%s\",result=\"hit\"} %llu\n", op, stats->cache_hits);
+            fprintf(fp, "stego_carrier_cache_lookups_total{op=\"%s\",result=\"miss\"} %llu\n", op, stats->cache_misses);
+        }
+    }
+    fflush(fp);
+}
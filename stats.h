@@ -0,0 +1,94 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Per-stage instrumentation: wall time, bytes read and written and
+ * stdio call counts for every encoder/decoder stage. Jobs carry a
+ * StegoStats pointer; NULL means off and every hook below is then a
+ * single pointer test. I/O done through a mapping counts bytes but
+ * no calls.
+ */
+
+typedef enum
+{
+    STAGE_OPEN,     // Open, map, parse BMP header, size the secret
+    STAGE_COMPRESS, // Pack the secret (-z)
+    STAGE_HEADER,   // Copy (encode) or parse (decode) the BMP header
+    STAGE_MAGIC,    // Magic string and extended header
+    STAGE_FIELDS,   // Extension and size fields
+    STAGE_PAYLOAD,  // Secret data
+    STAGE_TAIL,     // Carrier bytes after the payload
+    STAGE_CLOSE,    // Unmap (write back) and close
+    STAGE_COUNT
+} StatStage;
+
+typedef enum
+{
+    STATS_OFF,
+    STATS_JSON,      // One JSON object
+    STATS_PROMETHEUS // Prometheus text exposition format
+} StatsFormat;
+
+typedef struct
+{
+    unsigned long long ns;            // Wall time
+    unsigned long long bytes_read;    // Bytes read from files or mappings
+    unsigned long long bytes_written; // Bytes written to files or mappings
+    unsigned long long io_calls;      // stdio read/write calls
+    unsigned long long runs;          // Times the stage ran
+} StageStats;
+
+typedef struct _StegoStats
+{
+    StageStats stage[STAGE_COUNT];
+    unsigned long long cache_hits;   // Carrier cache lookups that found the carrier (batch, daemon)
+    unsigned long long cache_misses; // Carrier cache lookups that did not
+    StatStage current;           // Stage charged for I/O
+    unsigned long long start_ns; // Start of the current stage
+} StegoStats;
+
+/* Clear all counters */
+void stats_reset(StegoStats *stats);
+
+/* Start timing a stage; I/O is charged to it until stats_end */
+void stats_begin(StegoStats *stats, StatStage stage);
+
+/* Stop timing the current stage */
+void stats_end(StegoStats *stats);
+
+/* Charge I/O to the current stage */
+void stats_io(StegoStats *stats, size_t nread, size_t nwritten, uint calls);
+
+/* Add the counters of src to dst */
+void stats_merge(StegoStats *dst, const StegoStats *src);
+
+/* Write the counters of one operation ("encode", "decode", "batch") */
+void stats_print(const StegoStats *stats, const char *op, StatsFormat format, FILE *fp);
+
+/* Hooks: no call at all when stats is NULL */
+#define STATS_BEGIN(stats, st)                 \
+    do                                         \
+    {                                          \
+        if ((stats) != NULL)                   \
+            stats_begin((stats), (st));        \
+    } while (0)
+
+#define STATS_END(stats)                       \
+    do                                         \
+    {                                          \
+        if ((stats) != NULL)                   \
+            stats_end(stats);                  \
+    } while (0)
+
+#define STATS_IO(stats, nread, nwritten, calls)              \
+    do                                                       \
+    {                                                        \
+        if ((stats) != NULL)                                 \
+            stats_io((stats), (nread), (nwritten), (calls)); \
+    } while (0)
+
+#endif
@@ -0,0 +1,461 @@
+/*
+ * Test client for the daemon mode (server.h): sends one embed, extract
+ * or peek request, or times a run of embed requests.
+ *
+ *   ./stego_client <socket> embed [--fd] [-k N] [-z] [--no-crc] [--scatter] <carrier.bmp> <secret> <output.bmp> <magic>
+ *   ./stego_client <socket> extract [--fd] <stego.bmp> <output> <magic>
+ *   ./stego_client <socket> peek [--fd] <stego.bmp> <magic>
+ *   ./stego_client <socket> bench [--fd] <carrier.bmp> <secret> <magic> [requests]
+ *
+ * With --fd the files are passed as descriptors instead of their bytes.
+ * extract writes the payload to <output> plus the stored extension.
+ */
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime, strnlen
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "server.h"
+#include "stego_header.h"
+#include "types.h"
+
+typedef struct
+{
+    uint op;
+    uint depth;
+    uint codec;
+    uint checksum;
+    uint scatter;
+    int use_fd;
+    const char *magic;
+    char extn[8];
+} ClientRequest;
+
+typedef struct
+{
+    uint status;
+    uint depth;
+    uint codec;
+    uint checksum;
+    char extn[9];
+    unsigned long long size;
+    uchar *data; // len bytes (malloc'd)
+    size_t len;
+} ClientReply;
+
+/* Function Definitions */
+
+static void put_be(uchar *p, int n, unsigned long long v)
+{
+    for (int i = n - 1; i >= 0; i--, v >>= 8)
+        p[i] = v & 0xFF;
+}
+
+static unsigned long long get_be(const uchar *p, int n)
+{
+    unsigned long long v = 0;
+    for (int i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static int connect_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("connect");
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static Status read_file(const char *path, uchar **data, size_t *len)
+{
+    FILE *fptr = fopen(path, "rb");
+    if (fptr == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open file %s\n", path);
+        return e_failure;
+    }
+    fseek(fptr, 0, SEEK_END);
+    *len = ftell(fptr);
+    fseek(fptr, 0, SEEK_SET);
+    *data = malloc(*len + 1);
+    Status status = (*data != NULL && fread(*data, 1, *len, fptr) == *len) ? e_success : e_failure;
+    fclose(fptr);
+    return status;
+}
+
+static Status write_file(const char *path, const uchar *data, size_t len)
+{
+    FILE *fptr = fopen(path, "wb");
+    if (fptr == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open file %s\n", path);
+        return e_failure;
+    }
+    Status status = fwrite(data, 1, len, fptr) == len ? e_success : e_failure;
+    if (fclose(fptr) != 0)
+        status = e_failure;
+    return status;
+}
+
+static Status send_request(int sock, const ClientRequest *req, const uchar *image, size_t image_len, int image_fd,
+                           const uchar *payload, size_t payload_len, int payload_fd)
+{
+    // Header (descriptors attached), then the inline parts
+    uchar hdr[SERVE_REQUEST_BYTES];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "STGQ", 4);
+    hdr[4] = SERVE_VERSION;
+    hdr[5] = req->op;
+    hdr[6] = req->depth;
+    hdr[7] = req->codec;
+    hdr[8] = req->checksum;
+    hdr[10] = req->scatter;
+    strncpy((char *)hdr + 12, req->magic, 11);
+    memcpy(hdr + 24, req->extn, strnlen(req->extn, 8));
+
+    int fds[2], nfds = 0;
+    if (req->use_fd)
+    {
+        hdr[9] = SERVE_FD_IMAGE | (req->op == SERVE_EMBED ? SERVE_FD_PAYLOAD : 0);
+        fds[nfds++] = image_fd;
+        if (req->op == SERVE_EMBED)
+            fds[nfds++] = payload_fd;
+    }
+    else
+    {
+        put_be(hdr + 32, 8, image_len);
+        put_be(hdr + 40, 8, payload_len);
+    }
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct iovec iov[3] = {{hdr, sizeof(hdr)}, {(void *)image, image_len}, {(void *)payload, payload_len}};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = req->use_fd ? 1 : 3;
+    if (nfds > 0)
+    {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+        memcpy(CMSG_DATA(cm), fds, nfds * sizeof(int));
+    }
+
+    // Only the first send carries the descriptors; the rest finishes a short send
+    size_t total = sizeof(hdr) + (req->use_fd ? 0 : image_len + payload_len);
+    ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    if (n < 0)
+        return e_failure;
+    for (size_t sent = n; sent < total; sent += n)
+    {
+        size_t skip = sent;
+        int i = 0;
+        while (skip >= iov[i].iov_len)
+            skip -= iov[i++].iov_len;
+        n = send(sock, (uchar *)iov[i].iov_base + skip, iov[i].iov_len - skip, MSG_NOSIGNAL);
+        if (n <= 0)
+            return e_failure;
+    }
+    return e_success;
+}
+
+static Status recv_all(int sock, uchar *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = recv(sock, buf, len, 0);
+        if (n <= 0)
+            return e_failure;
+        buf += n;
+        len -= n;
+    }
+    return e_success;
+}
+
+static Status recv_reply(int sock, ClientReply *reply)
+{
+    uchar hdr[SERVE_REPLY_BYTES];
+    if (recv_all(sock, hdr, sizeof(hdr)) != e_success || memcmp(hdr, "STGR", 4) != 0)
+        return e_failure;
+
+    memset(reply, 0, sizeof(ClientReply));
+    reply->status = hdr[4];
+    reply->depth = hdr[5];
+    reply->codec = hdr[6];
+    reply->checksum = hdr[7];
+    memcpy(reply->extn, hdr + 8, 8);
+    reply->len = get_be(hdr + 16, 8);
+    reply->size = get_be(hdr + 24, 8);
+
+    reply->data = malloc(reply->len + 1);
+    if (reply->data == NULL || recv_all(sock, reply->data, reply->len) != e_success)
+        return e_failure;
+    reply->data[reply->len] = '\0'; // Error messages print as text
+    return e_success;
+}
+
+static Status transact(int sock, const ClientRequest *req, const char *image_path, const char *payload_path,
+                       ClientReply *reply)
+{
+    // One request from files: descriptors or their bytes
+    uchar *image = NULL, *payload = NULL;
+    size_t image_len = 0, payload_len = 0;
+    int image_fd = -1, payload_fd = -1;
+    Status status = e_success;
+
+    if (req->use_fd)
+    {
+        image_fd = open(image_path, O_RDONLY);
+        if (payload_path != NULL)
+            payload_fd = open(payload_path, O_RDONLY);
+        if (image_fd < 0 || (payload_path != NULL && payload_fd < 0))
+        {
+            fprintf(stderr, "ERROR: Unable to open input files\n");
+            status = e_failure;
+        }
+    }
+    else
+    {
+        status = read_file(image_path, &image, &image_len);
+        if (status == e_success && payload_path != NULL)
+            status = read_file(payload_path, &payload, &payload_len);
+    }
+
+    if (status == e_success)
+        status = send_request(sock, req, image, image_len, image_fd, payload, payload_len, payload_fd);
+    if (status == e_success)
+        status = recv_reply(sock, reply);
+
+    if (image_fd >= 0)
+        close(image_fd);
+    if (payload_fd >= 0)
+        close(payload_fd);
+    free(image);
+    free(payload);
+    return status;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static Status run_bench(int sock, ClientRequest *req, const char *image_path, const char *payload_path, int count)
+{
+    // Inputs are loaded (or opened) once; only the round trips are timed
+    uchar *image = NULL, *payload = NULL;
+    size_t image_len = 0, payload_len = 0;
+    int image_fd = -1, payload_fd = -1;
+    double *lat = malloc(count * sizeof(double));
+    Status status = lat != NULL ? e_success : e_failure;
+
+    if (status == e_success && req->use_fd)
+    {
+        image_fd = open(image_path, O_RDONLY);
+        payload_fd = open(payload_path, O_RDONLY);
+        status = (image_fd >= 0 && payload_fd >= 0) ? e_success : e_failure;
+    }
+    else if (status == e_success)
+    {
+        status = read_file(image_path, &image, &image_len);
+        if (status == e_success)
+            status = read_file(payload_path, &payload, &payload_len);
+    }
+
+    double start = now_us();
+    for (int i = 0; status == e_success && i < count; i++)
+    {
+        ClientReply reply;
+        double t0 = now_us();
+        status = send_request(sock, req, image, image_len, image_fd, payload, payload_len, payload_fd);
+        if (status == e_success)
+            status = recv_reply(sock, &reply);
+        lat[i] = now_us() - t0;
+        if (status == e_success && reply.status != SERVE_OK)
+        {
+            fprintf(stderr, "ERROR: %s\n", reply.data);
+            status = e_failure;
+        }
+        if (status == e_success)
+            free(reply.data);
+    }
+
+    if (status == e_success)
+    {
+        double total = now_us() - start;
+        qsort(lat, count, sizeof(double), cmp_double);
+        printf("%d requests in %.1f ms (%.0f req/s)\n", count, total / 1e3, count / (total / 1e6));
+        printf("latency us: p50 %.1f  p99 %.1f  max %.1f\n", lat[count / 2], lat[(count * 99) / 100],
+               lat[count - 1]);
+    }
+
+    if (image_fd >= 0)
+        close(image_fd);
+    if (payload_fd >= 0)
+        close(payload_fd);
+    free(image);
+    free(payload);
+    free(lat);
+    return status;
+}
+
+static void usage(void)
+{
+    printf("Usage:\n"
+           "  stego_client <socket> embed [--fd] [-k N] [-z] [--no-crc] [--scatter] <carrier.bmp> <secret> <output.bmp> <magic>\n"
+           "  stego_client <socket> extract [--fd] <stego.bmp> <output> <magic>\n"
+           "  stego_client <socket> peek [--fd] <stego.bmp> <magic>\n"
+           "  stego_client <socket> bench [--fd] <carrier.bmp> <secret> <magic> [requests]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        usage();
+        return 1;
+    }
+
+    ClientRequest req;
+    memset(&req, 0, sizeof(req));
+    req.depth = 1;
+    req.codec = STEGO_CODEC_NONE;
+    req.checksum = 1;
+
+    // Flags may appear anywhere after the command; the rest are positional
+    const char *args[5];
+    int nargs = 0;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--fd") == 0)
+            req.use_fd = 1;
+        else if (strcmp(argv[i], "-z") == 0)
+            req.codec = STEGO_CODEC_LZ;
+        else if (strcmp(argv[i], "--no-crc") == 0)
+            req.checksum = 0;
+        else if (strcmp(argv[i], "--scatter") == 0)
+            req.scatter = 1;
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            req.depth = strcmp(argv[++i], "auto") == 0 ? STEGO_DEPTH_AUTO : atoi(argv[i]);
+        else if (nargs < 5)
+            args[nargs++] = argv[i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    const char *cmd = argv[2];
+    int ok = (strcmp(cmd, "embed") == 0 && nargs == 4) || (strcmp(cmd, "extract") == 0 && nargs == 3) ||
+             (strcmp(cmd, "peek") == 0 && nargs == 2) || (strcmp(cmd, "bench") == 0 && (nargs == 3 || nargs == 4));
+    if (!ok)
+    {
+        usage();
+        return 1;
+    }
+
+    int sock = connect_socket(argv[1]);
+    if (sock < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to connect to %s\n", argv[1]);
+        return 1;
+    }
+
+    Status status;
+    ClientReply reply;
+    memset(&reply, 0, sizeof(reply));
+    if (strcmp(cmd, "bench") == 0)
+    {
+        req.op = SERVE_EMBED;
+        req.magic = args[2];
+        int count = nargs == 4 ? atoi(args[3]) : 1000;
+        status = count > 0 ? run_bench(sock, &req, args[0], args[1], count) : e_failure;
+    }
+    else if (strcmp(cmd, "embed") == 0)
+    {
+        req.op = SERVE_EMBED;
+        req.magic = args[3];
+        const char *dot = strrchr(args[1], '.');
+        if (dot != NULL && strlen(dot) < sizeof(req.extn))
+            strcpy(req.extn, dot);
+        status = transact(sock, &req, args[0], args[1], &reply);
+        if (status == e_success && reply.status == SERVE_OK)
+            status = write_file(args[2], reply.data, reply.len);
+    }
+    else if (strcmp(cmd, "extract") == 0)
+    {
+        req.op = SERVE_EXTRACT;
+        req.magic = args[2];
+        status = transact(sock, &req, args[0], NULL, &reply);
+        if (status == e_success && reply.status == SERVE_OK)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s%s", args[1], reply.extn);
+            status = write_file(path, reply.data, reply.len);
+            if (status == e_success)
+                printf("%s: %zu bytes\n", path, reply.len);
+        }
+    }
+    else
+    {
+        req.op = SERVE_PEEK;
+        req.magic = args[1];
+        status = transact(sock, &req, args[0], NULL, &reply);
+        if (status == e_success && reply.status == SERVE_OK)
+        {
+            if (reply.size == (unsigned long long)-1)
+                printf("payload: framed, ext %s, depth %u, codec %u, crc %u\n", reply.extn, reply.depth, reply.codec,
+                       reply.checksum);
+            else
+                printf("payload: %llu bytes, ext %s, depth %u, codec %u, crc %u\n", reply.size, reply.extn,
+                       reply.depth, reply.codec, reply.checksum);
+        }
+    }
+
+    if (status == e_success && reply.status != SERVE_OK)
+    {
+        fprintf(stderr, "ERROR: %s\n", reply.data);
+        status = e_failure;
+    }
+    if (status != e_success && reply.status == SERVE_OK)
+        fprintf(stderr, "ERROR: request failed\n");
+    free(reply.data);
+    close(sock);
+    return status == e_success ? 0 : 1;
+}
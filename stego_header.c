@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include "stego_header.h"
+#include "types.h"
+
+/* Function Definitions */
+
+void pack_stego_header(const StegoHeader *hdr, uchar *buf)
+{
+    buf[0] = hdr->version;
+    buf[1] = hdr->flags;
+    buf[2] = hdr->depth;
+    buf[3] = hdr->codec;
+}
+
+Status unpack_stego_header(const uchar *buf, StegoHeader *hdr)
+{
+    hdr->version = buf[0];
+    hdr->flags = buf[1];
+    hdr->depth = buf[2];
+    hdr->codec = buf[3];
+
+    if (hdr->version != STEGO_VERSION && hdr->version != STEGO_VERSION_PLAIN)
+    {
+        printf("ERROR: Unsupported stego header version %u.\n", hdr->version);
+        return e_failure;
+    }
+
+    if (hdr->depth < 1 || hdr->depth > STEGO_MAX_DEPTH)
+    {
+        printf("ERROR: Invalid bit depth %u in stego header.\n", hdr->depth);
+        return e_failure;
+    }
+
+    if (hdr->flags & ~STEGO_FLAGS_KNOWN)
+    {
+        printf("ERROR: Unknown flags 0x%02x in stego header.\n", hdr->flags);
+        return e_failure;
+    }
+
+    if (hdr->codec > STEGO_CODEC_LZ)
+    {
+        printf("ERROR: Unknown codec %u in stego header.\n", hdr->codec);
+        return e_failure;
+    }
+
+    return e_success;
+}
+
+static void put_be(uchar *buf, unsigned long long value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--, value >>= 8)
+        buf[i] = (uchar)value;
+}
+
+static unsigned long long get_be(const uchar *buf, int bytes)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++)
+        value = (value << 8) | buf[i];
+    return value;
+}
+
+void pack_stego_shard(const StegoShard *shard, uchar *buf)
+{
+    put_be(buf, shard->payload_id, 8);
+    put_be(buf + 8, shard->index, 4);
+    put_be(buf + 12, shard->count, 4);
+    put_be(buf + 16, shard->offset, 8);
+}
+
+Status unpack_stego_shard(const uchar *buf, StegoShard *shard)
+{
+    shard->payload_id = get_be(buf, 8);
+    shard->index = get_be(buf + 8, 4);
+    shard->count = get_be(buf + 12, 4);
+    unsigned long long offset = get_be(buf + 16, 8);
+    shard->offset = offset;
+
+    // Offsets past LONG_MAX are not written by any encoder (decoders keep sizes in a long)
+    if (shard->count == 0 || shard->index >= shard->count || offset > 0x7FFFFFFFFFFFFFFFULL)
+    {
+        printf("ERROR: Invalid shard record in stego header.\n");
+        return e_failure;
+    }
+
+    return e_success;
+}
@@ -0,0 +1,88 @@
+#ifndef STEGO_HEADER_H
+#define STEGO_HEADER_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * Extended stego header. Written right after the magic string
+ * (at 1 bit per channel); images encoded without checksums and
+ * without any other non-default feature keep the original layout:
+ *
+ *   magic | marker(32) | version(8) flags(8) depth(8) codec(8) | [shard]
+ *         | extn size(32) | extn | file size(32) | [raw size(32)]
+ *         | [header crc(32)] | data | [payload crc(32)]
+ *
+ * The marker can never be a legacy extension size, which lets the
+ * decoder tell the two layouts apart. The payload (file size field
+ * excluded) is then stored at `depth` bits per channel. With a codec
+ * the file size counts stored (packed) bytes and the raw size field
+ * holds the size after decompression.
+ *
+ * Version 2 adds the two CRC32C fields: the header crc covers the
+ * bytes from the marker to the last size field, the payload crc
+ * every byte stored at `depth` (frame lengths included). Version 1
+ * images have neither and are still decoded.
+ *
+ * With STEGO_FLAG_SCATTER the payload (from the data on) is stored in
+ * keyed blocks after the header instead of right behind it (scatter.h).
+ * With STEGO_FLAG_SIZE64 the secret size fields are 64 bits wide; the
+ * encoder sets it only for secrets of 2 GB and more. With
+ * STEGO_FLAG_AEAD the payload is sealed with ChaCha20-Poly1305 (aead.h)
+ * and the file size counts sealed bytes.
+ *
+ * With STEGO_FLAG_SHARD the image holds one slice of a payload split
+ * over several carriers (shard.h). The shard record follows the flags:
+ *
+ *   payload id(64) | index(32) | count(32) | offset(64)
+ *
+ * and everything after it describes the slice alone; offset places
+ * the slice's unpacked bytes in the whole payload.
+ */
+
+#define STEGO_HEADER_MARKER 0x53544748u // "STGH"
+#define STEGO_VERSION 2                 // Layout with header and payload CRC32C
+#define STEGO_VERSION_PLAIN 1           // Layout without checksums
+#define STEGO_HEADER_BYTES 4            // Bytes after the marker
+#define STEGO_MAX_DEPTH 4               // LSBs per channel (1-4)
+#define STEGO_DEPTH_AUTO 0              // Pick the smallest depth that fits
+
+#define STEGO_CODEC_NONE 0 // Secret stored as is
+#define STEGO_CODEC_LZ 1   // Secret packed in lz.h blocks
+
+#define STEGO_FLAG_SCATTER 0x01 // Payload blocks in keyed order
+#define STEGO_FLAG_SIZE64 0x02  // 64-bit secret size fields
+#define STEGO_FLAG_AEAD 0x04    // Payload encrypted and authenticated
+#define STEGO_FLAG_SHARD 0x08   // One shard of a split payload (shard record follows)
+#define STEGO_FLAGS_KNOWN (STEGO_FLAG_SCATTER | STEGO_FLAG_SIZE64 | STEGO_FLAG_AEAD | STEGO_FLAG_SHARD)
+#define STEGO_SHARD_BYTES 24         // Size of the shard record
+#define STEGO_SIZE32_MAX 0x7FFFFFFFu // Largest size a 32-bit field holds (decoders read it signed)
+
+typedef struct _StegoHeader
+{
+    uint version; // Layout version
+    uint flags;   // STEGO_FLAG_* for optional stages
+    uint depth;   // Payload bits per carrier byte
+    uint codec;   // STEGO_CODEC_* applied to the secret
+} StegoHeader;
+
+typedef struct _StegoShard
+{
+    unsigned long long payload_id; // Random id shared by every shard of one payload
+    uint index;                    // Position of this shard, 0 to count - 1
+    uint count;                    // Shards of the payload (0: not sharded)
+    size_t offset;                 // Payload offset of the shard's first unpacked byte
+} StegoShard;
+
+/* Serialise the fields after the marker into buf */
+void pack_stego_header(const StegoHeader *hdr, uchar *buf);
+
+/* Parse and validate the fields after the marker */
+Status unpack_stego_header(const uchar *buf, StegoHeader *hdr);
+
+/* Serialise a shard record into buf (STEGO_SHARD_BYTES) */
+void pack_stego_shard(const StegoShard *shard, uchar *buf);
+
+/* Parse and validate a shard record */
+Status unpack_stego_shard(const uchar *buf, StegoShard *shard);
+
+#endif
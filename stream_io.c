@@ -0,0 +1,53 @@
+#define _POSIX_C_SOURCE 200809L // fdopen
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "stream_io.h"
+#include "types.h"
+
+/* Function Definitions */
+
+int is_stream_name(const char *name)
+{
+    return strcmp(name, STREAM_NAME) == 0;
+}
+
+FILE *open_input(const char *name)
+{
+    if (!is_stream_name(name))
+        return fopen(name, "r");
+
+    setvbuf(stdin, NULL, _IOFBF, STREAM_BUFFER);
+    return stdin;
+}
+
+FILE *open_output(const char *name)
+{
+    if (!is_stream_name(name))
+        return fopen(name, "w+"); // Read access too: mappings need it
+
+    // Keep the real stdout for data and send status messages to stderr
+    fflush(stdout);
+    int data_fd = dup(STDOUT_FILENO);
+    if (data_fd < 0)
+        return NULL;
+    if (dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    {
+        close(data_fd);
+        return NULL;
+    }
+
+    FILE *fptr = fdopen(data_fd, "w");
+    if (fptr != NULL)
+        setvbuf(fptr, NULL, _IOFBF, STREAM_BUFFER);
+    return fptr;
+}
+
+void close_stream(FILE *fptr)
+{
+    if (fptr == stdin)
+        return; // Leave stdin open for the process
+
+    fclose(fptr);
+}
@@ -0,0 +1,29 @@
+#ifndef STREAM_IO_H
+#define STREAM_IO_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Streaming helpers. A file name of "-" stands for stdin (inputs)
+ * or stdout (outputs), so the tool can sit in a shell pipeline.
+ * Data never needs to seek: everything is moved in fixed-size
+ * blocks, keeping memory use constant whatever the image size.
+ */
+
+#define STREAM_NAME "-"
+#define STREAM_BUFFER (64 * 1024) // stdio buffer for piped streams
+
+/* True when name refers to stdin/stdout */
+int is_stream_name(const char *name);
+
+/* Open name for reading, or stdin for "-" */
+FILE *open_input(const char *name);
+
+/* Open name for writing, or stdout for "-" (messages then go to stderr) */
+FILE *open_output(const char *name);
+
+/* Flush and close a file from open_input/open_output */
+void close_stream(FILE *fptr);
+
+#endif
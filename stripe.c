@@ -0,0 +1,99 @@
+#include <pthread.h>
+#include "stripe.h"
+#include "lsb.h"
+#include "types.h"
+
+#define MAX_STRIPES 64
+
+typedef struct
+{
+    uchar *dst;         // Stego stripe (embed) or output chunk (extract)
+    const uchar *src;   // Carrier stripe
+    const uchar *payload;
+    size_t n;           // Payload bytes in this stripe
+    uint depth;         // Payload bits per carrier byte
+} Stripe;
+
+/* Function Definitions */
+
+static void *embed_stripe(void *arg)
+{
+    Stripe *st = arg;
+    lsb_embed_k(st->dst, st->src, st->payload, 0, 8 * st->n, st->depth);
+    return NULL;
+}
+
+static void *extract_stripe(void *arg)
+{
+    Stripe *st = arg;
+    lsb_extract_k(st->dst, st->src, 0, 8 * st->n, st->depth);
+    return NULL;
+}
+
+static int stripe_count(size_t n, int nthreads)
+{
+    // Keep every stripe at least STRIPE_MIN_BYTES / 4 long
+    size_t max_by_size = n / (STRIPE_MIN_BYTES / 4);
+    int count = nthreads < MAX_STRIPES ? nthreads : MAX_STRIPES;
+    if ((size_t)count > max_by_size)
+        count = max_by_size ? (int)max_by_size : 1;
+    return count;
+}
+
+static void run_stripes(Stripe *stripes, int count, void *(*fn)(void *))
+{
+    pthread_t threads[MAX_STRIPES];
+    int started[MAX_STRIPES] = {0};
+
+    if (count == 0)
+        return;
+
+    // Stripe 0 runs on the calling thread
+    for (int i = 1; i < count; i++)
+        started[i] = pthread_create(&threads[i], NULL, fn, &stripes[i]) == 0;
+
+    fn(&stripes[0]);
+
+    for (int i = 1; i < count; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            fn(&stripes[i]); // Thread could not start: do it here
+    }
+}
+
+static int split(Stripe *stripes, uchar *dst, int dst_is_carrier, const uchar *src, const uchar *payload, size_t n, uint depth, int nthreads)
+{
+    int count = stripe_count(n, nthreads);
+    size_t chunk = (n / count + STRIPE_ALIGN - 1) / STRIPE_ALIGN * STRIPE_ALIGN;
+    size_t pos = 0;
+    int used = 0;
+
+    for (int i = 0; i < count && pos < n; i++, used++)
+    {
+        size_t len = (n - pos < chunk) ? n - pos : chunk;
+        size_t carrier = 8 * pos / depth; // Exact: pos is a multiple of STRIPE_ALIGN
+        stripes[i].dst = dst + (dst_is_carrier ? carrier : pos);
+        stripes[i].src = src + carrier;
+        stripes[i].payload = payload ? payload + pos : NULL;
+        stripes[i].n = len;
+        stripes[i].depth = depth;
+        pos += len;
+    }
+    return used;
+}
+
+void stripe_embed(uchar *dst, const uchar *src, const uchar *payload, size_t n, uint depth, int nthreads)
+{
+    Stripe stripes[MAX_STRIPES];
+    int count = split(stripes, dst, 1, src, payload, n, depth, nthreads);
+    run_stripes(stripes, count, embed_stripe);
+}
+
+void stripe_extract(uchar *out, const uchar *src, size_t n, uint depth, int nthreads)
+{
+    Stripe stripes[MAX_STRIPES];
+    int count = split(stripes, out, 0, src, NULL, n, depth, nthreads);
+    run_stripes(stripes, count, extract_stripe);
+}
@@ -0,0 +1,24 @@
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <stddef.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Intra-image parallelism. At depth k, payload byte i always maps to
+ * carrier bits starting at 8*i/k, so the payload is cut into chunks
+ * and each chunk is embedded into (or extracted from) its own carrier
+ * stripe on a separate thread. Output is identical to a single
+ * lsb_embed_k/lsb_extract_k call over the whole range.
+ */
+
+#define STRIPE_MIN_BYTES (256 * 1024) // Smallest payload worth splitting
+#define STRIPE_ALIGN 192              // Stripe boundary: whole carrier bytes at every depth
+
+/* Embed n payload bytes at depth bits per carrier byte using up to nthreads threads */
+void stripe_embed(uchar *dst, const uchar *src, const uchar *payload, size_t n, uint depth, int nthreads);
+
+/* Extract n payload bytes at depth bits per carrier byte using up to nthreads threads */
+void stripe_extract(uchar *out, const uchar *src, size_t n, uint depth, int nthreads);
+
+#endif
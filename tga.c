@@ -0,0 +1,46 @@
+#include <stddef.h>
+#include "tga.h"
+#include "carrier.h"
+#include "types.h"
+
+#define TGA_TRUE_COLOUR 2
+#define TGA_GREY 3
+
+/* Function Definitions */
+
+const char *check_tga_header(const uchar *buf, size_t len, BmpInfo *layout)
+{
+    if (len < TGA_HEADER_SIZE)
+        return carrier_short;
+
+    uint id_len = buf[0];
+    uint cmap_type = buf[1];
+    uint image_type = buf[2];
+    uint width = buf[12] | (buf[13] << 8);
+    uint height = buf[14] | (buf[15] << 8);
+    uint bpp = buf[16];
+    uint descriptor = buf[17];
+
+    // Anything that does not even look like a TGA header is not an image at all
+    if (cmap_type > 1 || !(image_type == 1 || image_type == 2 || image_type == 3 || (image_type >= 9 && image_type <= 11)))
+        return "Not a supported image (BMP, PPM/PGM, TGA or PNG).";
+
+    // Colour-mapped and run-length encoded images hold no raw channel bytes
+    if (cmap_type != 0 || (image_type == TGA_TRUE_COLOUR && bpp != 24 && bpp != 32) ||
+        (image_type == TGA_GREY && bpp != 8) || (image_type != TGA_TRUE_COLOUR && image_type != TGA_GREY))
+        return "Unsupported TGA format (only uncompressed 8/24/32-bit).";
+
+    if (width == 0 || height == 0 || (descriptor & 0xC0) != 0)
+        return "Corrupt TGA header.";
+
+    layout->data_offset = TGA_HEADER_SIZE + id_len;
+    layout->width = width;
+    layout->height = height;
+    layout->top_down = (descriptor & 0x20) != 0;
+    layout->bpp = bpp;
+    layout->row_bytes = width * (bpp / 8);
+    layout->row_stride = layout->row_bytes;
+    layout->pixel_bytes = (size_t)layout->row_bytes * height;
+    layout->image_end = layout->data_offset + layout->pixel_bytes;
+    return NULL;
+}
@@ -0,0 +1,24 @@
+#ifndef TGA_H
+#define TGA_H
+
+#include <stddef.h>
+#include "bmp.h"
+#include "types.h"
+
+/*
+ * Uncompressed TGA carriers: true-colour (image type 2, 24-bit BGR or
+ * 32-bit BGRA) and greyscale (type 3, 8-bit), without a colour map.
+ * The pixels follow the 18-byte header and the image id; rows are
+ * width * bpp / 8 bytes with no padding. The developer area and footer
+ * of TGA 2.0 files come after the pixels and are kept as they are.
+ *
+ * TGA has no signature, so any header that is none of the other
+ * formats is tried as TGA.
+ */
+
+#define TGA_HEADER_SIZE 18
+
+/* Read a TGA header in buf into layout; returns why it is rejected, carrier_short if more bytes are needed, NULL if usable */
+const char *check_tga_header(const uchar *buf, size_t len, BmpInfo *layout);
+
+#endif
@@ -3,6 +3,7 @@
 
 /* User defined types */
 typedef unsigned int uint;
+typedef unsigned char uchar;
 
 /* Status will be used in fn. return type */
 typedef enum
@@ -15,6 +16,9 @@ typedef enum
 {
     e_encode,
     e_decode,
+    e_batch,
+    e_scan,
+    e_serve,
     e_unsupported
 } OperationType;
 
@@ -0,0 +1,402 @@
+#define _GNU_SOURCE // syscall, MAP_POPULATE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "uring_io.h"
+#include "types.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define URING_AVAILABLE 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef URING_AVAILABLE
+
+struct _UringIO
+{
+    int fd;
+    pthread_mutex_t lock; // Guards the submission queue
+
+    // Submission queue (shared with the kernel)
+    uchar *sq_map;
+    size_t sq_map_size;
+    uint *sq_head;
+    uint *sq_tail;
+    uint *sq_array;
+    uint sq_mask;
+    uint sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    uint pending; // Queued but not yet handed to the kernel
+
+    // Completion queue (shared with the kernel)
+    uchar *cq_map;
+    size_t cq_map_size;
+    uint *cq_head;
+    uint *cq_tail;
+    uint cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Registered buffers
+    uchar *slots;
+    int nslots;
+};
+
+/* Function Definitions */
+
+static int sys_uring_setup(uint entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_uring_enter(int fd, uint to_submit, uint min_complete, uint flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_uring_register(int fd, uint opcode, void *arg, uint nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static Status map_rings(UringIO *ring, const struct io_uring_params *p)
+{
+    ring->sq_map_size = p->sq_off.array + p->sq_entries * sizeof(uint);
+    ring->cq_map_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+    // Since 5.4 both rings live in one mapping
+    int single = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_map_size > ring->sq_map_size)
+        ring->sq_map_size = ring->cq_map_size;
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED)
+    {
+        ring->sq_map = NULL;
+        return e_failure;
+    }
+
+    if (single)
+    {
+        ring->cq_map = ring->sq_map;
+    }
+    else
+    {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED)
+        {
+            ring->cq_map = NULL;
+            return e_failure;
+        }
+    }
+
+    ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        return e_failure;
+    }
+
+    ring->sq_head = (uint *)(ring->sq_map + p->sq_off.head);
+    ring->sq_tail = (uint *)(ring->sq_map + p->sq_off.tail);
+    ring->sq_array = (uint *)(ring->sq_map + p->sq_off.array);
+    ring->sq_mask = *(uint *)(ring->sq_map + p->sq_off.ring_mask);
+    ring->sq_entries = p->sq_entries;
+
+    ring->cq_head = (uint *)(ring->cq_map + p->cq_off.head);
+    ring->cq_tail = (uint *)(ring->cq_map + p->cq_off.tail);
+    ring->cq_mask = *(uint *)(ring->cq_map + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(ring->cq_map + p->cq_off.cqes);
+    return e_success;
+}
+
+static void register_slots(UringIO *ring, int nslots)
+{
+    if (nslots > URING_MAX_REGISTERED / URING_SLOT_SIZE)
+        nslots = URING_MAX_REGISTERED / URING_SLOT_SIZE;
+    if (nslots <= 0)
+        return;
+
+    size_t size = (size_t)nslots * URING_SLOT_SIZE;
+    uchar *slots = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    struct iovec *iov = calloc(nslots, sizeof(struct iovec));
+    if (slots == MAP_FAILED || iov == NULL)
+    {
+        if (slots != MAP_FAILED)
+            munmap(slots, size);
+        free(iov);
+        return;
+    }
+
+    for (int i = 0; i < nslots; i++)
+    {
+        iov[i].iov_base = slots + (size_t)i * URING_SLOT_SIZE;
+        iov[i].iov_len = URING_SLOT_SIZE;
+    }
+
+    // Registration pins the pages; it fails under a small RLIMIT_MEMLOCK on old kernels
+    if (sys_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, nslots) == 0)
+    {
+        ring->slots = slots;
+        ring->nslots = nslots;
+    }
+    else
+    {
+        munmap(slots, size);
+    }
+    free(iov);
+}
+
+UringIO *uring_create(uint entries, int nslots)
+{
+    UringIO *ring = calloc(1, sizeof(UringIO));
+    if (ring == NULL)
+        return NULL;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_uring_setup(entries, &p);
+    if (ring->fd < 0)
+    {
+        free(ring); // ENOSYS, or blocked by a seccomp filter / io_uring_disabled
+        return NULL;
+    }
+    pthread_mutex_init(&ring->lock, NULL);
+
+    // IORING_OP_READ/WRITE arrived with FEAT_RW_CUR_POS (5.6); NODROP keeps completions on overflow
+    if ((p.features & IORING_FEAT_RW_CUR_POS) == 0 || (p.features & IORING_FEAT_NODROP) == 0 ||
+        map_rings(ring, &p) != e_success)
+    {
+        uring_destroy(ring);
+        return NULL;
+    }
+
+    register_slots(ring, nslots);
+    return ring;
+}
+
+void uring_destroy(UringIO *ring)
+{
+    if (ring == NULL)
+        return;
+
+    if (ring->slots != NULL)
+    {
+        sys_uring_register(ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        munmap(ring->slots, (size_t)ring->nslots * URING_SLOT_SIZE);
+    }
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map != NULL)
+        munmap(ring->sq_map, ring->sq_map_size);
+
+    close(ring->fd);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring);
+}
+
+int uring_slot_count(const UringIO *ring)
+{
+    return ring->nslots;
+}
+
+uchar *uring_slot(UringIO *ring, int slot)
+{
+    return ring->slots + (size_t)slot * URING_SLOT_SIZE;
+}
+
+static Status enter_locked(UringIO *ring)
+{
+    while (ring->pending > 0)
+    {
+        int ret = sys_uring_enter(ring->fd, ring->pending, 0, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return e_failure;
+        }
+        ring->pending -= ret;
+    }
+    return e_success;
+}
+
+static struct io_uring_sqe *get_sqe(UringIO *ring)
+{
+    // Caller holds the lock; a full queue is flushed to the kernel first
+    uint tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+    {
+        if (enter_locked(ring) != e_success)
+            return NULL;
+        if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+            return NULL;
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static void push_sqe(UringIO *ring)
+{
+    // Publish the entry; the kernel sees it on the next io_uring_enter
+    uint tail = *ring->sq_tail;
+    ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+}
+
+static Status queue_rw(UringIO *ring, uchar opcode, uchar fixed_opcode, int fd, const uchar *buf, size_t len,
+                       off_t offset, int slot, void *user_data)
+{
+    if (len > URING_MAX_IO)
+        len = URING_MAX_IO; // The completion reports a short transfer; the caller queues the rest
+
+    pthread_mutex_lock(&ring->lock);
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (sqe != NULL)
+    {
+        sqe->opcode = slot >= 0 ? fixed_opcode : opcode;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long)buf;
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->buf_index = slot >= 0 ? slot : 0;
+        sqe->user_data = (unsigned long)user_data;
+        push_sqe(ring);
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    return sqe != NULL ? e_success : e_failure;
+}
+
+Status uring_queue_read(UringIO *ring, int fd, uchar *buf, size_t len, off_t offset, int slot, void *user_data)
+{
+    return queue_rw(ring, IORING_OP_READ, IORING_OP_READ_FIXED, fd, buf, len, offset, slot, user_data);
+}
+
+Status uring_queue_write(UringIO *ring, int fd, const uchar *buf, size_t len, off_t offset, int slot,
+                         void *user_data)
+{
+    return queue_rw(ring, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, fd, buf, len, offset, slot, user_data);
+}
+
+Status uring_queue_nop(UringIO *ring, void *user_data)
+{
+    pthread_mutex_lock(&ring->lock);
+    struct io_uring_sqe *sqe = get_sqe(ring);
+    if (sqe != NULL)
+    {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = (unsigned long)user_data;
+        push_sqe(ring);
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    return sqe != NULL ? e_success : e_failure;
+}
+
+Status uring_submit(UringIO *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    Status status = enter_locked(ring);
+    pthread_mutex_unlock(&ring->lock);
+    return status;
+}
+
+static int reap(UringIO *ring, UringEvent *events, int max)
+{
+    uint head = *ring->cq_head;
+    uint tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int n = 0;
+
+    for (; head != tail && n < max; head++, n++)
+    {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        events[n].user_data = (void *)(unsigned long)cqe->user_data;
+        events[n].res = cqe->res;
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+int uring_wait(UringIO *ring, UringEvent *events, int max)
+{
+    int n;
+    while ((n = reap(ring, events, max)) == 0)
+    {
+        // Push anything still queued, then sleep without the lock so other threads can submit
+        if (uring_submit(ring) != e_success)
+            return -1;
+        if (sys_uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            return -1;
+    }
+    return n;
+}
+
+#else
+
+/* No io_uring on this platform: callers take their blocking path */
+
+UringIO *uring_create(uint entries, int nslots)
+{
+    return NULL;
+}
+
+void uring_destroy(UringIO *ring)
+{
+}
+
+int uring_slot_count(const UringIO *ring)
+{
+    return 0;
+}
+
+uchar *uring_slot(UringIO *ring, int slot)
+{
+    return NULL;
+}
+
+Status uring_queue_read(UringIO *ring, int fd, uchar *buf, size_t len, off_t offset, int slot, void *user_data)
+{
+    return e_failure;
+}
+
+Status uring_queue_write(UringIO *ring, int fd, const uchar *buf, size_t len, off_t offset, int slot,
+                         void *user_data)
+{
+    return e_failure;
+}
+
+Status uring_queue_nop(UringIO *ring, void *user_data)
+{
+    return e_failure;
+}
+
+Status uring_submit(UringIO *ring)
+{
+    return e_failure;
+}
+
+int uring_wait(UringIO *ring, UringEvent *events, int max)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef URING_IO_H
+#define URING_IO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Minimal io_uring engine (raw system calls, no liburing) used by
+ * batch mode to keep many reads and writes in flight at once.
+ *
+ * A pool of URING_SLOT_SIZE buffers is registered with the kernel
+ * when possible, so I/O into a slot uses the fixed-buffer opcodes and
+ * skips the per-call page pinning. Requests are queued first and sent
+ * to the kernel together by uring_submit. Queueing and submitting may
+ * be done from any thread; completions must be reaped by one thread.
+ *
+ * uring_create returns NULL when the kernel (or a seccomp filter)
+ * does not allow io_uring, and callers fall back to blocking I/O.
+ */
+
+#define URING_SLOT_SIZE (4 * 1024 * 1024)    // Bytes per registered buffer
+#define URING_MAX_REGISTERED (256 * 1024 * 1024) // Upper bound on registered memory
+#define URING_MAX_IO (1 << 30)               // Largest single read or write request
+
+typedef struct _UringIO UringIO;
+
+typedef struct
+{
+    void *user_data; // Value passed when the request was queued
+    int res;         // Bytes transferred, or -errno
+} UringEvent;
+
+/* Set up a ring of entries requests with up to nslots registered buffers (NULL: io_uring unavailable) */
+UringIO *uring_create(uint entries, int nslots);
+
+/* Tear down the ring and free its buffers */
+void uring_destroy(UringIO *ring);
+
+/* Number of buffer slots (0 if registration failed) */
+int uring_slot_count(const UringIO *ring);
+
+/* Memory of slot index */
+uchar *uring_slot(UringIO *ring, int slot);
+
+/* Queue a read or write of len bytes at offset; slot is the buffer's slot index, or -1 for other memory */
+Status uring_queue_read(UringIO *ring, int fd, uchar *buf, size_t len, off_t offset, int slot, void *user_data);
+Status uring_queue_write(UringIO *ring, int fd, const uchar *buf, size_t len, off_t offset, int slot, void *user_data);
+
+/* Queue a request that completes at once (wakes the reaping thread) */
+Status uring_queue_nop(UringIO *ring, void *user_data);
+
+/* Hand every queued request to the kernel */
+Status uring_submit(UringIO *ring);
+
+/* Wait for at least one completion and reap up to max of them; returns the number reaped */
+int uring_wait(UringIO *ring, UringEvent *events, int max);
+
+#endif